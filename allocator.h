@@ -1,10 +1,19 @@
 #pragma once
 
+#include <cstddef>
 #include <limits>
 #include <memory>
+#include <new>
 #include <iostream>
+#include <cstdlib>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
 
-template<class T>
+// Alignment is in bytes, 0 means the natural alignment of T.
+// Allocations of at least HugePageThreshold bytes are served by mmap
+// and marked with MADV_HUGEPAGE (Linux only), 0 disables it.
+template<class T, std::size_t Alignment = 0, std::size_t HugePageThreshold = 0>
 class Allocator {
 public:
 	typedef T                 value_type;
@@ -14,10 +23,16 @@ public:
 	typedef       value_type& reference;
 	typedef const value_type* const_pointer;
 	typedef const value_type& const_reference;
-	
+
+	static const std::size_t alignment = Alignment > alignof(T) ? Alignment : alignof(T);
+	static const std::size_t huge_page_threshold = HugePageThreshold;
+	static const std::size_t huge_page_size = std::size_t(1) << 21;
+
+	static_assert((alignment & (alignment - 1)) == 0, "alignment must be a power of two");
+
 	template<class U> 
 	struct rebind { 
-		typedef Allocator<U> other; 
+		typedef Allocator<U, Alignment, HugePageThreshold> other; 
 	};
 
 	Allocator() throw() {
@@ -27,7 +42,7 @@ public:
 	}
 
 	template<class U>
-	Allocator(const Allocator<U>&) {	
+	Allocator(const Allocator<U, Alignment, HugePageThreshold>&) {	
 	}
 
 	~Allocator() throw() {
@@ -42,11 +57,52 @@ public:
 	}
 
 	pointer allocate(size_type n, const_pointer hint = 0) {
-		return static_cast<pointer>(operator new(n * sizeof(T)));
+		if (is_huge(n * sizeof(T))) {
+			return static_cast<pointer>(map_huge(n * sizeof(T)));
+		}
+		if (alignment <= alignof(std::max_align_t)) {
+			return static_cast<pointer>(operator new(n * sizeof(T)));
+		}
+#ifdef __cpp_aligned_new
+		return static_cast<pointer>(operator new(n * sizeof(T), std::align_val_t(alignment)));
+#else
+		void* p = nullptr;
+		if (posix_memalign(&p, alignment, n * sizeof(T)) != 0) {
+			throw std::bad_alloc();
+		}
+		return static_cast<pointer>(p);
+#endif
 	}
 
 	void deallocate(pointer p, size_type n) {
-		operator delete(p);
+		if (is_huge(n * sizeof(T))) {
+			unmap_huge(p, n * sizeof(T));
+			return;
+		}
+		if (alignment <= alignof(std::max_align_t)) {
+			operator delete(p);
+			return;
+		}
+#ifdef __cpp_aligned_new
+		operator delete(p, std::align_val_t(alignment));
+#else
+		free(p);
+#endif
+	}
+
+	// Huge mappings shrink in place by unmapping their tail, which returns
+	// the pages to the system at once. Other buffers have to be moved.
+	bool shrink(pointer p, size_type n, size_type a_new_size) {
+		if (!is_huge(n * sizeof(T)) || !is_huge(a_new_size * sizeof(T))) {
+			return false;
+		}
+		char* begin = reinterpret_cast<char*>(p);
+		size_type old_mapped = mapped_size(n * sizeof(T));
+		size_type new_mapped = mapped_size(a_new_size * sizeof(T));
+		if (new_mapped < old_mapped) {
+			unmap_huge(begin + new_mapped, old_mapped - new_mapped);
+		}
+		return true;
 	}
 
 	size_type max_size() const {
@@ -62,14 +118,64 @@ public:
 	void destroy(U* p) {
 		p->~U();
 	}
+
+private:
+	static bool is_huge(size_type a_bytes) {
+#ifdef __linux__
+		return huge_page_threshold != 0 && a_bytes >= huge_page_threshold;
+#else
+		return false;
+#endif
+	}
+
+	static size_type mapped_size(size_type a_bytes) {
+		return (a_bytes + huge_page_size - 1)/huge_page_size*huge_page_size;
+	}
+
+	// Maps one huge page more than needed and trims
+	// both ends so the region starts on a huge page boundary
+	static void* map_huge(size_type a_bytes) {
+#ifdef __linux__
+		size_type size = mapped_size(a_bytes);
+		void* p = mmap(nullptr, size + huge_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED) {
+			throw std::bad_alloc();
+		}
+		char* mapped = static_cast<char*>(p);
+		char* aligned = reinterpret_cast<char*>((reinterpret_cast<std::size_t>(mapped) + huge_page_size - 1)/huge_page_size*huge_page_size);
+		if (aligned != mapped) {
+			munmap(mapped, aligned - mapped);
+		}
+		munmap(aligned + size, mapped + huge_page_size - aligned);
+		madvise(aligned, size, MADV_HUGEPAGE);
+		return aligned;
+#else
+		return nullptr;
+#endif
+	}
+
+	static void unmap_huge(void* p, size_type a_bytes) {
+#ifdef __linux__
+		munmap(p, mapped_size(a_bytes));
+#endif
+	}
 };
 
-template <class T1, class T2>
-bool operator==(const Allocator<T1>&, const Allocator<T2>&) throw() {
-	return true;
+template<class T, std::size_t A, std::size_t H>
+const std::size_t Allocator<T, A, H>::alignment;
+
+template<class T, std::size_t A, std::size_t H>
+const std::size_t Allocator<T, A, H>::huge_page_threshold;
+
+template<class T, std::size_t A, std::size_t H>
+const std::size_t Allocator<T, A, H>::huge_page_size;
+
+template <class T1, std::size_t A1, std::size_t H1, class T2, std::size_t A2, std::size_t H2>
+bool operator==(const Allocator<T1, A1, H1>&, const Allocator<T2, A2, H2>&) throw() {
+	return A1 == A2 && H1 == H2;
 }
 
-template <class T1, class T2>
-bool operator!=(const Allocator<T1>&, const Allocator<T2>&) throw() {
-	return false;
+template <class T1, std::size_t A1, std::size_t H1, class T2, std::size_t A2, std::size_t H2>
+bool operator!=(const Allocator<T1, A1, H1>&, const Allocator<T2, A2, H2>&) throw() {
+	return !(A1 == A2 && H1 == H2);
 }
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+// Bump-pointer memory resource. Individual deallocations are no-ops,
+// everything is given back at once by reset() or release().
+// Not thread-safe: one arena per request or batch.
+class Arena {
+public:
+	explicit Arena(std::size_t a_block_size = std::size_t(1) << 16)
+		: m_block_size(a_block_size), m_first(nullptr), m_block(nullptr),
+		  m_current(nullptr), m_limit(nullptr), m_last(nullptr) {
+	}
+
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	~Arena() {
+		release();
+	}
+
+	void* allocate(std::size_t a_bytes, std::size_t a_alignment) {
+		char* p = align(m_current, a_alignment);
+		if (m_current == nullptr || p > m_limit || a_bytes > std::size_t(m_limit - p)) {
+			next_block(a_bytes + a_alignment);
+			p = align(m_current, a_alignment);
+		}
+		m_current = p + a_bytes;
+		m_last = p;
+		return p;
+	}
+
+	// Grows the most recent allocation in place when the current block
+	// has room for it. Returns false if the memory has to be moved.
+	bool extend(void* p, std::size_t a_old_bytes, std::size_t a_new_bytes) {
+		char* block = static_cast<char*>(p);
+		if (p == nullptr || p != m_last || block + a_old_bytes != m_current) {
+			return false;
+		}
+		if (a_new_bytes > std::size_t(m_limit - block)) {
+			return false;
+		}
+		m_current = block + a_new_bytes;
+		return true;
+	}
+
+	// Gives the tail of the most recent allocation back to the block.
+	// Other allocations keep their memory until reset(): returns false.
+	bool shrink(void* p, std::size_t a_old_bytes, std::size_t a_new_bytes) {
+		char* block = static_cast<char*>(p);
+		if (p == nullptr || p != m_last || block + a_old_bytes != m_current) {
+			return false;
+		}
+		m_current = block + a_new_bytes;
+		return true;
+	}
+
+	// Rewinds to the first block. Blocks are kept for reuse.
+	void reset() {
+		m_block = m_first;
+		m_current = m_block == nullptr ? nullptr : m_block->begin();
+		m_limit = m_block == nullptr ? nullptr : m_block->end();
+		m_last = nullptr;
+	}
+
+	// Gives all blocks back to the system
+	void release() {
+		while (m_first != nullptr) {
+			Block* next = m_first->next;
+			operator delete(m_first);
+			m_first = next;
+		}
+		m_block = nullptr;
+		m_current = m_limit = m_last = nullptr;
+	}
+
+	std::size_t reserved() const {
+		std::size_t bytes = 0;
+		for(Block* b = m_first; b != nullptr; b = b->next) {
+			bytes += b->size;
+		}
+		return bytes;
+	}
+
+private:
+	struct Block {
+		Block* next;
+		std::size_t size;
+
+		char* begin() {
+			return reinterpret_cast<char*>(this) + header();
+		}
+
+		char* end() {
+			return begin() + size;
+		}
+
+		static std::size_t header() {
+			return (sizeof(Block) + alignof(std::max_align_t) - 1)/alignof(std::max_align_t)*alignof(std::max_align_t);
+		}
+	};
+
+	std::size_t m_block_size;
+	Block* m_first;
+	Block* m_block;
+	char* m_current;
+	char* m_limit;
+	char* m_last;
+
+	static char* align(char* p, std::size_t a_alignment) {
+		std::uintptr_t value = reinterpret_cast<std::uintptr_t>(p);
+		return reinterpret_cast<char*>((value + a_alignment - 1)/a_alignment*a_alignment);
+	}
+
+	// Moves to the next kept block if it is big enough,
+	// otherwise links a new one right after the current block
+	void next_block(std::size_t a_bytes) {
+		Block* next = m_block == nullptr ? m_first : m_block->next;
+		if (next == nullptr || next->size < a_bytes) {
+			std::size_t size = std::max(m_block_size, a_bytes);
+			Block* block = static_cast<Block*>(operator new(Block::header() + size));
+			block->size = size;
+			block->next = next;
+			if (m_block == nullptr) {
+				m_first = block;
+			} else {
+				m_block->next = block;
+			}
+			next = block;
+		}
+		m_block = next;
+		m_current = m_block->begin();
+		m_limit = m_block->end();
+	}
+};
+
+// Allocator view of an Arena. Copies share the arena, so Vectors moved
+// or swapped between each other keep valid memory.
+template<class T>
+class ArenaAllocator {
+public:
+	typedef T                 value_type;
+	typedef std::size_t       size_type;
+	typedef std::ptrdiff_t    difference_type;
+	typedef       value_type* pointer;
+	typedef       value_type& reference;
+	typedef const value_type* const_pointer;
+	typedef const value_type& const_reference;
+	typedef std::true_type    propagate_on_container_copy_assignment;
+	typedef std::true_type    propagate_on_container_move_assignment;
+	typedef std::true_type    propagate_on_container_swap;
+	typedef std::false_type   is_always_equal;
+
+	template<class U>
+	struct rebind {
+		typedef ArenaAllocator<U> other;
+	};
+
+	ArenaAllocator(Arena& a_arena) throw() : m_arena(&a_arena) {
+	}
+
+	ArenaAllocator(const ArenaAllocator& other) = default;
+	ArenaAllocator& operator=(const ArenaAllocator& other) = default;
+
+	template<class U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : m_arena(other.arena()) {
+	}
+
+	~ArenaAllocator() throw() {
+	}
+
+	Arena* arena() const {
+		return m_arena;
+	}
+
+	pointer address(reference r) const {
+		return &r;
+	}
+
+	const_pointer address(const_reference r) const {
+		return &r;
+	}
+
+	pointer allocate(size_type n, const_pointer hint = 0) {
+		return static_cast<pointer>(m_arena->allocate(n * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(pointer p, size_type n) {
+	}
+
+	bool extend(pointer p, size_type n, size_type a_new_size) {
+		return m_arena->extend(p, n * sizeof(T), a_new_size * sizeof(T));
+	}
+
+	// Only the most recent allocation of the arena can shrink
+	bool shrink(pointer p, size_type n, size_type a_new_size) {
+		return m_arena->shrink(p, n * sizeof(T), a_new_size * sizeof(T));
+	}
+
+	// Moving a buffer to shrink it would only take more of the arena
+	bool relocate_to_shrink(pointer) const {
+		return false;
+	}
+
+	size_type max_size() const {
+		return std::numeric_limits<size_type>::max() / sizeof(T);
+	}
+
+	template<class U, class... Args>
+	void construct(U* p, Args&&... args) {
+		new((void *)p) U(std::forward<Args>(args)...);
+	}
+
+	template<class U>
+	void destroy(U* p) {
+		p->~U();
+	}
+
+private:
+	Arena* m_arena;
+};
+
+template <class T1, class T2>
+bool operator==(const ArenaAllocator<T1>& a, const ArenaAllocator<T2>& b) throw() {
+	return a.arena() == b.arena();
+}
+
+template <class T1, class T2>
+bool operator!=(const ArenaAllocator<T1>& a, const ArenaAllocator<T2>& b) throw() {
+	return a.arena() != b.arena();
+}
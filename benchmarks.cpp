@@ -0,0 +1,997 @@
+// Google Benchmark suite for Vector, the allocators and the sorts.
+// Every run is repeated and reported as mean/median/stddev by default;
+// flags given on the command line take precedence, for example
+//   benchmarks --benchmark_filter=sort --benchmark_out=results.json --benchmark_out_format=json
+// or --benchmark_format=csv for CSV on stdout.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <benchmark/benchmark.h>
+#include "vector.h"
+#include "small_vector.h"
+#include "segmented_vector.h"
+#include "mapped_vector.h"
+#include "serialization.h"
+#include "soa_vector.h"
+#include "concurrent_vector.h"
+#include "gap_buffer.h"
+#include "allocator.h"
+#include "pool_allocator.h"
+#include "arena_allocator.h"
+#include "sort.h"
+#include "parallel_sort.h"
+#include "parallel_algorithm.h"
+
+typedef int TType;
+
+// Inputs that degrade naive quicksorts, generated from a fixed seed
+// so that runs of different builds sort the same data
+enum Pattern {
+	random_pattern,
+	sorted_pattern,
+	reverse_pattern,
+	few_unique_pattern,
+	organ_pipe_pattern,
+	nearly_sorted_pattern
+};
+
+const char* pattern_names[] = {"random", "sorted", "reverse", "few_unique", "organ_pipe", "nearly_sorted"};
+
+std::vector<TType> make_pattern(int a_pattern, int a_size) {
+	std::mt19937 generator(a_size);
+	std::vector<TType> sample(a_size);
+	for(int i = 0; i < a_size; i++) {
+		sample[i] = generator();
+	}
+	switch (a_pattern) {
+	case sorted_pattern:
+		std::sort(sample.begin(), sample.end());
+		break;
+	case reverse_pattern:
+		std::sort(sample.begin(), sample.end(), std::greater<TType>());
+		break;
+	case few_unique_pattern:
+		for(int i = 0; i < a_size; i++) {
+			sample[i] = generator()%4;
+		}
+		break;
+	case organ_pipe_pattern:
+		for(int i = 0; i < a_size; i++) {
+			sample[i] = std::min(i, a_size - i);
+		}
+		break;
+	case nearly_sorted_pattern:
+		std::sort(sample.begin(), sample.end());
+		for(int i = 0; i < a_size/100; i++) {
+			std::swap(sample[generator()%a_size], sample[generator()%a_size]);
+		}
+		break;
+	}
+	return sample;
+}
+
+// Containers
+
+template<class Container>
+void push_back(benchmark::State& state) {
+	std::size_t capacity = 0;
+	for(auto _ : state) {
+		Container container;
+		for(int i = 0; i < state.range(0); i++) {
+			container.push_back(i);
+		}
+		capacity = container.capacity();
+		benchmark::DoNotOptimize(container);
+	}
+	state.SetItemsProcessed(state.iterations()*state.range(0));
+	// Memory overhead of the growth policy
+	state.counters["capacity"] = capacity;
+}
+
+// Worst and 99.9th percentile time of a single push_back
+// while the container grows to the given size
+template<class Container>
+void push_back_latency(benchmark::State& state) {
+	std::vector<float> latencies(state.range(0));
+	for(auto _ : state) {
+		Container container;
+		for(int i = 0; i < state.range(0); i++) {
+			auto start = std::chrono::steady_clock::now();
+			container.push_back(i);
+			auto end = std::chrono::steady_clock::now();
+			latencies[i] = std::chrono::duration<float, std::nano>(end - start).count();
+		}
+		benchmark::DoNotOptimize(container);
+	}
+	std::sort(latencies.begin(), latencies.end());
+	state.counters["max_ns"] = latencies.back();
+	state.counters["p999_ns"] = latencies[latencies.size()*999/1000];
+	state.SetItemsProcessed(state.iterations()*state.range(0));
+}
+
+// Resident memory in bytes right now
+long resident_bytes() {
+	long pages = 0;
+	long resident = 0;
+	std::ifstream statm("/proc/self/statm");
+	statm >> pages >> resident;
+	return resident*sysconf(_SC_PAGESIZE);
+}
+
+// Peak resident memory added while one container grows to state.range(0)
+// elements, including the moments when the old and new buffers coexist.
+// Each run is a child process, so that earlier benchmarks do not raise
+// its high-water mark.
+template<class Container>
+void push_back_peak_rss(benchmark::State& state) {
+	long peak = 0;
+	for(auto _ : state) {
+		int channel[2];
+		if (pipe(channel) != 0) {
+			state.SkipWithError("pipe failed");
+			break;
+		}
+		pid_t child = fork();
+		if (child == 0) {
+			long base = resident_bytes();
+			Container container;
+			for(int i = 0; i < state.range(0); i++) {
+				container.push_back(i);
+			}
+			benchmark::DoNotOptimize(container);
+			rusage usage;
+			getrusage(RUSAGE_SELF, &usage);
+			long growth = usage.ru_maxrss*1024 - base;
+			ssize_t written = write(channel[1], &growth, sizeof(growth));
+			_exit(written == sizeof(growth) ? 0 : 1);
+		}
+		close(channel[1]);
+		if (child < 0 || read(channel[0], &peak, sizeof(peak)) != sizeof(peak)) {
+			state.SkipWithError("child process failed");
+		}
+		close(channel[0]);
+		if (child > 0) {
+			waitpid(child, nullptr, 0);
+		}
+	}
+	state.counters["peak_rss"] = peak;
+	// The data itself, for comparison
+	state.counters["data"] = state.range(0)*sizeof(TType);
+}
+
+// One insertion in the middle, undone by the cheap pop_back()
+template<class Container>
+void insert_middle(benchmark::State& state) {
+	std::vector<TType> sample = make_pattern(random_pattern, state.range(0));
+	Container container(sample.begin(), sample.end());
+	for(auto _ : state) {
+		container.insert(container.begin() + container.size()/2, 1);
+		container.pop_back();
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+
+// One erasure in the middle, undone by the cheap push_back()
+template<class Container>
+void erase_middle(benchmark::State& state) {
+	std::vector<TType> sample = make_pattern(random_pattern, state.range(0));
+	Container container(sample.begin(), sample.end());
+	for(auto _ : state) {
+		container.erase(container.begin() + container.size()/2);
+		container.push_back(1);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+
+// A half-filled container receives the sample in the middle and at the end
+template<class Container>
+void range_insert(benchmark::State& state) {
+	std::vector<TType> sample = make_pattern(random_pattern, state.range(0));
+	for(auto _ : state) {
+		state.PauseTiming();
+		Container container(sample.begin(), sample.begin() + sample.size()/2);
+		state.ResumeTiming();
+		container.insert(container.begin() + container.size()/2, sample.begin(), sample.end());
+		container.insert(container.end(), sample.begin(), sample.end());
+		benchmark::DoNotOptimize(container);
+	}
+	state.SetItemsProcessed(state.iterations()*state.range(0)*2);
+}
+
+template<class Container>
+void reserve_resize(benchmark::State& state) {
+	for(auto _ : state) {
+		Container container;
+		container.reserve(state.range(0));
+		container.resize(state.range(0));
+		benchmark::DoNotOptimize(container);
+	}
+	state.SetItemsProcessed(state.iterations()*state.range(0));
+}
+
+template<class Container>
+void copy(benchmark::State& state) {
+	std::vector<TType> sample = make_pattern(random_pattern, state.range(0));
+	Container original(sample.begin(), sample.end());
+	for(auto _ : state) {
+		Container container(original);
+		benchmark::DoNotOptimize(container);
+	}
+	state.SetBytesProcessed(state.iterations()*state.range(0)*sizeof(TType));
+}
+
+// Creation and destruction of many vectors with 0-8 elements
+template<class Container>
+void small(benchmark::State& state) {
+	int count = 0;
+	for(auto _ : state) {
+		Container container;
+		for(int j = 0; j < count%9; j++) {
+			container.push_back(j);
+		}
+		benchmark::DoNotOptimize(container);
+		count++;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+
+#define CONTAINER_BENCHMARKS(Container) \
+	BENCHMARK_TEMPLATE(push_back, Container)->RangeMultiplier(32)->Range(1 << 10, 1 << 20); \
+	BENCHMARK_TEMPLATE(insert_middle, Container)->RangeMultiplier(32)->Range(1 << 10, 1 << 20); \
+	BENCHMARK_TEMPLATE(erase_middle, Container)->RangeMultiplier(32)->Range(1 << 10, 1 << 20); \
+	BENCHMARK_TEMPLATE(range_insert, Container)->RangeMultiplier(32)->Range(1 << 10, 1 << 20); \
+	BENCHMARK_TEMPLATE(reserve_resize, Container)->RangeMultiplier(32)->Range(1 << 10, 1 << 20); \
+	BENCHMARK_TEMPLATE(copy, Container)->RangeMultiplier(32)->Range(1 << 10, 1 << 20); \
+	BENCHMARK_TEMPLATE(small, Container)
+
+typedef std::vector<TType> StdVector;
+typedef Vector<TType, Allocator<TType>> DoubleVector;
+typedef Vector<TType, Allocator<TType>, growth::OneAndHalf> OneAndHalfVector;
+typedef Vector<TType, Allocator<TType>, growth::CappedChunk<>> CappedChunkVector;
+typedef SmallVector<TType, 8> SmallVector8;
+
+CONTAINER_BENCHMARKS(StdVector);
+CONTAINER_BENCHMARKS(DoubleVector);
+CONTAINER_BENCHMARKS(OneAndHalfVector);
+CONTAINER_BENCHMARKS(CappedChunkVector);
+CONTAINER_BENCHMARKS(SmallVector8);
+
+typedef SegmentedVector<TType, Allocator<TType>> Segmented;
+
+BENCHMARK_TEMPLATE(push_back, Segmented)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(reserve_resize, Segmented)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(copy, Segmented)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(push_back_latency, StdVector)->Arg(1 << 20)->Arg(1 << 23)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(push_back_latency, DoubleVector)->Arg(1 << 20)->Arg(1 << 23)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(push_back_latency, Segmented)->Arg(1 << 20)->Arg(1 << 23)->Unit(benchmark::kMillisecond);
+
+#define PEAK_RSS_BENCHMARK(Container) \
+	BENCHMARK_TEMPLATE(push_back_peak_rss, Container)->Arg(1 << 20)->Arg(3 << 22)->Iterations(1)->Unit(benchmark::kMillisecond)
+
+PEAK_RSS_BENCHMARK(StdVector);
+PEAK_RSS_BENCHMARK(DoubleVector);
+PEAK_RSS_BENCHMARK(OneAndHalfVector);
+PEAK_RSS_BENCHMARK(CappedChunkVector);
+PEAK_RSS_BENCHMARK(Segmented);
+
+// Temporary file removed at the end of the benchmark
+struct TemporaryFile {
+	std::string path;
+
+	TemporaryFile() {
+		char name[] = "/tmp/benchmark_mapped_XXXXXX";
+		close(mkstemp(name));
+		path = name;
+	}
+
+	~TemporaryFile() {
+		unlink(path.c_str());
+	}
+};
+
+// Growth by ftruncate and mremap instead of copying
+void mapped_push_back(benchmark::State& state) {
+	TemporaryFile file;
+	for(auto _ : state) {
+		MappedVector<TType> container(file.path);
+		container.clear();
+		container.shrink_to_fit();
+		for(int i = 0; i < state.range(0); i++) {
+			container.push_back(i);
+		}
+		benchmark::DoNotOptimize(container.data());
+	}
+	state.SetItemsProcessed(state.iterations()*state.range(0));
+}
+
+// Reopening a stored vector, the data is ready without parsing
+void mapped_reopen(benchmark::State& state) {
+	TemporaryFile file;
+	{
+		MappedVector<TType> container(file.path);
+		container.resize(state.range(0), 1);
+	}
+	for(auto _ : state) {
+		MappedVector<TType> container(file.path);
+		benchmark::DoNotOptimize(container.back());
+	}
+}
+
+// Round trip through the binary format
+void serialization_save_load(benchmark::State& state) {
+	TemporaryFile file;
+	std::vector<TType> sample = make_pattern(random_pattern, state.range(0));
+	DoubleVector container(sample.begin(), sample.end());
+	DoubleVector loaded;
+	for(auto _ : state) {
+		serialization::save(file.path, container);
+		serialization::load(file.path, loaded);
+		benchmark::DoNotOptimize(loaded.begin());
+	}
+	state.SetBytesProcessed(state.iterations()*state.range(0)*sizeof(TType)*2);
+}
+
+// Same round trip through Writer and Reader in chunks of 64K elements
+void serialization_streaming(benchmark::State& state) {
+	TemporaryFile file;
+	std::vector<TType> sample = make_pattern(random_pattern, state.range(0));
+	const std::size_t chunk_size = 1 << 16;
+	DoubleVector chunk;
+	for(auto _ : state) {
+		{
+			serialization::Writer<TType> writer(file.path);
+			for(std::size_t i = 0; i < sample.size(); i += chunk_size) {
+				writer.write(sample.data() + i, std::min(chunk_size, sample.size() - i));
+			}
+		}
+		serialization::Reader<TType> reader(file.path);
+		while (reader.read(chunk, chunk_size) > 0) {
+			benchmark::DoNotOptimize(chunk.begin());
+		}
+	}
+	state.SetBytesProcessed(state.iterations()*state.range(0)*sizeof(TType)*2);
+}
+
+// The naive alternative: formatted iostream output, element by element
+void serialization_iostream(benchmark::State& state) {
+	TemporaryFile file;
+	std::vector<TType> sample = make_pattern(random_pattern, state.range(0));
+	DoubleVector loaded;
+	for(auto _ : state) {
+		{
+			std::ofstream out(file.path);
+			out << sample.size() << '\n';
+			for(TType value : sample) {
+				out << value << ' ';
+			}
+		}
+		std::ifstream in(file.path);
+		std::size_t size = 0;
+		in >> size;
+		loaded.clear();
+		for(std::size_t i = 0; i < size; i++) {
+			TType value;
+			in >> value;
+			loaded.push_back(value);
+		}
+		benchmark::DoNotOptimize(loaded.begin());
+	}
+	state.SetBytesProcessed(state.iterations()*state.range(0)*sizeof(TType)*2);
+}
+
+BENCHMARK(serialization_save_load)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+BENCHMARK(serialization_streaming)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+BENCHMARK(serialization_iostream)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+
+BENCHMARK(mapped_push_back)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+BENCHMARK(mapped_reopen)->RangeMultiplier(32)->Range(1 << 10, 1 << 25);
+
+// Columns
+
+// The same rows stored as structures and as columns
+struct Record {
+	std::int64_t id;
+	double price;
+	std::int32_t quantity;
+};
+
+typedef SoAVector<std::int64_t, double, std::int32_t> Records;
+
+template<class Container>
+Container make_records(int a_size);
+
+template<>
+Vector<Record> make_records<Vector<Record>>(int a_size) {
+	std::vector<TType> sample = make_pattern(random_pattern, a_size);
+	Vector<Record> records;
+	for(int i = 0; i < a_size; i++) {
+		records.push_back(Record{i, double(sample[i]), sample[i] & 0xff});
+	}
+	return records;
+}
+
+template<>
+Records make_records<Records>(int a_size) {
+	std::vector<TType> sample = make_pattern(random_pattern, a_size);
+	Records records;
+	for(int i = 0; i < a_size; i++) {
+		records.emplace_back(i, double(sample[i]), sample[i] & 0xff);
+	}
+	return records;
+}
+
+// Sum of one field: the columns read 8 bytes per row, the structures 24
+void aos_scan(benchmark::State& state) {
+	Vector<Record> records = make_records<Vector<Record>>(state.range(0));
+	for(auto _ : state) {
+		double sum = 0;
+		for(const Record& record : records) {
+			sum += record.price;
+		}
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetBytesProcessed(state.iterations()*state.range(0)*sizeof(Record));
+}
+
+void soa_scan(benchmark::State& state) {
+	Records records = make_records<Records>(state.range(0));
+	for(auto _ : state) {
+		double sum = 0;
+		for(double price : records.column<1>()) {
+			sum += price;
+		}
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetBytesProcessed(state.iterations()*state.range(0)*sizeof(double));
+}
+
+void aos_sort(benchmark::State& state) {
+	Vector<Record> sample = make_records<Vector<Record>>(state.range(0));
+	for(auto _ : state) {
+		state.PauseTiming();
+		Vector<Record> records(sample);
+		state.ResumeTiming();
+		custom::sort(records.begin(), records.end(), [](const Record& a, const Record& b) {
+			return a.price < b.price;
+		});
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*state.range(0));
+}
+
+// Rows swapped one by one through the proxy references
+void soa_sort_rows(benchmark::State& state) {
+	Records sample = make_records<Records>(state.range(0));
+	for(auto _ : state) {
+		state.PauseTiming();
+		Records records(sample);
+		state.ResumeTiming();
+		custom::sort(records.begin(), records.end(), field_less<1>());
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*state.range(0));
+}
+
+// Key column sorted with row numbers, then every column gathered
+void soa_sort_by(benchmark::State& state) {
+	Records sample = make_records<Records>(state.range(0));
+	for(auto _ : state) {
+		state.PauseTiming();
+		Records records(sample);
+		state.ResumeTiming();
+		records.sort_by<1>();
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*state.range(0));
+}
+
+BENCHMARK(aos_scan)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+BENCHMARK(soa_scan)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+BENCHMARK(aos_sort)->RangeMultiplier(32)->Range(1 << 10, 1 << 20)->Unit(benchmark::kMicrosecond);
+BENCHMARK(soa_sort_rows)->RangeMultiplier(32)->Range(1 << 10, 1 << 20)->Unit(benchmark::kMicrosecond);
+BENCHMARK(soa_sort_by)->RangeMultiplier(32)->Range(1 << 10, 1 << 20)->Unit(benchmark::kMicrosecond);
+
+// Editing
+
+// Edits clustered around a cursor that drifts through the sequence:
+// eight insertions and one erasure of two elements per cursor position
+template<class Container>
+void cursor_edits(benchmark::State& state) {
+	std::vector<TType> sample = make_pattern(random_pattern, state.range(0));
+	for(auto _ : state) {
+		state.PauseTiming();
+		Container container(sample.begin(), sample.end());
+		std::mt19937 generator(1);
+		state.ResumeTiming();
+		std::size_t cursor = container.size()/2;
+		for(int step = 0; step < 1000; step++) {
+			cursor = std::min<std::size_t>(container.size() - 8, cursor + generator()%64 - 32);
+			for(int i = 0; i < 8; i++) {
+				container.insert(container.begin() + cursor + i, i);
+			}
+			container.erase(container.begin() + cursor, container.begin() + cursor + 2);
+		}
+		benchmark::DoNotOptimize(&*container.begin());
+	}
+	state.SetItemsProcessed(state.iterations()*9000);
+}
+
+typedef GapBuffer<TType, Allocator<TType>> Gap;
+
+BENCHMARK_TEMPLATE(cursor_edits, DoubleVector)->RangeMultiplier(32)->Range(1 << 10, 1 << 20)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(cursor_edits, Gap)->RangeMultiplier(32)->Range(1 << 10, 1 << 20)->Unit(benchmark::kMicrosecond);
+
+// Removal of every fourth element, one erase() each or one pass
+void erase_loop(benchmark::State& state) {
+	std::vector<TType> sample = make_pattern(random_pattern, state.range(0));
+	for(auto _ : state) {
+		state.PauseTiming();
+		DoubleVector container(sample.begin(), sample.end());
+		state.ResumeTiming();
+		for(DoubleVector::iterator i = container.begin(); i != container.end();) {
+			i = *i % 4 == 0 ? container.erase(i) : i + 1;
+		}
+		benchmark::DoNotOptimize(container.begin());
+	}
+	state.SetItemsProcessed(state.iterations()*state.range(0));
+}
+
+void erase_if_pass(benchmark::State& state) {
+	std::vector<TType> sample = make_pattern(random_pattern, state.range(0));
+	for(auto _ : state) {
+		state.PauseTiming();
+		DoubleVector container(sample.begin(), sample.end());
+		state.ResumeTiming();
+		erase_if(container, [](TType a) {
+			return a % 4 == 0;
+		});
+		benchmark::DoNotOptimize(container.begin());
+	}
+	state.SetItemsProcessed(state.iterations()*state.range(0));
+}
+
+BENCHMARK(erase_loop)->RangeMultiplier(8)->Range(1 << 10, 1 << 16)->Unit(benchmark::kMicrosecond);
+BENCHMARK(erase_if_pass)->RangeMultiplier(8)->Range(1 << 10, 1 << 16)->Unit(benchmark::kMicrosecond);
+
+// Concurrent ingestion
+
+// Vector behind one mutex, the usual way to share it between producers
+struct LockedVector {
+	std::mutex lock;
+	DoubleVector vector;
+
+	void push_back(TType a_value) {
+		std::lock_guard<std::mutex> guard(lock);
+		vector.push_back(a_value);
+	}
+};
+
+// 1M elements pushed by state.range(0) producer threads
+template<class Container>
+void producers(benchmark::State& state) {
+	const int total = 1 << 20;
+	int threads = state.range(0);
+	for(auto _ : state) {
+		Container container;
+		Vector<std::thread> producers;
+		for(int t = 0; t < threads; t++) {
+			producers.push_back(std::thread([&container, t, threads, total]() {
+				for(int i = t; i < total; i += threads) {
+					container.push_back(i);
+				}
+			}));
+		}
+		for(std::thread& producer : producers) {
+			producer.join();
+		}
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*total);
+}
+
+void producer_arguments(benchmark::internal::Benchmark* a_benchmark) {
+	int most = std::max(4u, std::thread::hardware_concurrency());
+	for(int threads = 1; threads <= most; threads *= 2) {
+		a_benchmark->Arg(threads);
+	}
+}
+
+BENCHMARK_TEMPLATE(producers, LockedVector)->Apply(producer_arguments)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(producers, ConcurrentVector<TType>)->Apply(producer_arguments)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// Parallel bulk algorithms
+
+// 128MB of doubles, built and summed by state.range(0) threads in all;
+// one thread is the serial code path
+const int bulk_size = 1 << 24;
+
+void bulk_fill_construct(benchmark::State& state) {
+	ThreadPool pool(state.range(0) - 1);
+	for(auto _ : state) {
+		if (state.range(0) == 1) {
+			Vector<double> values(bulk_size, 1.0);
+			benchmark::DoNotOptimize(values.begin());
+		} else {
+			Vector<double> values;
+			custom::parallel_resize(values, bulk_size, 1.0, pool);
+			benchmark::DoNotOptimize(values.begin());
+		}
+	}
+	state.SetBytesProcessed(state.iterations()*bulk_size*sizeof(double));
+}
+
+void bulk_reduce(benchmark::State& state) {
+	ThreadPool pool(state.range(0) - 1);
+	Vector<double> values;
+	custom::parallel_resize(values, bulk_size, 1.0, pool);
+	for(auto _ : state) {
+		double sum = state.range(0) == 1
+			? std::accumulate(values.begin(), values.end(), 0.0)
+			: custom::parallel_reduce(values.begin(), values.end(), 0.0, pool);
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetBytesProcessed(state.iterations()*bulk_size*sizeof(double));
+}
+
+void bulk_count_if(benchmark::State& state) {
+	ThreadPool pool(state.range(0) - 1);
+	Vector<double> values;
+	custom::parallel_resize(values, bulk_size, 1.0, pool);
+	auto negative = [](double a) {
+		return a < 0;
+	};
+	for(auto _ : state) {
+		std::ptrdiff_t count = state.range(0) == 1
+			? std::count_if(values.begin(), values.end(), negative)
+			: custom::parallel_count_if(values.begin(), values.end(), negative, pool);
+		benchmark::DoNotOptimize(count);
+	}
+	state.SetBytesProcessed(state.iterations()*bulk_size*sizeof(double));
+}
+
+BENCHMARK(bulk_fill_construct)->Apply(producer_arguments)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(bulk_reduce)->Apply(producer_arguments)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(bulk_count_if)->Apply(producer_arguments)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// Uninitialized resize
+
+typedef Vector<std::uint8_t, Allocator<std::uint8_t>> Bytes;
+
+// A fresh buffer of state.range(0) bytes, all of it overwritten as a
+// decoder or a socket read would
+void overwrite(std::uint8_t* a_buffer, std::size_t a_size) {
+	std::memset(a_buffer, 0x5a, a_size);
+	benchmark::ClobberMemory();
+}
+
+void resize_value_init(benchmark::State& state) {
+	for(auto _ : state) {
+		Bytes buffer;
+		buffer.resize(state.range(0));
+		overwrite(buffer.data(), buffer.size());
+	}
+	state.SetBytesProcessed(state.iterations()*state.range(0));
+}
+
+void resize_default_init(benchmark::State& state) {
+	for(auto _ : state) {
+		Bytes buffer;
+		buffer.resize_default_init(state.range(0));
+		overwrite(buffer.data(), buffer.size());
+	}
+	state.SetBytesProcessed(state.iterations()*state.range(0));
+}
+
+void resize_and_overwrite(benchmark::State& state) {
+	for(auto _ : state) {
+		Bytes buffer;
+		buffer.resize_and_overwrite(state.range(0), [](std::uint8_t* a_buffer, std::size_t a_size) {
+			overwrite(a_buffer, a_size);
+			return a_size;
+		});
+	}
+	state.SetBytesProcessed(state.iterations()*state.range(0));
+}
+
+BENCHMARK(resize_value_init)->RangeMultiplier(16)->Range(1 << 12, 1 << 28)->Unit(benchmark::kMicrosecond);
+BENCHMARK(resize_default_init)->RangeMultiplier(16)->Range(1 << 12, 1 << 28)->Unit(benchmark::kMicrosecond);
+BENCHMARK(resize_and_overwrite)->RangeMultiplier(16)->Range(1 << 12, 1 << 28)->Unit(benchmark::kMicrosecond);
+
+// Memory reclamation
+
+// 64 vectors each spike to state.range(0) elements, settle back to 16
+// and then see steady small traffic. retained is the capacity they hold
+// in bytes at the end.
+template<class R>
+void spike(benchmark::State& state, bool a_shrink) {
+	typedef Vector<TType, Allocator<TType>, growth::Double, stats::Counting, R> Spiky;
+	std::size_t retained = 0;
+	for(auto _ : state) {
+		std::vector<Spiky> vectors(64);
+		for(Spiky& container : vectors) {
+			for(TType i = 0; i < state.range(0); i++) {
+				container.push_back(i);
+			}
+			container.erase(container.begin() + 16, container.end());
+			if (a_shrink) {
+				container.shrink_to_fit();
+			}
+			for(int i = 0; i < 2048; i++) {
+				container.push_back(i);
+				container.pop_back();
+			}
+		}
+		retained = 0;
+		for(const Spiky& container : vectors) {
+			retained += container.stats().counters().bytes;
+		}
+		benchmark::DoNotOptimize(vectors.data());
+	}
+	state.counters["retained"] = retained;
+	state.SetItemsProcessed(state.iterations()*64*(state.range(0) + 2*2048));
+}
+
+void spike_keep(benchmark::State& state) {
+	spike<reclaim::Never>(state, false);
+}
+
+void spike_shrink_to_fit(benchmark::State& state) {
+	spike<reclaim::Never>(state, true);
+}
+
+void spike_idle_decay(benchmark::State& state) {
+	spike<reclaim::Idle<>>(state, false);
+}
+
+BENCHMARK(spike_keep)->RangeMultiplier(16)->Range(1 << 12, 1 << 20)->Unit(benchmark::kMicrosecond);
+BENCHMARK(spike_shrink_to_fit)->RangeMultiplier(16)->Range(1 << 12, 1 << 20)->Unit(benchmark::kMicrosecond);
+BENCHMARK(spike_idle_decay)->RangeMultiplier(16)->Range(1 << 12, 1 << 20)->Unit(benchmark::kMicrosecond);
+
+// Allocators
+
+// Many short-lived vectors of 0-63 elements
+template<class A>
+void churn(benchmark::State& state) {
+	int count = 0;
+	for(auto _ : state) {
+		Vector<TType, A> container;
+		for(int j = 0; j < count%64; j++) {
+			container.push_back(j);
+		}
+		benchmark::DoNotOptimize(container);
+		count++;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+
+// Same as churn(), the arena is reset after every 64 vectors
+void arena_churn(benchmark::State& state) {
+	Arena arena;
+	ArenaAllocator<TType> allocator(arena);
+	int count = 0;
+	for(auto _ : state) {
+		{
+			Vector<TType, ArenaAllocator<TType>> container(allocator);
+			for(int j = 0; j < count%64; j++) {
+				container.push_back(j);
+			}
+			benchmark::DoNotOptimize(container);
+		}
+		if (++count%64 == 0) {
+			arena.reset();
+		}
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+
+typedef PoolAllocator<TType, false> PoolAllocatorNoCache;
+
+BENCHMARK_TEMPLATE(churn, std::allocator<TType>);
+BENCHMARK_TEMPLATE(churn, Allocator<TType>);
+BENCHMARK_TEMPLATE(churn, PoolAllocatorNoCache);
+BENCHMARK_TEMPLATE(churn, PoolAllocator<TType>);
+BENCHMARK(arena_churn);
+
+// Sorts
+
+struct StdSort {
+	template<class iterator>
+	void operator()(iterator first, iterator last) const {
+		std::sort(first, last);
+	}
+};
+
+struct CustomSort {
+	template<class iterator>
+	void operator()(iterator first, iterator last) const {
+		custom::sort(first, last);
+	}
+};
+
+// Generic comparison path, bypasses the SIMD kernels
+struct CustomSortCompare {
+	template<class iterator>
+	void operator()(iterator first, iterator last) const {
+		custom::sort(first, last, std::less<TType>());
+	}
+};
+
+struct CustomRadixSort {
+	template<class iterator>
+	void operator()(iterator first, iterator last) const {
+		custom::radix_sort(first, last);
+	}
+};
+
+struct CustomParallelSort {
+	template<class iterator>
+	void operator()(iterator first, iterator last) const {
+		custom::parallel_sort(first, last);
+	}
+};
+
+struct StdStableSort {
+	template<class iterator>
+	void operator()(iterator first, iterator last) const {
+		std::stable_sort(first, last);
+	}
+};
+
+struct CustomStableSort {
+	template<class iterator>
+	void operator()(iterator first, iterator last) const {
+		custom::stable_sort(first, last);
+	}
+};
+
+// The smallest 1%
+struct StdPartialSort {
+	template<class iterator>
+	void operator()(iterator first, iterator last) const {
+		std::partial_sort(first, first + (last - first)/100, last);
+	}
+};
+
+struct CustomPartialSort {
+	template<class iterator>
+	void operator()(iterator first, iterator last) const {
+		custom::partial_sort(first, first + (last - first)/100, last);
+	}
+};
+
+// The median
+struct StdNthElement {
+	template<class iterator>
+	void operator()(iterator first, iterator last) const {
+		std::nth_element(first, first + (last - first)/2, last);
+	}
+};
+
+struct CustomNthElement {
+	template<class iterator>
+	void operator()(iterator first, iterator last) const {
+		custom::nth_element(first, first + (last - first)/2, last);
+	}
+};
+
+// Arguments are the size and the Pattern
+template<class Container, class Sort>
+void sort(benchmark::State& state) {
+	std::vector<TType> sample = make_pattern(state.range(1), state.range(0));
+	Container container(sample.begin(), sample.end());
+	for(auto _ : state) {
+		state.PauseTiming();
+		std::copy(sample.begin(), sample.end(), container.begin());
+		state.ResumeTiming();
+		Sort()(container.begin(), container.end());
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations()*state.range(0));
+	state.SetLabel(pattern_names[state.range(1)]);
+}
+
+void sort_arguments(benchmark::internal::Benchmark* a_benchmark) {
+	for(int size : {1 << 10, 1 << 16, 1 << 20}) {
+		for(int pattern = random_pattern; pattern <= nearly_sorted_pattern; pattern++) {
+			a_benchmark->Args({size, pattern});
+		}
+	}
+}
+
+#define SORT_BENCHMARK(Container, Sort) \
+	BENCHMARK_TEMPLATE(sort, Container, Sort)->Apply(sort_arguments)->Unit(benchmark::kMicrosecond)
+
+SORT_BENCHMARK(StdVector, StdSort);
+SORT_BENCHMARK(DoubleVector, StdSort);
+SORT_BENCHMARK(StdVector, CustomSort);
+SORT_BENCHMARK(DoubleVector, CustomSort);
+SORT_BENCHMARK(DoubleVector, CustomSortCompare);
+SORT_BENCHMARK(Segmented, CustomSort);
+SORT_BENCHMARK(DoubleVector, CustomRadixSort);
+SORT_BENCHMARK(DoubleVector, CustomParallelSort);
+SORT_BENCHMARK(DoubleVector, StdStableSort);
+SORT_BENCHMARK(DoubleVector, CustomStableSort);
+SORT_BENCHMARK(DoubleVector, StdPartialSort);
+SORT_BENCHMARK(DoubleVector, CustomPartialSort);
+SORT_BENCHMARK(DoubleVector, StdNthElement);
+SORT_BENCHMARK(DoubleVector, CustomNthElement);
+
+// Arguments are the size and the number of threads, the calling one
+// included. speedup is against custom::sort() with the same comparison
+// on one thread.
+void parallel_sort_threads(benchmark::State& state) {
+	std::vector<TType> sample = make_pattern(random_pattern, state.range(0));
+	DoubleVector container(sample.begin(), sample.end());
+	auto serial_start = std::chrono::steady_clock::now();
+	custom::sort(container.begin(), container.end(), std::less<>());
+	std::chrono::duration<double> serial = std::chrono::steady_clock::now() - serial_start;
+	ThreadPool pool(state.range(1) - 1);
+	std::chrono::duration<double> parallel(0);
+	for(auto _ : state) {
+		state.PauseTiming();
+		std::copy(sample.begin(), sample.end(), container.begin());
+		state.ResumeTiming();
+		auto start = std::chrono::steady_clock::now();
+		custom::parallel_sort(container.begin(), container.end(), std::less<>(), pool);
+		parallel += std::chrono::steady_clock::now() - start;
+		benchmark::ClobberMemory();
+	}
+	state.counters["speedup"] = serial.count()*state.iterations()/parallel.count();
+	state.SetItemsProcessed(state.iterations()*state.range(0));
+}
+
+// 1M and 3M elements on 1, 2, 4, 8 and all hardware threads
+void thread_arguments(benchmark::internal::Benchmark* a_benchmark) {
+	std::vector<int> counts = {1, 2, 4, 8};
+	int all = std::thread::hardware_concurrency();
+	if (std::find(counts.begin(), counts.end(), all) == counts.end()) {
+		counts.push_back(all);
+	}
+	for(int size : {1000000, 3000000}) {
+		for(int threads : counts) {
+			a_benchmark->Args({size, threads});
+		}
+	}
+}
+
+BENCHMARK(parallel_sort_threads)->Apply(thread_arguments)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+int main(int argc, char** argv) {
+	// Defaults first, so that the same flags on the command line win
+	std::vector<std::string> defaults = {
+		"--benchmark_repetitions=5",
+		"--benchmark_report_aggregates_only=true",
+		"--benchmark_min_warmup_time=0.1"
+	};
+	std::vector<char*> arguments;
+	arguments.push_back(argv[0]);
+	for(std::string& flag : defaults) {
+		arguments.push_back(&flag[0]);
+	}
+	for(int i = 1; i < argc; i++) {
+		arguments.push_back(argv[i]);
+	}
+	int count = arguments.size();
+	benchmark::Initialize(&count, arguments.data());
+	if (benchmark::ReportUnrecognizedArguments(count, arguments.data())) {
+		return 1;
+	}
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}
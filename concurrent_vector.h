@@ -0,0 +1,231 @@
+#pragma once
+
+#include <cstddef>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+// Segments needed to cover every index when the first one holds
+// a_first_segment elements and each next one twice as many
+constexpr std::size_t concurrent_segment_count(std::size_t a_first_segment) {
+	std::size_t count = sizeof(std::size_t)*8;
+	while (a_first_segment > 1) {
+		a_first_segment /= 2;
+		--count;
+	}
+	return count;
+}
+
+// Append-only vector for many producers. push_back claims a slot with one
+// fetch_add and constructs the element in place; storage grows by segments
+// that double in size and are never moved or freed before destruction,
+// so element addresses stay valid and readers need no lock.
+//
+// A slot counts in size() as soon as it is claimed, before its element
+// is built. Each slot has a flag, set with release order once the element
+// is complete: published(i) tells whether element i may be read. If the
+// constructor of an element throws, its slot stays unpublished.
+// operator[] is wait-free and does not check the flag.
+//
+// clear() and the destructor must not run concurrently with anything else.
+template<class T, class A = std::allocator<T>, std::size_t FirstSegment = 32>
+class ConcurrentVector {
+	static_assert(FirstSegment > 0 && (FirstSegment & (FirstSegment - 1)) == 0, "first segment size must be a power of two");
+
+public:
+	typedef A allocator_type;
+	typedef T           value_type;
+	typedef T&          reference;
+	typedef const T&    const_reference;
+	typedef std::size_t size_type;
+	typedef T*          pointer;
+
+	static const size_type first_segment = FirstSegment;
+
+	explicit ConcurrentVector(const allocator_type& alloc = allocator_type()) : m_size(0), m_allocator(alloc) {
+		for(std::atomic<pointer>& segment : m_segments) {
+			segment.store(nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	ConcurrentVector(const ConcurrentVector&) = delete;
+	ConcurrentVector& operator=(const ConcurrentVector&) = delete;
+
+	~ConcurrentVector() {
+		clear();
+		for(size_type k = 0; k < segment_count; k++) {
+			pointer segment = m_segments[k].load(std::memory_order_relaxed);
+			if (segment != nullptr) {
+				m_allocator.deallocate(segment, segment_allocation(k));
+			}
+		}
+	}
+
+// Capacity
+
+	// Slots claimed so far, including elements still being built
+	size_type size() const {
+		return m_size.load(std::memory_order_acquire);
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+
+	// Slots in the segments allocated from the front
+	size_type capacity() const {
+		size_type k = 0;
+		while (k < segment_count && m_segments[k].load(std::memory_order_acquire) != nullptr) {
+			++k;
+		}
+		return segment_start(k);
+	}
+
+	// Safe to call while producers push
+	void reserve(size_type a_size) {
+		for(size_type k = 0; k < segment_count && segment_start(k) < a_size; k++) {
+			acquire_segment(k);
+		}
+	}
+
+// Element access
+
+	bool published(size_type a_index) const {
+		if (a_index >= size()) {
+			return false;
+		}
+		size_type k = segment_of(a_index);
+		pointer segment = m_segments[k].load(std::memory_order_acquire);
+		return segment != nullptr && flags(segment, k)[a_index - segment_start(k)].load(std::memory_order_acquire);
+	}
+
+	reference operator[](size_type a_index) {
+		size_type k = segment_of(a_index);
+		return m_segments[k].load(std::memory_order_acquire)[a_index - segment_start(k)];
+	}
+
+	const_reference operator[](size_type a_index) const {
+		size_type k = segment_of(a_index);
+		return m_segments[k].load(std::memory_order_acquire)[a_index - segment_start(k)];
+	}
+
+	reference at(size_type a_index) {
+		if (!published(a_index)) {
+			throw std::out_of_range("custom concurrent vector out of range");
+		}
+		return (*this)[a_index];
+	}
+
+	const_reference at(size_type a_index) const {
+		if (!published(a_index)) {
+			throw std::out_of_range("custom concurrent vector out of range");
+		}
+		return (*this)[a_index];
+	}
+
+// Modifiers
+
+	// Lock-free, returns the index of the new element
+	template<class... Args>
+	size_type emplace_back(Args&&... args) {
+		size_type index = m_size.fetch_add(1, std::memory_order_relaxed);
+		size_type k = segment_of(index);
+		size_type offset = index - segment_start(k);
+		pointer segment = acquire_segment(k);
+		// The first producer in a segment prepares the next one, so that
+		// the others rarely find it missing and allocate it in parallel
+		if (offset == 0 && k + 1 < segment_count) {
+			acquire_segment(k + 1);
+		}
+		m_allocator.construct(segment + offset, std::forward<Args>(args)...);
+		flags(segment, k)[offset].store(true, std::memory_order_release);
+		return index;
+	}
+
+	size_type push_back(const T& a_value) {
+		return emplace_back(a_value);
+	}
+
+	size_type push_back(T&& a_value) {
+		return emplace_back(std::move(a_value));
+	}
+
+	// Destroys the published elements and keeps the segments
+	void clear() {
+		size_type size = m_size.load(std::memory_order_relaxed);
+		for(size_type k = 0; k < segment_count && segment_start(k) < size; k++) {
+			pointer segment = m_segments[k].load(std::memory_order_relaxed);
+			if (segment == nullptr) {
+				continue;
+			}
+			std::atomic<bool>* ready = flags(segment, k);
+			size_type count = std::min(segment_size(k), size - segment_start(k));
+			for(size_type i = 0; i < count; i++) {
+				if (ready[i].load(std::memory_order_relaxed)) {
+					m_allocator.destroy(segment + i);
+					ready[i].store(false, std::memory_order_relaxed);
+				}
+			}
+		}
+		m_size.store(0, std::memory_order_release);
+	}
+
+private:
+	typedef std::atomic<bool> flag_type;
+
+	static const size_type segment_count = concurrent_segment_count(FirstSegment);
+
+	std::atomic<size_type> m_size;
+	std::atomic<pointer> m_segments[segment_count];
+	allocator_type m_allocator;
+
+	// Segment k holds FirstSegment << k slots
+	static size_type segment_of(size_type a_index) {
+		return sizeof(unsigned long long)*8 - 1 - __builtin_clzll(a_index/FirstSegment + 1);
+	}
+
+	static size_type segment_start(size_type k) {
+		return FirstSegment*((size_type(1) << k) - 1);
+	}
+
+	static size_type segment_size(size_type k) {
+		return FirstSegment << k;
+	}
+
+	// Elements followed by their flags, counted in elements
+	static size_type segment_allocation(size_type k) {
+		return segment_size(k) + (segment_size(k)*sizeof(flag_type) + sizeof(T) - 1)/sizeof(T);
+	}
+
+	static flag_type* flags(pointer a_segment, size_type k) {
+		return reinterpret_cast<flag_type*>(a_segment + segment_size(k));
+	}
+
+	// Installs segment k if no other thread did; the loser of the race
+	// frees its copy
+	pointer acquire_segment(size_type k) {
+		pointer segment = m_segments[k].load(std::memory_order_acquire);
+		if (segment != nullptr) {
+			return segment;
+		}
+		pointer created = m_allocator.allocate(segment_allocation(k));
+		flag_type* ready = flags(created, k);
+		for(size_type i = 0; i < segment_size(k); i++) {
+			new (ready + i) flag_type(false);
+		}
+		if (m_segments[k].compare_exchange_strong(segment, created, std::memory_order_acq_rel, std::memory_order_acquire)) {
+			return created;
+		}
+		m_allocator.deallocate(created, segment_allocation(k));
+		return segment;
+	}
+};
+
+template<class T, class A, std::size_t FirstSegment>
+const typename ConcurrentVector<T, A, FirstSegment>::size_type ConcurrentVector<T, A, FirstSegment>::first_segment;
+
+template<class T, class A, std::size_t FirstSegment>
+const typename ConcurrentVector<T, A, FirstSegment>::size_type ConcurrentVector<T, A, FirstSegment>::segment_count;
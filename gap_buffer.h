@@ -0,0 +1,631 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "vector.h"
+#include "growth_policy.h"
+
+// Sequence for editing workloads: the free capacity is a gap kept where
+// the last insertion or erasure happened, so edits clustered around a
+// cursor only move the elements between the old and the new position
+// instead of the whole tail. Elements before the gap sit at the front of
+// the buffer and the others at its back.
+//
+// Iterators hide the gap. data() closes it by moving it to the end, so
+// the elements become contiguous until the next edit away from the end.
+// Any edit, and data(), invalidates iterators, pointers and references.
+template<class T, class A = std::allocator<T>, class G = growth::Default>
+class GapBuffer {
+public:
+	typedef A allocator_type;
+	typedef G growth_policy;
+	typedef typename A::value_type      value_type;
+	typedef typename A::reference       reference;
+	typedef typename A::const_reference const_reference;
+	typedef typename A::size_type       size_type;
+	typedef typename A::difference_type difference_type;
+	typedef typename A::pointer         pointer;
+	typedef typename A::const_pointer   const_pointer;
+
+	template<class Value>
+	class basic_iterator {
+		typedef typename std::conditional<std::is_const<Value>::value, const GapBuffer, GapBuffer>::type owner_type;
+
+	public:
+		typedef std::random_access_iterator_tag iterator_category;
+		typedef typename std::remove_const<Value>::type value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef Value* pointer;
+		typedef Value& reference;
+
+		basic_iterator() : m_owner(nullptr), m_index(0) {
+		}
+
+		basic_iterator(owner_type* a_owner, size_type a_index) : m_owner(a_owner), m_index(a_index) {
+		}
+
+		// iterator converts to const_iterator
+		template<class Other, typename = typename std::enable_if<std::is_convertible<Other*, Value*>::value>::type>
+		basic_iterator(const basic_iterator<Other>& other) : m_owner(other.m_owner), m_index(other.m_index) {
+		}
+
+		reference operator*() const {
+			return *m_owner->slot(m_index);
+		}
+
+		pointer operator->() const {
+			return m_owner->slot(m_index);
+		}
+
+		reference operator[](difference_type a_offset) const {
+			return *m_owner->slot(m_index + a_offset);
+		}
+
+		basic_iterator& operator++() {
+			++m_index;
+			return *this;
+		}
+
+		basic_iterator operator++(int) {
+			basic_iterator old(*this);
+			++m_index;
+			return old;
+		}
+
+		basic_iterator& operator--() {
+			--m_index;
+			return *this;
+		}
+
+		basic_iterator operator--(int) {
+			basic_iterator old(*this);
+			--m_index;
+			return old;
+		}
+
+		basic_iterator& operator+=(difference_type a_offset) {
+			m_index += a_offset;
+			return *this;
+		}
+
+		basic_iterator& operator-=(difference_type a_offset) {
+			m_index -= a_offset;
+			return *this;
+		}
+
+		basic_iterator operator+(difference_type a_offset) const {
+			return basic_iterator(m_owner, m_index + a_offset);
+		}
+
+		friend basic_iterator operator+(difference_type a_offset, const basic_iterator& a_iterator) {
+			return a_iterator + a_offset;
+		}
+
+		basic_iterator operator-(difference_type a_offset) const {
+			return basic_iterator(m_owner, m_index - a_offset);
+		}
+
+		template<class Other>
+		difference_type operator-(const basic_iterator<Other>& other) const {
+			return difference_type(m_index) - difference_type(other.m_index);
+		}
+
+		template<class Other>
+		bool operator==(const basic_iterator<Other>& other) const {
+			return m_index == other.m_index;
+		}
+
+		template<class Other>
+		bool operator!=(const basic_iterator<Other>& other) const {
+			return m_index != other.m_index;
+		}
+
+		template<class Other>
+		bool operator<(const basic_iterator<Other>& other) const {
+			return m_index < other.m_index;
+		}
+
+		template<class Other>
+		bool operator>(const basic_iterator<Other>& other) const {
+			return m_index > other.m_index;
+		}
+
+		template<class Other>
+		bool operator<=(const basic_iterator<Other>& other) const {
+			return m_index <= other.m_index;
+		}
+
+		template<class Other>
+		bool operator>=(const basic_iterator<Other>& other) const {
+			return m_index >= other.m_index;
+		}
+
+	private:
+		template<class> friend class basic_iterator;
+
+		owner_type* m_owner;
+		size_type m_index;
+	};
+
+	typedef basic_iterator<T>       iterator;
+	typedef basic_iterator<const T> const_iterator;
+	typedef std::reverse_iterator<iterator> reverse_iterator;
+	typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+private:
+	typedef std::allocator_traits<A> allocator_traits;
+
+	pointer m_begin;
+	pointer m_gap_begin;
+	pointer m_gap_end;
+	pointer m_memory_end;
+	allocator_type m_allocator;
+
+public:
+// Constructors
+
+	GapBuffer() : m_begin(nullptr), m_gap_begin(nullptr), m_gap_end(nullptr), m_memory_end(nullptr) {
+	}
+
+	explicit GapBuffer(const allocator_type& alloc)
+		: m_begin(nullptr), m_gap_begin(nullptr), m_gap_end(nullptr), m_memory_end(nullptr), m_allocator(alloc) {
+	}
+
+	explicit GapBuffer(size_type a_size, const allocator_type& alloc = allocator_type())
+		: m_begin(nullptr), m_gap_begin(nullptr), m_gap_end(nullptr), m_memory_end(nullptr), m_allocator(alloc) {
+		construct_with([this, a_size]() {
+			resize(a_size);
+		});
+	}
+
+	GapBuffer(size_type a_size, const_reference a_value, const allocator_type& alloc = allocator_type())
+		: m_begin(nullptr), m_gap_begin(nullptr), m_gap_end(nullptr), m_memory_end(nullptr), m_allocator(alloc) {
+		construct_with([this, a_size, &a_value]() {
+			insert(end(), a_size, a_value);
+		});
+	}
+
+	GapBuffer(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type())
+		: m_begin(nullptr), m_gap_begin(nullptr), m_gap_end(nullptr), m_memory_end(nullptr), m_allocator(alloc) {
+		construct_with([this, il]() {
+			insert(end(), il.begin(), il.end());
+		});
+	}
+
+	template <class InputIterator, typename = typename std::iterator_traits<InputIterator>::iterator_category>
+	GapBuffer(InputIterator a_first, InputIterator a_last, const allocator_type& alloc = allocator_type())
+		: m_begin(nullptr), m_gap_begin(nullptr), m_gap_end(nullptr), m_memory_end(nullptr), m_allocator(alloc) {
+		construct_with([this, a_first, a_last]() {
+			insert(end(), a_first, a_last);
+		});
+	}
+
+	GapBuffer(const GapBuffer& other)
+		: m_begin(nullptr), m_gap_begin(nullptr), m_gap_end(nullptr), m_memory_end(nullptr),
+		  m_allocator(allocator_traits::select_on_container_copy_construction(other.m_allocator)) {
+		construct_with([this, &other]() {
+			reserve(other.size());
+			insert(end(), other.begin(), other.end());
+		});
+	}
+
+	GapBuffer(GapBuffer&& other) noexcept
+		: m_begin(other.m_begin), m_gap_begin(other.m_gap_begin), m_gap_end(other.m_gap_end),
+		  m_memory_end(other.m_memory_end), m_allocator(std::move(other.m_allocator)) {
+		other.m_begin = other.m_gap_begin = other.m_gap_end = other.m_memory_end = nullptr;
+	}
+
+	GapBuffer& operator=(const GapBuffer& other) {
+		if (this != &other) {
+			GapBuffer copy(other);
+			swap(copy);
+		}
+		return *this;
+	}
+
+	GapBuffer& operator=(GapBuffer&& other) noexcept {
+		if (this != &other) {
+			free_storage();
+			swap(other);
+		}
+		return *this;
+	}
+
+	~GapBuffer() {
+		free_storage();
+	}
+
+// Iterators
+
+	iterator begin() {
+		return iterator(this, 0);
+	}
+
+	const_iterator begin() const {
+		return const_iterator(this, 0);
+	}
+
+	iterator end() {
+		return iterator(this, size());
+	}
+
+	const_iterator end() const {
+		return const_iterator(this, size());
+	}
+
+	reverse_iterator rbegin() {
+		return reverse_iterator(end());
+	}
+
+	const_reverse_iterator rbegin() const {
+		return const_reverse_iterator(end());
+	}
+
+	reverse_iterator rend() {
+		return reverse_iterator(begin());
+	}
+
+	const_reverse_iterator rend() const {
+		return const_reverse_iterator(begin());
+	}
+
+// Capacity
+
+	size_type size() const {
+		return (m_gap_begin - m_begin) + (m_memory_end - m_gap_end);
+	}
+
+	size_type capacity() const {
+		return m_memory_end - m_begin;
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+
+	// Index of the first element after the gap
+	size_type gap_position() const {
+		return m_gap_begin - m_begin;
+	}
+
+	// The gap ends up at the end
+	void reserve(size_type a_size) {
+		if (a_size > capacity()) {
+			move_gap(size());
+			reallocate(a_size);
+		}
+	}
+
+	void resize(size_type a_size) {
+		if (a_size <= size()) {
+			erase(begin() + a_size, end());
+			return;
+		}
+		open_gap(size(), a_size - size());
+		while (size() < a_size) {
+			m_allocator.construct(m_gap_begin, T());
+			++m_gap_begin;
+		}
+	}
+
+// Element access
+
+	// Moves the gap to the end so the elements are contiguous
+	pointer data() {
+		move_gap(size());
+		return m_begin;
+	}
+
+	reference front() {
+		return *slot(0);
+	}
+
+	const_reference front() const {
+		return *slot(0);
+	}
+
+	reference back() {
+		return *slot(size() - 1);
+	}
+
+	const_reference back() const {
+		return *slot(size() - 1);
+	}
+
+	reference at(size_type a_index) {
+		if (a_index >= size()) {
+			throw std::out_of_range("custom gap buffer out of range");
+		}
+		return *slot(a_index);
+	}
+
+	const_reference at(size_type a_index) const {
+		if (a_index >= size()) {
+			throw std::out_of_range("custom gap buffer out of range");
+		}
+		return *slot(a_index);
+	}
+
+	reference operator[](size_type a_index) {
+		return *slot(a_index);
+	}
+
+	const_reference operator[](size_type a_index) const {
+		return *slot(a_index);
+	}
+
+// Modifiers
+
+	// The value is built before the gap moves, so arguments may refer
+	// into the buffer
+	template<class... Args>
+	iterator emplace(const_iterator a_position, Args&&... args) {
+		size_type index = a_position - begin();
+		T value(std::forward<Args>(args)...);
+		open_gap(index, 1);
+		m_allocator.construct(m_gap_begin, std::move(value));
+		++m_gap_begin;
+		return begin() + index;
+	}
+
+	iterator insert(const_iterator a_position, const T& a_value) {
+		return emplace(a_position, a_value);
+	}
+
+	iterator insert(const_iterator a_position, T&& a_value) {
+		return emplace(a_position, std::move(a_value));
+	}
+
+	iterator insert(const_iterator a_position, size_type a_count, const T& a_value) {
+		size_type index = a_position - begin();
+		T value(a_value);
+		open_gap(index, a_count);
+		for(size_type i = 0; i < a_count; i++) {
+			m_allocator.construct(m_gap_begin, value);
+			++m_gap_begin;
+		}
+		return begin() + index;
+	}
+
+	// The range must not point into the buffer
+	template <class InputIterator, typename = typename std::iterator_traits<InputIterator>::iterator_category>
+	iterator insert(const_iterator a_position, InputIterator a_first, InputIterator a_last) {
+		size_type index = a_position - begin();
+		open_gap(index, count(a_first, a_last, typename std::iterator_traits<InputIterator>::iterator_category()));
+		for(; a_first != a_last; ++a_first) {
+			if (m_gap_begin == m_gap_end) {
+				open_gap(gap_position(), 1);
+			}
+			m_allocator.construct(m_gap_begin, *a_first);
+			++m_gap_begin;
+		}
+		return begin() + index;
+	}
+
+	iterator insert(const_iterator a_position, std::initializer_list<value_type> il) {
+		return insert(a_position, il.begin(), il.end());
+	}
+
+	template<class... Args>
+	reference emplace_back(Args&&... args) {
+		return *emplace(end(), std::forward<Args>(args)...);
+	}
+
+	void push_back(const T& a_value) {
+		emplace_back(a_value);
+	}
+
+	void push_back(T&& a_value) {
+		emplace_back(std::move(a_value));
+	}
+
+	// The erased elements join the gap
+	iterator erase(const_iterator a_first, const_iterator a_last) {
+		size_type index = a_first - begin();
+		move_gap(index);
+		pointer last = m_gap_end + (a_last - a_first);
+		destroy(m_gap_end, last);
+		m_gap_end = last;
+		return begin() + index;
+	}
+
+	iterator erase(const_iterator a_position) {
+		return erase(a_position, a_position + 1);
+	}
+
+	void pop_back() {
+		erase(end() - 1);
+	}
+
+	// Removes the elements that satisfy a_predicate in one pass and
+	// returns their number
+	template<class Predicate>
+	size_type erase_if(Predicate a_predicate) {
+		pointer first = data();
+		pointer last = m_gap_begin;
+		pointer out = std::remove_if(first, last, a_predicate);
+		destroy(out, last);
+		m_gap_begin = out;
+		return last - out;
+	}
+
+	// The buffer is kept, the gap covers all of it
+	void clear() {
+		destroy(m_begin, m_gap_begin);
+		destroy(m_gap_end, m_memory_end);
+		m_gap_begin = m_begin;
+		m_gap_end = m_memory_end;
+	}
+
+	void swap(GapBuffer& other) noexcept {
+		using std::swap;
+		swap(m_begin, other.m_begin);
+		swap(m_gap_begin, other.m_gap_begin);
+		swap(m_gap_end, other.m_gap_end);
+		swap(m_memory_end, other.m_memory_end);
+		swap(m_allocator, other.m_allocator);
+	}
+
+private:
+	template<bool B>
+	struct toggle {};
+
+	typedef toggle<is_trivially_relocatable<T>::value> relocation_tag;
+
+	pointer slot(size_type a_index) const {
+		size_type gap_index = m_gap_begin - m_begin;
+		return a_index < gap_index ? m_begin + a_index : m_gap_end + (a_index - gap_index);
+	}
+
+	template<class Function>
+	void construct_with(Function a_function) {
+		try {
+			a_function();
+		} catch (...) {
+			free_storage();
+			throw;
+		}
+	}
+
+	template<class InputIterator>
+	static size_type count(InputIterator, InputIterator, std::input_iterator_tag) {
+		return 0;
+	}
+
+	template<class ForwardIterator>
+	static size_type count(ForwardIterator a_first, ForwardIterator a_last, std::forward_iterator_tag) {
+		return std::distance(a_first, a_last);
+	}
+
+	void destroy(pointer a_first, pointer a_last) {
+		for(; a_first != a_last; ++a_first) {
+			m_allocator.destroy(a_first);
+		}
+	}
+
+	void free_storage() {
+		clear();
+		if (m_begin != nullptr) {
+			m_allocator.deallocate(m_begin, capacity());
+		}
+		m_begin = m_gap_begin = m_gap_end = m_memory_end = nullptr;
+	}
+
+	// Puts the gap before element a_index with room for a_count elements
+	void open_gap(size_type a_index, size_type a_count) {
+		if (size_type(m_gap_end - m_gap_begin) < a_count) {
+			move_gap(size());
+			reallocate(growth_policy::grow(capacity(), size() + a_count));
+		}
+		move_gap(a_index);
+	}
+
+	// Only the elements between the old and the new gap position move
+	void move_gap(size_type a_index) {
+		if (m_gap_begin == m_gap_end) {
+			m_gap_begin = m_gap_end = m_begin + a_index;
+			return;
+		}
+		size_type gap_index = m_gap_begin - m_begin;
+		if (a_index < gap_index) {
+			move_down(relocation_tag(), gap_index - a_index);
+		} else if (a_index > gap_index) {
+			move_up(relocation_tag(), a_index - gap_index);
+		}
+	}
+
+	// The a_count elements before the gap go to its far end
+	void move_down(toggle<true>, size_type a_count) {
+		m_gap_begin -= a_count;
+		m_gap_end -= a_count;
+		std::memmove(static_cast<void*>(m_gap_end), static_cast<const void*>(m_gap_begin), a_count*sizeof(T));
+	}
+
+	// One element at a time, so a throwing move leaves a valid buffer
+	void move_down(toggle<false>, size_type a_count) {
+		for(; a_count > 0; a_count--) {
+			m_allocator.construct(m_gap_end - 1, std::move_if_noexcept(*(m_gap_begin - 1)));
+			--m_gap_end;
+			--m_gap_begin;
+			m_allocator.destroy(m_gap_begin);
+		}
+	}
+
+	// The a_count elements after the gap go to its near end
+	void move_up(toggle<true>, size_type a_count) {
+		std::memmove(static_cast<void*>(m_gap_begin), static_cast<const void*>(m_gap_end), a_count*sizeof(T));
+		m_gap_begin += a_count;
+		m_gap_end += a_count;
+	}
+
+	void move_up(toggle<false>, size_type a_count) {
+		for(; a_count > 0; a_count--) {
+			m_allocator.construct(m_gap_begin, std::move_if_noexcept(*m_gap_end));
+			++m_gap_begin;
+			m_allocator.destroy(m_gap_end);
+			++m_gap_end;
+		}
+	}
+
+	// Moves the elements to a new buffer, the gap must be at the end.
+	// A throwing copy leaves the buffer untouched.
+	void reallocate(size_type a_capacity) {
+		pointer new_begin = m_allocator.allocate(a_capacity);
+		size_type old_size = size();
+		try {
+			transfer(relocation_tag(), m_begin, m_gap_begin, new_begin);
+		} catch (...) {
+			m_allocator.deallocate(new_begin, a_capacity);
+			throw;
+		}
+		release(relocation_tag(), m_begin, m_gap_begin);
+		if (m_begin != nullptr) {
+			m_allocator.deallocate(m_begin, capacity());
+		}
+		m_begin = new_begin;
+		m_gap_begin = new_begin + old_size;
+		m_gap_end = m_memory_end = new_begin + a_capacity;
+	}
+
+	void transfer(toggle<true>, pointer a_first, pointer a_last, pointer a_destination) {
+		if (a_first != a_last) {
+			std::memcpy(static_cast<void*>(a_destination), static_cast<const void*>(a_first), (a_last - a_first)*sizeof(T));
+		}
+	}
+
+	void transfer(toggle<false>, pointer a_first, pointer a_last, pointer a_destination) {
+		pointer current = a_destination;
+		try {
+			for(; a_first != a_last; ++a_first, ++current) {
+				m_allocator.construct(current, std::move_if_noexcept(*a_first));
+			}
+		} catch (...) {
+			destroy(a_destination, current);
+			throw;
+		}
+	}
+
+	void release(toggle<true>, pointer, pointer) {
+	}
+
+	void release(toggle<false>, pointer a_first, pointer a_last) {
+		destroy(a_first, a_last);
+	}
+};
+
+template<class T, class A, class G>
+void swap(GapBuffer<T, A, G>& a, GapBuffer<T, A, G>& b) noexcept {
+	a.swap(b);
+}
+
+template<class T, class A, class G, class Predicate>
+typename GapBuffer<T, A, G>::size_type erase_if(GapBuffer<T, A, G>& a_buffer, Predicate a_predicate) {
+	return a_buffer.erase_if(a_predicate);
+}
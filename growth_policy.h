@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <algorithm>
+
+// Growth policies decide the new capacity of a Vector when it runs out of
+// memory. Every policy provides
+//     static size_type grow(size_type a_capacity, size_type a_required)
+// which must return a value not less than a_required.
+namespace growth {
+	// Capacity is multiplied by Numerator/Denominator on every reallocation.
+	template<std::size_t Numerator, std::size_t Denominator = 1>
+	struct Geometric {
+		static_assert(Numerator > Denominator, "geometric growth factor must be greater than 1");
+
+		template<class size_type>
+		static size_type grow(size_type a_capacity, size_type a_required) {
+			return std::max(a_required, a_capacity + a_capacity*(Numerator - Denominator)/Denominator);
+		}
+	};
+
+	typedef Geometric<2>    Double;
+	typedef Geometric<3, 2> OneAndHalf;
+
+	// Allocates exactly what is requested. push_back becomes O(n),
+	// use it only for vectors that are sized once.
+	struct Exact {
+		template<class size_type>
+		static size_type grow(size_type, size_type a_required) {
+			return a_required;
+		}
+	};
+
+	// Doubles the capacity until it reaches Chunk elements, then grows
+	// by whole chunks. Keeps the slack of huge arrays below Chunk elements.
+	template<std::size_t Chunk = (std::size_t(1) << 20)>
+	struct CappedChunk {
+		static_assert(Chunk > 0, "chunk size must be positive");
+
+		template<class size_type>
+		static size_type grow(size_type a_capacity, size_type a_required) {
+			if (a_capacity < Chunk) {
+				return std::max(a_required, std::min<size_type>(2*a_capacity, Chunk));
+			}
+			return (a_required + Chunk - 1)/Chunk*Chunk;
+		}
+	};
+
+	typedef Double Default;
+}
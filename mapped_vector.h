@@ -0,0 +1,416 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "growth_policy.h"
+
+// Vector whose elements live in a file mapped into memory. The file
+// holds a small header with the element count, followed by the elements
+// as they are in memory, so reopening it gives the data back without
+// any parsing. Growing extends the file and remaps it (mremap on Linux),
+// nothing is copied. Pointers and iterators are invalidated by growth
+// as in Vector.
+//
+// Every change is written to the shared mapping; flush() only forces
+// it to the disk. Not thread-safe, and one process should write a file
+// at a time.
+template<class T, class G = growth::Default>
+class MappedVector {
+	static_assert(std::is_trivially_copyable<T>::value, "MappedVector stores T as raw bytes");
+
+public:
+	typedef G growth_policy;
+	typedef T              value_type;
+	typedef T&             reference;
+	typedef const T&       const_reference;
+	typedef std::size_t    size_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef T*             pointer;
+	typedef const T*       const_pointer;
+	typedef pointer       iterator;
+	typedef const_pointer const_iterator;
+	typedef std::reverse_iterator<iterator> reverse_iterator;
+	typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+	// Expected access pattern, passed to madvise()
+	enum Advice {
+		normal,
+		sequential,
+		random,
+		will_need
+	};
+
+	static const size_type header_size = 64;
+
+	static_assert(alignof(T) <= header_size, "elements must fit the alignment of the header");
+
+// Constructors
+
+	// Opens the file or creates an empty one. Throws std::system_error
+	// if a system call fails and std::runtime_error if the file was not
+	// written by a MappedVector of the same element size.
+	explicit MappedVector(const std::string& a_path) : m_file(-1), m_header(nullptr), m_length(0), m_advice(normal) {
+		m_file = ::open(a_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+		if (m_file < 0) {
+			throw_error("open");
+		}
+		try {
+			attach();
+		} catch (...) {
+			detach();
+			throw;
+		}
+	}
+
+	MappedVector(const MappedVector&) = delete;
+	MappedVector& operator=(const MappedVector&) = delete;
+
+	// Leaves other empty and without a file: it can still be queried,
+	// assigned to or destroyed, but not grown
+	MappedVector(MappedVector&& other) noexcept
+		: m_file(other.m_file), m_header(other.m_header), m_length(other.m_length), m_advice(other.m_advice) {
+		other.m_file = -1;
+		other.m_header = nullptr;
+		other.m_length = 0;
+	}
+
+	MappedVector& operator=(MappedVector&& other) noexcept {
+		if (this != &other) {
+			detach();
+			swap(other);
+		}
+		return *this;
+	}
+
+	~MappedVector() {
+		detach();
+	}
+
+// Iterators
+
+	iterator begin() {
+		return data();
+	}
+
+	const_iterator begin() const {
+		return data();
+	}
+
+	iterator end() {
+		return data() + size();
+	}
+
+	const_iterator end() const {
+		return data() + size();
+	}
+
+	reverse_iterator rbegin() {
+		return reverse_iterator(end());
+	}
+
+	const_reverse_iterator rbegin() const {
+		return const_reverse_iterator(end());
+	}
+
+	reverse_iterator rend() {
+		return reverse_iterator(begin());
+	}
+
+	const_reverse_iterator rend() const {
+		return const_reverse_iterator(begin());
+	}
+
+// Capacity
+
+	size_type size() const {
+		return m_header != nullptr ? m_header->size : 0;
+	}
+
+	size_type capacity() const {
+		return m_header != nullptr ? (m_length - header_size)/sizeof(T) : 0;
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+
+	void reserve(size_type a_size) {
+		if (a_size > capacity()) {
+			remap(a_size);
+		}
+	}
+
+	void resize(size_type a_size) {
+		resize(a_size, T());
+	}
+
+	void resize(size_type a_size, const_reference a_value) {
+		if (a_size > size()) {
+			T value(a_value);
+			if (a_size > capacity()) {
+				remap(growth_policy::grow(capacity(), a_size));
+			}
+			std::fill(end(), begin() + a_size, value);
+		}
+		m_header->size = a_size;
+	}
+
+	// Truncates the file to the elements in use
+	void shrink_to_fit() {
+		if (capacity() > size()) {
+			remap(size());
+		}
+	}
+
+// Element access
+
+	pointer data() {
+		return m_header != nullptr ? reinterpret_cast<pointer>(reinterpret_cast<char*>(m_header) + header_size) : nullptr;
+	}
+
+	const_pointer data() const {
+		return m_header != nullptr ? reinterpret_cast<const_pointer>(reinterpret_cast<const char*>(m_header) + header_size) : nullptr;
+	}
+
+	reference front() {
+		return *begin();
+	}
+
+	const_reference front() const {
+		return *begin();
+	}
+
+	reference back() {
+		return *(end() - 1);
+	}
+
+	const_reference back() const {
+		return *(end() - 1);
+	}
+
+	reference at(size_type a_index) {
+		if (a_index >= size()) {
+			throw std::out_of_range("custom mapped vector out of range");
+		}
+		return data()[a_index];
+	}
+
+	const_reference at(size_type a_index) const {
+		if (a_index >= size()) {
+			throw std::out_of_range("custom mapped vector out of range");
+		}
+		return data()[a_index];
+	}
+
+	reference operator[](size_type a_index) {
+		return data()[a_index];
+	}
+
+	const_reference operator[](size_type a_index) const {
+		return data()[a_index];
+	}
+
+// Modifiers
+
+	// The value is built before a remap, so arguments may refer into the vector
+	template <class... Args>
+	reference emplace_back(Args&&... args) {
+		T value(std::forward<Args>(args)...);
+		if (size() == capacity()) {
+			remap(growth_policy::grow(capacity(), size() + 1));
+		}
+		std::memcpy(static_cast<void*>(end()), &value, sizeof(T));
+		++m_header->size;
+		return back();
+	}
+
+	void push_back(const T& a_value) {
+		emplace_back(a_value);
+	}
+
+	iterator insert(const_iterator a_position, const T& a_value) {
+		return insert(a_position, 1, a_value);
+	}
+
+	iterator insert(const_iterator a_position, size_type a_count, const T& a_value) {
+		size_type index = a_position - begin();
+		T value(a_value);
+		if (size() + a_count > capacity()) {
+			remap(growth_policy::grow(capacity(), size() + a_count));
+		}
+		iterator position = begin() + index;
+		std::memmove(static_cast<void*>(position + a_count), position, (end() - position)*sizeof(T));
+		std::fill(position, position + a_count, value);
+		m_header->size += a_count;
+		return position;
+	}
+
+	iterator erase(const_iterator a_first, const_iterator a_last) {
+		iterator first = begin() + (a_first - begin());
+		std::memmove(static_cast<void*>(first), a_last, (end() - a_last)*sizeof(T));
+		m_header->size -= a_last - a_first;
+		return first;
+	}
+
+	iterator erase(const_iterator a_position) {
+		return erase(a_position, a_position + 1);
+	}
+
+	void pop_back() {
+		--m_header->size;
+	}
+
+	void clear() {
+		if (m_header != nullptr) {
+			m_header->size = 0;
+		}
+	}
+
+	void swap(MappedVector& other) noexcept {
+		std::swap(m_file, other.m_file);
+		std::swap(m_header, other.m_header);
+		std::swap(m_length, other.m_length);
+		std::swap(m_advice, other.m_advice);
+	}
+
+// File
+
+	// Writes the dirty pages to the file. With a_async the call only
+	// schedules the writes.
+	void flush(bool a_async = false) {
+		if (msync(m_header, m_length, a_async ? MS_ASYNC : MS_SYNC) != 0) {
+			throw_error("msync");
+		}
+	}
+
+	// Kept across remaps
+	void advise(Advice a_advice) {
+		m_advice = a_advice;
+		apply_advice();
+	}
+
+private:
+	struct Header {
+		std::uint64_t magic;
+		std::uint64_t element_size;
+		std::uint64_t size;
+	};
+
+	static const std::uint64_t magic = 0x31524556434d5543ull;
+
+	int m_file;
+	Header* m_header;
+	// Bytes mapped, equal to the file size
+	size_type m_length;
+	Advice m_advice;
+
+	static void throw_error(const char* a_call) {
+		throw std::system_error(errno, std::generic_category(), a_call);
+	}
+
+	// Maps the file, creating the header of a new one
+	void attach() {
+		struct stat status;
+		if (fstat(m_file, &status) != 0) {
+			throw_error("fstat");
+		}
+		bool created = status.st_size == 0;
+		size_type length = created ? size_type(header_size) : size_type(status.st_size);
+		if (length < header_size) {
+			throw std::runtime_error("custom mapped vector: file is too short");
+		}
+		if (created && ftruncate(m_file, length) != 0) {
+			throw_error("ftruncate");
+		}
+		void* p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, 0);
+		if (p == MAP_FAILED) {
+			throw_error("mmap");
+		}
+		m_header = static_cast<Header*>(p);
+		m_length = length;
+		if (created) {
+			m_header->magic = magic;
+			m_header->element_size = sizeof(T);
+			m_header->size = 0;
+		} else if (m_header->magic != magic || m_header->element_size != sizeof(T) || m_header->size > capacity()) {
+			throw std::runtime_error("custom mapped vector: file has a different format");
+		}
+	}
+
+	void detach() {
+		if (m_header != nullptr) {
+			munmap(m_header, m_length);
+			m_header = nullptr;
+		}
+		if (m_file >= 0) {
+			::close(m_file);
+			m_file = -1;
+		}
+	}
+
+	// Resizes the file to a_capacity elements and maps it again,
+	// in place when the address space allows. The file never ends
+	// before the live mapping: it grows before the remap and shrinks
+	// only after it succeeded.
+	void remap(size_type a_capacity) {
+		if (a_capacity > (std::numeric_limits<size_type>::max() - header_size)/sizeof(T)) {
+			throw std::bad_alloc();
+		}
+		size_type length = header_size + a_capacity*sizeof(T);
+		bool grows = length > m_length;
+		if (grows && ftruncate(m_file, length) != 0) {
+			throw_error("ftruncate");
+		}
+#ifdef __linux__
+		void* p = mremap(m_header, m_length, length, MREMAP_MAYMOVE);
+		if (p == MAP_FAILED) {
+			throw_error("mremap");
+		}
+#else
+		void* p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, 0);
+		if (p == MAP_FAILED) {
+			throw_error("mmap");
+		}
+		munmap(m_header, m_length);
+#endif
+		m_header = static_cast<Header*>(p);
+		m_length = length;
+		apply_advice();
+		if (!grows && ftruncate(m_file, length) != 0) {
+			throw_error("ftruncate");
+		}
+	}
+
+	void apply_advice() {
+		static const int advice[] = {MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM, MADV_WILLNEED};
+		if (madvise(m_header, m_length, advice[m_advice]) != 0) {
+			throw_error("madvise");
+		}
+	}
+};
+
+template<class T, class G>
+const typename MappedVector<T, G>::size_type MappedVector<T, G>::header_size;
+
+template<class T, class G>
+const std::uint64_t MappedVector<T, G>::magic;
+
+template<class T, class G>
+void swap(MappedVector<T, G>& a, MappedVector<T, G>& b) noexcept {
+	a.swap(b);
+}
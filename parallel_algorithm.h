@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cstddef>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <utility>
+#include <vector>
+#include "thread_pool.h"
+
+// Bulk algorithms over random access ranges, spread over the threads of
+// a ThreadPool and the calling thread. A range is cut into one contiguous
+// block per thread, always at the same places for the same length and
+// pool. Pool threads are not pinned to cores, so where the pages of a
+// buffer filled in parallel end up is left to the operating system.
+namespace custom {
+	namespace detail {
+		// Ranges shorter than this per thread are not worth a task
+		const std::ptrdiff_t parallel_block = std::ptrdiff_t(1) << 15;
+
+		inline std::ptrdiff_t block_count(std::ptrdiff_t a_size, const ThreadPool& a_pool) {
+			return std::max<std::ptrdiff_t>(1, std::min<std::ptrdiff_t>(a_pool.size() + 1, a_size/parallel_block));
+		}
+
+		// Calls a_function(block_first, block_last, block) for every block,
+		// the first one on the calling thread
+		template<class iterator, class Function>
+		void for_each_block(iterator first, iterator last, ThreadPool& a_pool, Function a_function) {
+			std::ptrdiff_t size = last - first;
+			std::ptrdiff_t blocks = block_count(size, a_pool);
+			if (blocks == 1) {
+				a_function(first, last, std::ptrdiff_t(0));
+				return;
+			}
+			TaskGroup group(a_pool);
+			for(std::ptrdiff_t i = 1; i < blocks; i++) {
+				group.run([=]() {
+					a_function(first + size*i/blocks, first + size*(i + 1)/blocks, i);
+				});
+			}
+			a_function(first, first + size/blocks, std::ptrdiff_t(0));
+			group.wait();
+		}
+	}
+
+	template<class iterator, class T>
+	void parallel_fill(iterator first, iterator last, const T& a_value, ThreadPool& a_pool) {
+		detail::for_each_block(first, last, a_pool, [&a_value](iterator block_first, iterator block_last, std::ptrdiff_t) {
+			std::fill(block_first, block_last, a_value);
+		});
+	}
+
+	// Constructs copies of a_value in raw memory with a_allocator.
+	// If a construction throws, every element built so far is destroyed.
+	template<class pointer, class T, class Allocator>
+	void parallel_uninitialized_fill(pointer first, pointer last, const T& a_value, Allocator& a_allocator, ThreadPool& a_pool) {
+		std::ptrdiff_t blocks = detail::block_count(last - first, a_pool);
+		// Blocks that were fully built, rolled back if another one failed
+		std::vector<char> built(blocks, 0);
+		try {
+			detail::for_each_block(first, last, a_pool, [&](pointer block_first, pointer block_last, std::ptrdiff_t a_block) {
+				pointer current = block_first;
+				try {
+					for(; current != block_last; ++current) {
+						a_allocator.construct(current, a_value);
+					}
+				} catch (...) {
+					for(pointer i = block_first; i != current; ++i) {
+						a_allocator.destroy(i);
+					}
+					throw;
+				}
+				built[a_block] = 1;
+			});
+		} catch (...) {
+			std::ptrdiff_t size = last - first;
+			for(std::ptrdiff_t b = 0; b < blocks; b++) {
+				if (built[b]) {
+					for(pointer i = first + size*b/blocks; i != first + size*(b + 1)/blocks; ++i) {
+						a_allocator.destroy(i);
+					}
+				}
+			}
+			throw;
+		}
+	}
+
+	// Resizes a_vector, which needs resize_with() as Vector has, and builds
+	// the new elements on the threads of a_pool.
+	template<class Container, class T>
+	void parallel_resize(Container& a_vector, typename Container::size_type a_size, const T& a_value, ThreadPool& a_pool) {
+		typedef typename Container::pointer pointer;
+		a_vector.resize_with(a_size, [&a_value, &a_pool](pointer first, pointer last, typename Container::allocator_type& a_allocator) {
+			custom::parallel_uninitialized_fill(first, last, a_value, a_allocator, a_pool);
+		});
+	}
+
+	template<class Container>
+	void parallel_resize(Container& a_vector, typename Container::size_type a_size, ThreadPool& a_pool) {
+		typename Container::value_type value = typename Container::value_type();
+		custom::parallel_resize(a_vector, a_size, value, a_pool);
+	}
+
+	template<class iterator, class OutputIterator, class UnaryOperation>
+	OutputIterator parallel_transform(iterator first, iterator last, OutputIterator a_result, UnaryOperation a_operation, ThreadPool& a_pool) {
+		detail::for_each_block(first, last, a_pool, [=](iterator block_first, iterator block_last, std::ptrdiff_t) {
+			std::transform(block_first, block_last, a_result + (block_first - first), a_operation);
+		});
+		return a_result + (last - first);
+	}
+
+	// a_reduce must be associative: blocks are reduced on their own,
+	// then the partial results from left to right, after a_init.
+	template<class iterator, class T, class BinaryOperation, class UnaryOperation>
+	T parallel_transform_reduce(iterator first, iterator last, T a_init, BinaryOperation a_reduce, UnaryOperation a_transform, ThreadPool& a_pool) {
+		if (first == last) {
+			return a_init;
+		}
+		std::vector<T> partials(detail::block_count(last - first, a_pool), a_init);
+		detail::for_each_block(first, last, a_pool, [&](iterator block_first, iterator block_last, std::ptrdiff_t a_block) {
+			T partial = a_transform(*block_first);
+			for(++block_first; block_first != block_last; ++block_first) {
+				partial = a_reduce(std::move(partial), a_transform(*block_first));
+			}
+			partials[a_block] = std::move(partial);
+		});
+		for(T& partial : partials) {
+			a_init = a_reduce(std::move(a_init), std::move(partial));
+		}
+		return a_init;
+	}
+
+	template<class iterator, class T, class BinaryOperation>
+	T parallel_reduce(iterator first, iterator last, T a_init, BinaryOperation a_reduce, ThreadPool& a_pool) {
+		typedef typename std::iterator_traits<iterator>::reference reference;
+		return custom::parallel_transform_reduce(first, last, std::move(a_init), a_reduce, [](reference a_value) -> reference {
+			return a_value;
+		}, a_pool);
+	}
+
+	template<class iterator, class T>
+	T parallel_reduce(iterator first, iterator last, T a_init, ThreadPool& a_pool) {
+		return custom::parallel_reduce(first, last, std::move(a_init), std::plus<>(), a_pool);
+	}
+
+	// The first match, as std::find_if. Blocks are scanned in steps and
+	// give up once a match was found before them.
+	template<class iterator, class Predicate>
+	iterator parallel_find_if(iterator first, iterator last, Predicate a_predicate, ThreadPool& a_pool) {
+		const std::ptrdiff_t step = 4096;
+		std::atomic<std::ptrdiff_t> found(last - first);
+		detail::for_each_block(first, last, a_pool, [&](iterator block_first, iterator block_last, std::ptrdiff_t) {
+			while (block_first != block_last && block_first - first < found.load(std::memory_order_relaxed)) {
+				iterator step_last = block_first + std::min(step, block_last - block_first);
+				iterator match = std::find_if(block_first, step_last, a_predicate);
+				if (match != step_last) {
+					std::ptrdiff_t index = match - first;
+					std::ptrdiff_t current = found.load(std::memory_order_relaxed);
+					while (index < current && !found.compare_exchange_weak(current, index, std::memory_order_relaxed)) {
+					}
+					return;
+				}
+				block_first = step_last;
+			}
+		});
+		return first + found.load();
+	}
+
+	template<class iterator, class Predicate>
+	typename std::iterator_traits<iterator>::difference_type
+	parallel_count_if(iterator first, iterator last, Predicate a_predicate, ThreadPool& a_pool) {
+		typedef typename std::iterator_traits<iterator>::difference_type difference_type;
+		std::vector<difference_type> counts(detail::block_count(last - first, a_pool), 0);
+		detail::for_each_block(first, last, a_pool, [&](iterator block_first, iterator block_last, std::ptrdiff_t a_block) {
+			counts[a_block] = std::count_if(block_first, block_last, a_predicate);
+		});
+		return std::accumulate(counts.begin(), counts.end(), difference_type(0));
+	}
+}
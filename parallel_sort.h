@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstddef>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "sort.h"
+#include "thread_pool.h"
+
+namespace custom {
+	namespace detail {
+		// Sub-ranges not longer than this are sorted by one thread
+		const std::ptrdiff_t parallel_grain = std::ptrdiff_t(1) << 14;
+		// Ranges longer than this are partitioned by all threads together
+		const std::ptrdiff_t parallel_partition_threshold = std::ptrdiff_t(1) << 18;
+
+		// [offset, offset + length) of the range being partitioned
+		typedef std::pair<std::ptrdiff_t, std::ptrdiff_t> span;
+
+		// Swaps elements number [a_from, a_to) of the concatenated a_left
+		// spans with the elements of the same numbers of the a_right spans
+		template<class iterator>
+		void swap_spans(iterator first, const std::vector<span>& a_left, const std::vector<span>& a_right,
+			std::ptrdiff_t a_from, std::ptrdiff_t a_to)
+		{
+			std::size_t l = 0, r = 0;
+			std::ptrdiff_t l_offset = a_from, r_offset = a_from;
+			while (l_offset >= a_left[l].second) {
+				l_offset -= a_left[l++].second;
+			}
+			while (r_offset >= a_right[r].second) {
+				r_offset -= a_right[r++].second;
+			}
+			while (a_from < a_to) {
+				std::ptrdiff_t count = std::min(a_to - a_from,
+					std::min(a_left[l].second - l_offset, a_right[r].second - r_offset));
+				std::swap_ranges(first + a_left[l].first + l_offset, first + a_left[l].first + l_offset + count,
+					first + a_right[r].first + r_offset);
+				a_from += count;
+				l_offset += count;
+				r_offset += count;
+				if (l_offset == a_left[l].second) {
+					++l;
+					l_offset = 0;
+				}
+				if (r_offset == a_right[r].second) {
+					++r;
+					r_offset = 0;
+				}
+			}
+		}
+
+		// Moves the elements less than *first to the front of [first + 1, last)
+		// and returns the end of them. Every thread partitions its own block,
+		// then the blocks' misplaced elements are swapped across the cut.
+		template<class iterator, class Compare>
+		iterator parallel_partition(iterator first, iterator last, Compare comp, ThreadPool& a_pool) {
+			iterator begin = first + 1;
+			std::ptrdiff_t size = last - begin;
+			std::ptrdiff_t blocks = std::min<std::ptrdiff_t>(a_pool.size() + 1, size/parallel_grain + 1);
+			std::vector<std::ptrdiff_t> middles(blocks);
+			{
+				TaskGroup group(a_pool);
+				for(std::ptrdiff_t i = 0; i < blocks; i++) {
+					group.run([=, &middles]() {
+						iterator block_first = begin + size*i/blocks;
+						iterator block_last = begin + size*(i + 1)/blocks;
+						iterator middle = std::partition(block_first, block_last, [&](const typename std::iterator_traits<iterator>::value_type& value) {
+							return comp(value, *first);
+						});
+						middles[i] = middle - begin;
+					});
+				}
+				group.wait();
+			}
+			std::ptrdiff_t cut = 0;
+			for(std::ptrdiff_t i = 0; i < blocks; i++) {
+				cut += middles[i] - size*i/blocks;
+			}
+			// Not-less elements before the cut and less elements after it
+			std::vector<span> left, right;
+			std::ptrdiff_t misplaced = 0;
+			for(std::ptrdiff_t i = 0; i < blocks; i++) {
+				std::ptrdiff_t block_first = size*i/blocks;
+				std::ptrdiff_t block_last = size*(i + 1)/blocks;
+				std::ptrdiff_t greater_last = std::min(block_last, cut);
+				if (middles[i] < greater_last) {
+					left.push_back(span(middles[i], greater_last - middles[i]));
+					misplaced += greater_last - middles[i];
+				}
+				std::ptrdiff_t less_first = std::max(block_first, cut);
+				if (less_first < middles[i]) {
+					right.push_back(span(less_first, middles[i] - less_first));
+				}
+			}
+			if (misplaced > 0) {
+				TaskGroup group(a_pool);
+				std::ptrdiff_t pieces = std::min<std::ptrdiff_t>(blocks, misplaced/parallel_grain + 1);
+				for(std::ptrdiff_t i = 0; i < pieces; i++) {
+					group.run([=, &left, &right]() {
+						detail::swap_spans(begin, left, right, misplaced*i/pieces, misplaced*(i + 1)/pieces);
+					});
+				}
+				group.wait();
+			}
+			return begin + cut;
+		}
+
+		// Same steps as introsort(), but one side of every partition becomes
+		// a task of a_group and sub-ranges up to parallel_grain are left
+		// to custom::sort()
+		template<class iterator, class Compare>
+		void parallel_introsort(iterator first, iterator last, int depth, bool a_leftmost, Compare comp, TaskGroup& a_group) {
+			while (last - first > parallel_grain) {
+				if (depth == 0) {
+					detail::heap_sort(first, last, comp);
+					return;
+				}
+				--depth;
+				detail::choose_pivot(first, last, comp);
+				if (!a_leftmost && !comp(*(first - 1), *first)) {
+					first = detail::partition_equal(first, last, comp) + 1;
+					continue;
+				}
+				iterator cut;
+				if (last - first > parallel_partition_threshold && a_group.pool().size() > 0) {
+					cut = detail::parallel_partition(first, last, comp, a_group.pool());
+				} else {
+					bool swapped;
+					cut = detail::partition_around(first, last, swapped, comp);
+				}
+				std::iter_swap(first, cut - 1);
+				std::ptrdiff_t smallest = (last - first)/8;
+				if (cut - 1 - first < smallest || last - cut < smallest) {
+					detail::break_pattern(first, cut - 1);
+					detail::break_pattern(cut, last);
+				}
+				bool leftmost = a_leftmost;
+				a_group.run([=, &a_group]() {
+					detail::parallel_introsort(first, cut - 1, depth, leftmost, comp, a_group);
+				});
+				first = cut;
+				a_leftmost = false;
+			}
+			custom::sort(first, last, comp);
+		}
+	}
+
+	// custom::sort() spread over the threads of a_pool and the calling thread
+	template<class iterator, class Compare>
+	typename std::enable_if<is_random_access_iterator<iterator>::value, void>::type
+	parallel_sort(iterator first, iterator last, Compare comp, ThreadPool& a_pool) {
+		if (last - first <= detail::parallel_grain || a_pool.size() == 0) {
+			custom::sort(first, last, comp);
+			return;
+		}
+		TaskGroup group(a_pool);
+		detail::parallel_introsort(first, last, detail::depth_limit(last - first), true, comp, group);
+		group.wait();
+	}
+
+	// Sorts with a_threads threads including the calling one,
+	// all hardware threads by default
+	template<class iterator, class Compare>
+	typename std::enable_if<is_random_access_iterator<iterator>::value && !std::is_integral<Compare>::value, void>::type
+	parallel_sort(iterator first, iterator last, Compare comp, std::size_t a_threads = std::thread::hardware_concurrency()) {
+		if (a_threads <= 1 || last - first <= detail::parallel_grain) {
+			custom::sort(first, last, comp);
+			return;
+		}
+		ThreadPool pool(a_threads - 1);
+		custom::parallel_sort(first, last, comp, pool);
+	}
+
+	template<class iterator>
+	typename std::enable_if<is_random_access_iterator<iterator>::value, void>::type
+	parallel_sort(iterator first, iterator last, std::size_t a_threads = std::thread::hardware_concurrency()) {
+		custom::parallel_sort(first, last, std::less<>(), a_threads);
+	}
+}
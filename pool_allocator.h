@@ -0,0 +1,271 @@
+#pragma once
+
+#include <cstddef>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+
+// Size-class pool shared by all PoolAllocators. Requests up to max_block
+// bytes are rounded up to a power of two and served from per-class free
+// lists, which are refilled by carving slabs. Larger requests go straight
+// to operator new. Slabs are never returned to the system.
+class PoolResource {
+public:
+	enum : std::size_t {
+		min_block   = 16,
+		max_block   = std::size_t(1) << 15,
+		class_count = 12,
+		slab_size   = std::size_t(1) << 16
+	};
+
+	// Never destroyed: vectors with static storage duration
+	// may still return their memory during exit
+	static PoolResource& instance() {
+		static PoolResource* resource = new PoolResource();
+		return *resource;
+	}
+
+	// class_count for requests that are too big to pool
+	static std::size_t size_class(std::size_t a_bytes) {
+		std::size_t index = 0;
+		std::size_t block = min_block;
+		while (block < a_bytes && index < class_count) {
+			block <<= 1;
+			++index;
+		}
+		return index;
+	}
+
+	static std::size_t block_size(std::size_t a_class) {
+		return min_block << a_class;
+	}
+
+	void* allocate(std::size_t a_bytes, bool a_thread_cache) {
+		std::size_t index = size_class(a_bytes);
+		if (index == class_count) {
+			return operator new(a_bytes);
+		}
+		if (a_thread_cache) {
+			return cache().pop(*this, index);
+		}
+		Block* block = nullptr;
+		take(index, 1, block);
+		return block;
+	}
+
+	void deallocate(void* p, std::size_t a_bytes, bool a_thread_cache) {
+		std::size_t index = size_class(a_bytes);
+		if (index == class_count) {
+			operator delete(p);
+			return;
+		}
+		Block* block = static_cast<Block*>(p);
+		if (a_thread_cache) {
+			cache().push(*this, index, block);
+			return;
+		}
+		block->next = nullptr;
+		give(index, block, block);
+	}
+
+private:
+	struct Block {
+		Block* next;
+	};
+
+	struct FreeList {
+		std::mutex lock;
+		Block* head;
+	};
+
+	// Blocks of one thread, moved to and from the shared lists in batches
+	class ThreadCache {
+	public:
+		ThreadCache() {
+			for(std::size_t i = 0; i < class_count; i++) {
+				m_heads[i] = nullptr;
+				m_counts[i] = 0;
+			}
+		}
+
+		~ThreadCache() {
+			for(std::size_t i = 0; i < class_count; i++) {
+				flush(PoolResource::instance(), i, m_counts[i]);
+			}
+		}
+
+		void* pop(PoolResource& a_resource, std::size_t a_class) {
+			if (m_heads[a_class] == nullptr) {
+				m_counts[a_class] = a_resource.take(a_class, batch(a_class), m_heads[a_class]);
+			}
+			Block* block = m_heads[a_class];
+			m_heads[a_class] = block->next;
+			--m_counts[a_class];
+			return block;
+		}
+
+		void push(PoolResource& a_resource, std::size_t a_class, Block* a_block) {
+			a_block->next = m_heads[a_class];
+			m_heads[a_class] = a_block;
+			if (++m_counts[a_class] > 2*batch(a_class)) {
+				flush(a_resource, a_class, batch(a_class));
+			}
+		}
+
+	private:
+		Block* m_heads[class_count];
+		std::size_t m_counts[class_count];
+
+		static std::size_t batch(std::size_t a_class) {
+			return std::max<std::size_t>(2, std::min<std::size_t>(64, slab_size/16/block_size(a_class)));
+		}
+
+		void flush(PoolResource& a_resource, std::size_t a_class, std::size_t a_count) {
+			if (a_count == 0) {
+				return;
+			}
+			Block* first = m_heads[a_class];
+			Block* last = first;
+			for(std::size_t i = 1; i < a_count; i++) {
+				last = last->next;
+			}
+			m_heads[a_class] = last->next;
+			m_counts[a_class] -= a_count;
+			a_resource.give(a_class, first, last);
+		}
+	};
+
+	FreeList m_lists[class_count];
+
+	PoolResource() {
+		for(std::size_t i = 0; i < class_count; i++) {
+			m_lists[i].head = nullptr;
+		}
+	}
+
+	static ThreadCache& cache() {
+		static thread_local ThreadCache thread_cache;
+		return thread_cache;
+	}
+
+	// Unlinks up to a_count blocks into a_first, carving
+	// a new slab if the list is empty. Returns the number taken.
+	std::size_t take(std::size_t a_class, std::size_t a_count, Block*& a_first) {
+		FreeList& list = m_lists[a_class];
+		std::lock_guard<std::mutex> guard(list.lock);
+		if (list.head == nullptr) {
+			list.head = carve(a_class);
+		}
+		a_first = list.head;
+		Block* last = list.head;
+		std::size_t taken = 1;
+		while (taken < a_count && last->next != nullptr) {
+			last = last->next;
+			++taken;
+		}
+		list.head = last->next;
+		last->next = nullptr;
+		return taken;
+	}
+
+	// Links the chain [a_first, a_last] back into the shared list
+	void give(std::size_t a_class, Block* a_first, Block* a_last) {
+		FreeList& list = m_lists[a_class];
+		std::lock_guard<std::mutex> guard(list.lock);
+		a_last->next = list.head;
+		list.head = a_first;
+	}
+
+	static Block* carve(std::size_t a_class) {
+		std::size_t block = block_size(a_class);
+		std::size_t count = std::max<std::size_t>(8, slab_size/block);
+		char* slab = static_cast<char*>(operator new(count*block));
+		for(std::size_t i = 0; i + 1 < count; i++) {
+			reinterpret_cast<Block*>(slab + i*block)->next = reinterpret_cast<Block*>(slab + (i + 1)*block);
+		}
+		reinterpret_cast<Block*>(slab + (count - 1)*block)->next = nullptr;
+		return reinterpret_cast<Block*>(slab);
+	}
+};
+
+// Drop-in replacement for Allocator<T> backed by PoolResource.
+// With ThreadCache the common path takes no lock.
+template<class T, bool ThreadCache = true>
+class PoolAllocator {
+public:
+	typedef T                 value_type;
+	typedef std::size_t       size_type;
+	typedef std::ptrdiff_t    difference_type;
+	typedef       value_type* pointer;
+	typedef       value_type& reference;
+	typedef const value_type* const_pointer;
+	typedef const value_type& const_reference;
+	typedef std::true_type    is_always_equal;
+
+	template<class U>
+	struct rebind {
+		typedef PoolAllocator<U, ThreadCache> other;
+	};
+
+	PoolAllocator() throw() {
+	}
+
+	PoolAllocator(const PoolAllocator&) {
+	}
+
+	template<class U>
+	PoolAllocator(const PoolAllocator<U, ThreadCache>&) {
+	}
+
+	~PoolAllocator() throw() {
+	}
+
+	pointer address(reference r) const {
+		return &r;
+	}
+
+	const_pointer address(const_reference r) const {
+		return &r;
+	}
+
+	pointer allocate(size_type n, const_pointer hint = 0) {
+		static_assert(alignof(T) <= PoolResource::min_block, "pool blocks are only 16-byte aligned");
+		if (n == 0) {
+			return nullptr;
+		}
+		return static_cast<pointer>(PoolResource::instance().allocate(n * sizeof(T), ThreadCache));
+	}
+
+	void deallocate(pointer p, size_type n) {
+		if (p != nullptr) {
+			PoolResource::instance().deallocate(p, n * sizeof(T), ThreadCache);
+		}
+	}
+
+	size_type max_size() const {
+		return std::numeric_limits<size_type>::max() / sizeof(T);
+	}
+
+	template<class U, class... Args>
+	void construct(U* p, Args&&... args) {
+		new((void *)p) U(std::forward<Args>(args)...);
+	}
+
+	template<class U>
+	void destroy(U* p) {
+		p->~U();
+	}
+};
+
+template <class T1, class T2, bool C>
+bool operator==(const PoolAllocator<T1, C>&, const PoolAllocator<T2, C>&) throw() {
+	return true;
+}
+
+template <class T1, class T2, bool C>
+bool operator!=(const PoolAllocator<T1, C>&, const PoolAllocator<T2, C>&) throw() {
+	return false;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <algorithm>
+
+// Reclaim policies decide how much capacity a Vector gives back.
+//
+// Trim policies are passed to Vector::trim() and provide
+//     static size_type target(size_type a_size, size_type a_capacity)
+// which returns the capacity to keep, not less than a_size.
+//
+// Decay policies are a base of Vector, like the stats policies, and give
+// back memory on their own. After every modifier that removes elements,
+// and after emplace_back, Vector calls
+//     size_type on_operation(size_type a_size, size_type a_capacity)
+// and shrinks to the result if it is below a_capacity.
+namespace reclaim {
+	// Keeps nothing above size(), as shrink_to_fit()
+	struct Exact {
+		template<class size_type>
+		static size_type target(size_type a_size, size_type) {
+			return a_size;
+		}
+	};
+
+	// Keeps Percent of size() as headroom and trims only the slack above it
+	template<std::size_t Percent = 25>
+	struct Slack {
+		template<class size_type>
+		static size_type target(size_type a_size, size_type a_capacity) {
+			return std::min(a_capacity, a_size + a_size*Percent/100);
+		}
+	};
+
+	// Never gives anything back. Empty, so it adds nothing to the size
+	// of Vector and the check compiles away.
+	struct Never {
+		template<class size_type>
+		size_type on_operation(size_type, size_type a_capacity) {
+			return a_capacity;
+		}
+	};
+
+	// After Operations operations in a row that leave less than Percent of
+	// the capacity in use, shrinks to twice the size, so that the vector
+	// can grow back a little without reallocating at once.
+	template<std::size_t Operations = 1024, std::size_t Percent = 25>
+	class Idle {
+		static_assert(Percent > 0 && Percent < 50, "a vector trimmed to twice its size must count as busy");
+
+	public:
+		Idle() : m_idle(0) {
+		}
+
+		template<class size_type>
+		size_type on_operation(size_type a_size, size_type a_capacity) {
+			if (a_size*100 >= a_capacity*Percent) {
+				m_idle = 0;
+				return a_capacity;
+			}
+			if (++m_idle < Operations) {
+				return a_capacity;
+			}
+			m_idle = 0;
+			return 2*a_size;
+		}
+
+	private:
+		std::size_t m_idle;
+	};
+}
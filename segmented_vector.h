@@ -0,0 +1,496 @@
+#pragma once
+
+#include <cstddef>
+#include <algorithm>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "vector.h"
+
+// Elements per chunk when not given: the largest power of two that
+// fits into 64KB, but not less than 16
+constexpr std::size_t default_segment_size(std::size_t a_element_size) {
+	std::size_t size = 16;
+	while (size*2*a_element_size <= (std::size_t(1) << 16)) {
+		size *= 2;
+	}
+	return size;
+}
+
+// Vector made of fixed-size chunks behind a table of chunk pointers.
+// Growing adds a chunk and never moves an element, so references and
+// pointers to elements stay valid until the element is erased.
+// Iterators hold the table and an index: push_back may invalidate them
+// when the table itself grows, as with std::deque.
+template<class T, class A = std::allocator<T>, std::size_t ChunkSize = default_segment_size(sizeof(T))>
+class SegmentedVector {
+	static_assert(ChunkSize > 0 && (ChunkSize & (ChunkSize - 1)) == 0, "chunk size must be a power of two");
+
+public:
+	typedef A allocator_type;
+	typedef typename A::value_type      value_type;
+	typedef typename A::reference       reference;
+	typedef typename A::const_reference const_reference;
+	typedef typename A::size_type       size_type;
+	typedef typename A::difference_type difference_type;
+	typedef typename A::pointer         pointer;
+	typedef typename A::const_pointer   const_pointer;
+
+	static const size_type chunk_size = ChunkSize;
+
+	template<class Value>
+	class basic_iterator {
+	public:
+		typedef std::random_access_iterator_tag iterator_category;
+		typedef typename std::remove_const<Value>::type value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef Value* pointer;
+		typedef Value& reference;
+
+		basic_iterator() : m_chunks(nullptr), m_index(0) {
+		}
+
+		basic_iterator(T* const* a_chunks, size_type a_index) : m_chunks(a_chunks), m_index(a_index) {
+		}
+
+		// iterator converts to const_iterator
+		template<class Other, typename = typename std::enable_if<std::is_convertible<Other*, Value*>::value>::type>
+		basic_iterator(const basic_iterator<Other>& other) : m_chunks(other.m_chunks), m_index(other.m_index) {
+		}
+
+		reference operator*() const {
+			return m_chunks[m_index/ChunkSize][m_index%ChunkSize];
+		}
+
+		pointer operator->() const {
+			return &**this;
+		}
+
+		reference operator[](difference_type a_offset) const {
+			return *(*this + a_offset);
+		}
+
+		basic_iterator& operator++() {
+			++m_index;
+			return *this;
+		}
+
+		basic_iterator operator++(int) {
+			basic_iterator old(*this);
+			++m_index;
+			return old;
+		}
+
+		basic_iterator& operator--() {
+			--m_index;
+			return *this;
+		}
+
+		basic_iterator operator--(int) {
+			basic_iterator old(*this);
+			--m_index;
+			return old;
+		}
+
+		basic_iterator& operator+=(difference_type a_offset) {
+			m_index += a_offset;
+			return *this;
+		}
+
+		basic_iterator& operator-=(difference_type a_offset) {
+			m_index -= a_offset;
+			return *this;
+		}
+
+		basic_iterator operator+(difference_type a_offset) const {
+			return basic_iterator(m_chunks, m_index + a_offset);
+		}
+
+		friend basic_iterator operator+(difference_type a_offset, const basic_iterator& a_iterator) {
+			return a_iterator + a_offset;
+		}
+
+		basic_iterator operator-(difference_type a_offset) const {
+			return basic_iterator(m_chunks, m_index - a_offset);
+		}
+
+		template<class Other>
+		difference_type operator-(const basic_iterator<Other>& other) const {
+			return difference_type(m_index) - difference_type(other.m_index);
+		}
+
+		template<class Other>
+		bool operator==(const basic_iterator<Other>& other) const {
+			return m_index == other.m_index;
+		}
+
+		template<class Other>
+		bool operator!=(const basic_iterator<Other>& other) const {
+			return m_index != other.m_index;
+		}
+
+		template<class Other>
+		bool operator<(const basic_iterator<Other>& other) const {
+			return m_index < other.m_index;
+		}
+
+		template<class Other>
+		bool operator>(const basic_iterator<Other>& other) const {
+			return m_index > other.m_index;
+		}
+
+		template<class Other>
+		bool operator<=(const basic_iterator<Other>& other) const {
+			return m_index <= other.m_index;
+		}
+
+		template<class Other>
+		bool operator>=(const basic_iterator<Other>& other) const {
+			return m_index >= other.m_index;
+		}
+
+	private:
+		template<class> friend class basic_iterator;
+		friend class SegmentedVector;
+
+		T* const* m_chunks;
+		size_type m_index;
+	};
+
+	typedef basic_iterator<T>       iterator;
+	typedef basic_iterator<const T> const_iterator;
+	typedef std::reverse_iterator<iterator> reverse_iterator;
+	typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+private:
+	typedef Vector<pointer, typename std::allocator_traits<A>::template rebind_alloc<pointer>> chunk_table;
+	typedef std::allocator_traits<A> allocator_traits;
+
+	chunk_table m_chunks;
+	size_type m_size;
+	allocator_type m_allocator;
+
+public:
+// Constructors
+
+	SegmentedVector() : m_size(0) {
+	}
+
+	explicit SegmentedVector(const allocator_type& alloc) : m_size(0), m_allocator(alloc) {
+	}
+
+	explicit SegmentedVector(size_type a_size, const allocator_type& alloc = allocator_type()) : m_size(0), m_allocator(alloc) {
+		try {
+			resize(a_size);
+		} catch (...) {
+			free_storage();
+			throw;
+		}
+	}
+
+	SegmentedVector(size_type a_size, const_reference a_value, const allocator_type& alloc = allocator_type()) : m_size(0), m_allocator(alloc) {
+		try {
+			resize(a_size, a_value);
+		} catch (...) {
+			free_storage();
+			throw;
+		}
+	}
+
+	SegmentedVector(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type()) : m_size(0), m_allocator(alloc) {
+		construct_range(il.begin(), il.end());
+	}
+
+	template <class InputIterator, typename = typename std::iterator_traits<InputIterator>::iterator_category>
+	SegmentedVector(InputIterator a_first, InputIterator a_last, const allocator_type& alloc = allocator_type()) : m_size(0), m_allocator(alloc) {
+		construct_range(a_first, a_last);
+	}
+
+	SegmentedVector(const SegmentedVector& other)
+		: m_size(0), m_allocator(allocator_traits::select_on_container_copy_construction(other.m_allocator)) {
+		construct_range(other.begin(), other.end());
+	}
+
+	SegmentedVector(SegmentedVector&& other) noexcept
+		: m_chunks(std::move(other.m_chunks)), m_size(other.m_size), m_allocator(std::move(other.m_allocator)) {
+		other.m_size = 0;
+	}
+
+	SegmentedVector& operator=(const SegmentedVector& other) {
+		if (this != &other) {
+			assign(other.begin(), other.end());
+		}
+		return *this;
+	}
+
+	// Chunks change hands only between equal allocators,
+	// otherwise elements are moved one by one
+	SegmentedVector& operator=(SegmentedVector&& other) {
+		if (this == &other) {
+			return *this;
+		}
+		if (m_allocator == other.m_allocator) {
+			free_storage();
+			m_chunks = std::move(other.m_chunks);
+			m_size = other.m_size;
+			other.m_size = 0;
+		} else {
+			assign(std::make_move_iterator(other.begin()), std::make_move_iterator(other.end()));
+			other.clear();
+		}
+		return *this;
+	}
+
+	~SegmentedVector() {
+		free_storage();
+	}
+
+// Iterators
+
+	iterator begin() {
+		return iterator(m_chunks.begin(), 0);
+	}
+
+	const_iterator begin() const {
+		return const_iterator(m_chunks.begin(), 0);
+	}
+
+	iterator end() {
+		return iterator(m_chunks.begin(), m_size);
+	}
+
+	const_iterator end() const {
+		return const_iterator(m_chunks.begin(), m_size);
+	}
+
+	reverse_iterator rbegin() {
+		return reverse_iterator(end());
+	}
+
+	const_reverse_iterator rbegin() const {
+		return const_reverse_iterator(end());
+	}
+
+	reverse_iterator rend() {
+		return reverse_iterator(begin());
+	}
+
+	const_reverse_iterator rend() const {
+		return const_reverse_iterator(begin());
+	}
+
+// Capacity
+
+	size_type size() const {
+		return m_size;
+	}
+
+	size_type capacity() const {
+		return m_chunks.size()*ChunkSize;
+	}
+
+	bool empty() const {
+		return m_size == 0;
+	}
+
+	// Allocates the missing chunks, nothing is moved
+	void reserve(size_type a_size) {
+		while (capacity() < a_size) {
+			add_chunk();
+		}
+	}
+
+	void resize(size_type a_size) {
+		resize_with(a_size, [](pointer p, allocator_type& a_allocator) {
+			a_allocator.construct(p, T());
+		});
+	}
+
+	void resize(size_type a_size, const_reference a_value) {
+		resize_with(a_size, [&a_value](pointer p, allocator_type& a_allocator) {
+			a_allocator.construct(p, a_value);
+		});
+	}
+
+// Element access
+
+	reference front() {
+		return (*this)[0];
+	}
+
+	const_reference front() const {
+		return (*this)[0];
+	}
+
+	reference back() {
+		return (*this)[m_size - 1];
+	}
+
+	const_reference back() const {
+		return (*this)[m_size - 1];
+	}
+
+	reference at(size_type a_index) {
+		if (a_index >= size()) {
+			throw std::out_of_range("custom segmented vector out of range");
+		}
+		return (*this)[a_index];
+	}
+
+	const_reference at(size_type a_index) const {
+		if (a_index >= size()) {
+			throw std::out_of_range("custom segmented vector out of range");
+		}
+		return (*this)[a_index];
+	}
+
+	reference operator[](size_type a_index) {
+		return *slot(a_index);
+	}
+
+	const_reference operator[](size_type a_index) const {
+		return *slot(a_index);
+	}
+
+// Modifiers
+
+	template <class InputIterator>
+	void assign(InputIterator a_first, InputIterator a_last) {
+		clear();
+		append(a_first, a_last);
+	}
+
+	void assign(std::initializer_list<value_type> il) {
+		assign(il.begin(), il.end());
+	}
+
+	// No element moves: the new one lands in the last chunk or in a new one
+	template <class... Args>
+	reference emplace_back(Args&&... args) {
+		if (m_size == capacity()) {
+			add_chunk();
+		}
+		pointer p = slot(m_size);
+		m_allocator.construct(p, std::forward<Args>(args)...);
+		++m_size;
+		return *p;
+	}
+
+	void push_back(const T& a_value) {
+		emplace_back(a_value);
+	}
+
+	void push_back(T&& a_value) {
+		emplace_back(std::move(a_value));
+	}
+
+	void pop_back() {
+		--m_size;
+		m_allocator.destroy(slot(m_size));
+	}
+
+	// Erasing at the tail moves nothing, elsewhere the rest is moved down
+	iterator erase(const_iterator a_first, const_iterator a_last) {
+		iterator first = begin() + (a_first - begin());
+		std::move(begin() + (a_last - begin()), end(), first);
+		destroy_tail(m_size - (a_last - a_first));
+		return first;
+	}
+
+	iterator erase(const_iterator a_position) {
+		return erase(a_position, a_position + 1);
+	}
+
+	// Chunks are kept for reuse
+	void clear() {
+		destroy_tail(0);
+	}
+
+	void swap(SegmentedVector& other) noexcept {
+		using std::swap;
+		m_chunks.swap(other.m_chunks);
+		swap(m_size, other.m_size);
+		swap_allocator(toggle<allocator_traits::propagate_on_container_swap::value>(), other.m_allocator);
+	}
+
+private:
+	template<bool>
+	struct toggle {};
+
+	void swap_allocator(toggle<true>, allocator_type& a_allocator) {
+		using std::swap;
+		swap(m_allocator, a_allocator);
+	}
+
+	void swap_allocator(toggle<false>, allocator_type&) {
+	}
+
+	pointer slot(size_type a_index) const {
+		return m_chunks[a_index/ChunkSize] + a_index%ChunkSize;
+	}
+
+	void add_chunk() {
+		pointer chunk = m_allocator.allocate(ChunkSize);
+		try {
+			m_chunks.push_back(chunk);
+		} catch (...) {
+			m_allocator.deallocate(chunk, ChunkSize);
+			throw;
+		}
+	}
+
+	void destroy_tail(size_type a_size) {
+		while (m_size > a_size) {
+			pop_back();
+		}
+	}
+
+	void free_storage() {
+		clear();
+		for(pointer chunk : m_chunks) {
+			m_allocator.deallocate(chunk, ChunkSize);
+		}
+		m_chunks.clear();
+	}
+
+	template<class InputIterator>
+	void append(InputIterator a_first, InputIterator a_last) {
+		for(; a_first != a_last; ++a_first) {
+			emplace_back(*a_first);
+		}
+	}
+
+	// Constructors release what they built when an element throws
+	template<class InputIterator>
+	void construct_range(InputIterator a_first, InputIterator a_last) {
+		try {
+			append(a_first, a_last);
+		} catch (...) {
+			free_storage();
+			throw;
+		}
+	}
+
+	template<class Construct>
+	void resize_with(size_type a_size, Construct a_construct) {
+		if (a_size <= m_size) {
+			destroy_tail(a_size);
+			return;
+		}
+		reserve(a_size);
+		for(; m_size < a_size; ++m_size) {
+			a_construct(slot(m_size), m_allocator);
+		}
+	}
+};
+
+template<class T, class A, std::size_t C>
+const typename SegmentedVector<T, A, C>::size_type SegmentedVector<T, A, C>::chunk_size;
+
+template<class T, class A, std::size_t C>
+void swap(SegmentedVector<T, A, C>& a, SegmentedVector<T, A, C>& b) noexcept {
+	a.swap(b);
+}
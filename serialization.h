@@ -0,0 +1,451 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <limits>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "vector.h"
+
+// Binary format for vectors of trivially copyable elements: a 32-byte
+// Header followed by the elements byte for byte. Files are read back
+// only on machines with the same endianness and element size, elements
+// are never converted.
+//
+// Whole vectors go through write()/read() on a file descriptor or
+// save()/load() on a path, with one system call for the elements.
+// Writer appends in chunks and can continue an existing file, Reader
+// loads one in chunks of bounded size.
+namespace serialization {
+	const std::uint8_t format_version = 1;
+
+	struct Header {
+		char magic[4];
+		std::uint8_t version;
+		std::uint8_t little_endian;
+		std::uint16_t header_size;
+		std::uint32_t element_size;
+		std::uint32_t reserved;
+		std::uint64_t count;
+		std::uint64_t checksum;
+	};
+
+	static_assert(sizeof(Header) == 32, "the header layout is part of the format");
+
+	// Position-dependent sum of mixed 64-bit words. It catches corruption,
+	// not tampering. Unlike a chained hash it can be resumed from its value
+	// and the last partial word, which lets Writer append to a file.
+	class Checksum {
+	public:
+		Checksum() : m_sum(0), m_words(0), m_pending(0) {
+		}
+
+		// Empty payloads may come as a null pointer
+		void update(const void* a_data, std::size_t a_bytes) {
+			if (a_bytes == 0) {
+				return;
+			}
+			const unsigned char* p = static_cast<const unsigned char*>(a_data);
+			if (m_pending != 0) {
+				std::size_t take = std::min(8 - m_pending, a_bytes);
+				std::memcpy(m_tail + m_pending, p, take);
+				m_pending += take;
+				p += take;
+				a_bytes -= take;
+				if (m_pending < 8) {
+					return;
+				}
+				m_sum += mix(word(m_tail, 8), m_words++);
+				m_pending = 0;
+			}
+			for(; a_bytes >= 8; a_bytes -= 8, p += 8) {
+				m_sum += mix(word(p, 8), m_words++);
+			}
+			std::memcpy(m_tail, p, a_bytes);
+			m_pending = a_bytes;
+		}
+
+		std::uint64_t value() const {
+			return m_pending == 0 ? m_sum : m_sum + mix(word(m_tail, m_pending), m_words);
+		}
+
+		// State after a_bytes bytes that ended with a_tail, the last
+		// a_bytes % 8 of them, and gave a_value
+		static Checksum resume(std::uint64_t a_value, std::uint64_t a_bytes, const unsigned char* a_tail) {
+			Checksum checksum;
+			checksum.m_words = a_bytes/8;
+			checksum.m_pending = a_bytes%8;
+			std::memcpy(checksum.m_tail, a_tail, checksum.m_pending);
+			checksum.m_sum = a_value - (checksum.m_pending == 0 ? 0 : mix(word(a_tail, checksum.m_pending), checksum.m_words));
+			return checksum;
+		}
+
+	private:
+		std::uint64_t m_sum;
+		std::uint64_t m_words;
+		std::size_t m_pending;
+		unsigned char m_tail[8];
+
+		// Zero-padded
+		static std::uint64_t word(const unsigned char* a_bytes, std::size_t a_count) {
+			std::uint64_t result = 0;
+			std::memcpy(&result, a_bytes, a_count);
+			return result;
+		}
+
+		// splitmix64 finalizer
+		static std::uint64_t mix(std::uint64_t a_word, std::uint64_t a_index) {
+			std::uint64_t x = a_word + (a_index + 1)*0x9e3779b97f4a7c15ull;
+			x = (x ^ (x >> 30))*0xbf58476d1ce4e5b9ull;
+			x = (x ^ (x >> 27))*0x94d049bb133111ebull;
+			return x ^ (x >> 31);
+		}
+	};
+
+	namespace detail {
+		inline bool little_endian() {
+			const std::uint16_t probe = 1;
+			return *reinterpret_cast<const unsigned char*>(&probe) == 1;
+		}
+
+		inline void throw_error(const char* a_call) {
+			throw std::system_error(errno, std::generic_category(), a_call);
+		}
+
+		template<class T>
+		Header make_header(std::uint64_t a_count, std::uint64_t a_checksum) {
+			Header header = {{'C', 'V', 'E', 'C'}, format_version, little_endian(), sizeof(Header), sizeof(T), 0, a_count, a_checksum};
+			return header;
+		}
+
+		template<class T>
+		void check_header(const Header& a_header) {
+			if (std::memcmp(a_header.magic, "CVEC", 4) != 0 || a_header.header_size != sizeof(Header)) {
+				throw std::runtime_error("serialization: not a vector file");
+			}
+			if (a_header.version != format_version) {
+				throw std::runtime_error("serialization: unsupported format version");
+			}
+			if (a_header.little_endian != little_endian() || a_header.element_size != sizeof(T)) {
+				throw std::runtime_error("serialization: elements do not match this type or machine");
+			}
+		}
+
+		// Bytes taken by a_count elements of T. Throws if a corrupt count
+		// cannot be the size of anything.
+		template<class T>
+		std::uint64_t element_bytes(std::uint64_t a_count) {
+			if (a_count > std::numeric_limits<std::uint64_t>::max()/sizeof(T)) {
+				throw std::runtime_error("serialization: corrupt element count");
+			}
+			return a_count*sizeof(T);
+		}
+
+		// Throws if a_file is a regular file with less than a_bytes left
+		// after its current offset. Returns false when the length of the
+		// input is unknown, as for pipes and sockets.
+		inline bool check_remaining(int a_file, std::uint64_t a_bytes) {
+			struct stat status;
+			if (fstat(a_file, &status) != 0 || !S_ISREG(status.st_mode)) {
+				return false;
+			}
+			off_t offset = lseek(a_file, 0, SEEK_CUR);
+			if (offset < 0) {
+				return false;
+			}
+			if (status.st_size < offset || std::uint64_t(status.st_size - offset) < a_bytes) {
+				throw std::runtime_error("serialization: unexpected end of input");
+			}
+			return true;
+		}
+
+		// Elements to read at once from an input of unknown length, so that
+		// a corrupt count fails on the missing data before it allocates
+		// much more memory than the input holds
+		const std::uint64_t read_step = std::uint64_t(1) << 26;
+
+		// Writes every byte of a_parts, retrying on partial writes
+		inline void write_all(int a_file, iovec* a_parts, int a_count) {
+			while (a_count > 0) {
+				ssize_t written = writev(a_file, a_parts, a_count);
+				if (written < 0) {
+					if (errno == EINTR) {
+						continue;
+					}
+					throw_error("writev");
+				}
+				for(; a_count > 0 && std::size_t(written) >= a_parts->iov_len; --a_count, ++a_parts) {
+					written -= a_parts->iov_len;
+				}
+				if (a_count > 0) {
+					a_parts->iov_base = static_cast<char*>(a_parts->iov_base) + written;
+					a_parts->iov_len -= written;
+				}
+			}
+		}
+
+		inline void write_all(int a_file, const void* a_data, std::size_t a_bytes) {
+			iovec part = {const_cast<void*>(a_data), a_bytes};
+			write_all(a_file, &part, 1);
+		}
+
+		// Throws if the input ends first
+		inline void read_all(int a_file, void* a_data, std::size_t a_bytes) {
+			char* p = static_cast<char*>(a_data);
+			while (a_bytes > 0) {
+				ssize_t count = ::read(a_file, p, a_bytes);
+				if (count < 0) {
+					if (errno == EINTR) {
+						continue;
+					}
+					throw_error("read");
+				}
+				if (count == 0) {
+					throw std::runtime_error("serialization: unexpected end of input");
+				}
+				p += count;
+				a_bytes -= count;
+			}
+		}
+
+		inline void read_all_at(int a_file, void* a_data, std::size_t a_bytes, off_t a_offset) {
+			char* p = static_cast<char*>(a_data);
+			while (a_bytes > 0) {
+				ssize_t count = pread(a_file, p, a_bytes, a_offset);
+				if (count < 0) {
+					if (errno == EINTR) {
+						continue;
+					}
+					throw_error("pread");
+				}
+				if (count == 0) {
+					throw std::runtime_error("serialization: unexpected end of input");
+				}
+				p += count;
+				a_bytes -= count;
+				a_offset += count;
+			}
+		}
+
+		// Closes the descriptor when it goes out of scope
+		struct File {
+			int descriptor;
+
+			File(const std::string& a_path, int a_flags) : descriptor(::open(a_path.c_str(), a_flags | O_CLOEXEC, 0644)) {
+				if (descriptor < 0) {
+					throw_error("open");
+				}
+			}
+
+			File(const File&) = delete;
+			File& operator=(const File&) = delete;
+
+			~File() {
+				if (descriptor >= 0) {
+					::close(descriptor);
+				}
+			}
+		};
+	}
+
+	// Header and elements in a single writev()
+	template<class T, class A, class G, class S, class R>
+	void write(int a_file, const Vector<T, A, G, S, R>& a_vector) {
+		static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable elements are written as bytes");
+		Checksum checksum;
+		checksum.update(a_vector.begin(), a_vector.size()*sizeof(T));
+		Header header = detail::make_header<T>(a_vector.size(), checksum.value());
+		iovec parts[] = {
+			{&header, sizeof(header)},
+			{const_cast<T*>(a_vector.begin()), a_vector.size()*sizeof(T)}
+		};
+		detail::write_all(a_file, parts, 2);
+	}
+
+	// Replaces the contents of a_vector with the next vector of a_file.
+	// Throws std::runtime_error if the data is not a vector of T or
+	// the checksum does not match.
+	template<class T, class A, class G, class S, class R>
+	void read(int a_file, Vector<T, A, G, S, R>& a_vector) {
+		static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable elements are read as bytes");
+		Header header;
+		detail::read_all(a_file, &header, sizeof(header));
+		detail::check_header<T>(header);
+		std::uint64_t bytes = detail::element_bytes<T>(header.count);
+		a_vector.clear();
+		if (detail::check_remaining(a_file, bytes)) {
+			a_vector.reserve(header.count);
+		}
+		for(std::uint64_t done = 0; done < header.count;) {
+			std::size_t step = std::min<std::uint64_t>(header.count - done, std::max<std::uint64_t>(1, detail::read_step/sizeof(T)));
+			a_vector.resize(done + step);
+			detail::read_all(a_file, a_vector.begin() + done, step*sizeof(T));
+			done += step;
+		}
+		Checksum checksum;
+		checksum.update(a_vector.begin(), header.count*sizeof(T));
+		if (checksum.value() != header.checksum) {
+			throw std::runtime_error("serialization: checksum mismatch");
+		}
+	}
+
+	template<class T, class A, class G, class S, class R>
+	void save(const std::string& a_path, const Vector<T, A, G, S, R>& a_vector) {
+		detail::File file(a_path, O_WRONLY | O_CREAT | O_TRUNC);
+		serialization::write(file.descriptor, a_vector);
+	}
+
+	template<class T, class A, class G, class S, class R>
+	void load(const std::string& a_path, Vector<T, A, G, S, R>& a_vector) {
+		detail::File file(a_path, O_RDONLY);
+		serialization::read(file.descriptor, a_vector);
+	}
+
+	// Writes a vector file in pieces. The header is completed by close(),
+	// which the destructor calls as well.
+	template<class T>
+	class Writer {
+		static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable elements are written as bytes");
+
+	public:
+		// Creates or truncates a_path. With a_append an existing file is
+		// continued instead; bytes past its last complete write are dropped.
+		explicit Writer(const std::string& a_path, bool a_append = false)
+			: m_file(a_path, O_RDWR | O_CREAT | (a_append ? 0 : O_TRUNC)), m_header(detail::make_header<T>(0, 0)) {
+			off_t length = lseek(m_file.descriptor, 0, SEEK_END);
+			if (length < 0) {
+				detail::throw_error("lseek");
+			}
+			if (length == 0) {
+				detail::write_all(m_file.descriptor, &m_header, sizeof(m_header));
+				return;
+			}
+			resume(length);
+		}
+
+		Writer(const Writer&) = delete;
+		Writer& operator=(const Writer&) = delete;
+
+		~Writer() {
+			try {
+				close();
+			} catch (...) {
+			}
+		}
+
+		// Elements in the file, including those written before an append
+		std::uint64_t size() const {
+			return m_header.count;
+		}
+
+		void write(const T* a_data, std::size_t a_count) {
+			m_checksum.update(a_data, a_count*sizeof(T));
+			detail::write_all(m_file.descriptor, a_data, a_count*sizeof(T));
+			m_header.count += a_count;
+		}
+
+		template<class A, class G, class S, class R>
+		void write(const Vector<T, A, G, S, R>& a_vector) {
+			write(a_vector.begin(), a_vector.size());
+		}
+
+		// Stores the count and checksum so that readers see everything
+		// written so far
+		void flush() {
+			m_header.checksum = m_checksum.value();
+			if (pwrite(m_file.descriptor, &m_header, sizeof(m_header), 0) != ssize_t(sizeof(m_header))) {
+				detail::throw_error("pwrite");
+			}
+		}
+
+		void close() {
+			if (m_file.descriptor < 0) {
+				return;
+			}
+			flush();
+			int descriptor = m_file.descriptor;
+			m_file.descriptor = -1;
+			if (::close(descriptor) != 0) {
+				detail::throw_error("close");
+			}
+		}
+
+	private:
+		detail::File m_file;
+		Header m_header;
+		Checksum m_checksum;
+
+		// Continues a file of a_length bytes. It must hold every element
+		// its header counts, a shorter one would be padded with zeros.
+		void resume(off_t a_length) {
+			detail::read_all_at(m_file.descriptor, &m_header, sizeof(m_header), 0);
+			detail::check_header<T>(m_header);
+			std::uint64_t bytes = detail::element_bytes<T>(m_header.count);
+			if (std::uint64_t(a_length) - sizeof(Header) < bytes) {
+				throw std::runtime_error("serialization: unexpected end of input");
+			}
+			unsigned char tail[8];
+			detail::read_all_at(m_file.descriptor, tail, bytes%8, sizeof(Header) + bytes - bytes%8);
+			m_checksum = Checksum::resume(m_header.checksum, bytes, tail);
+			if (ftruncate(m_file.descriptor, sizeof(Header) + bytes) != 0 ||
+				lseek(m_file.descriptor, 0, SEEK_END) < 0) {
+				detail::throw_error("ftruncate");
+			}
+		}
+	};
+
+	// Reads a vector file in chunks, so memory stays bounded
+	// by the chunk size whatever the size of the file
+	template<class T>
+	class Reader {
+		static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable elements are read as bytes");
+
+	public:
+		explicit Reader(const std::string& a_path) : m_file(a_path, O_RDONLY), m_read(0) {
+			detail::read_all(m_file.descriptor, &m_header, sizeof(m_header));
+			detail::check_header<T>(m_header);
+			detail::check_remaining(m_file.descriptor, detail::element_bytes<T>(m_header.count));
+		}
+
+		// Elements in the file
+		std::uint64_t size() const {
+			return m_header.count;
+		}
+
+		std::uint64_t remaining() const {
+			return m_header.count - m_read;
+		}
+
+		// Replaces the contents of a_chunk with the next elements, at most
+		// a_max of them, and returns their number, 0 at the end. The
+		// checksum is verified when the last element has been read.
+		template<class A, class G, class S, class R>
+		std::size_t read(Vector<T, A, G, S, R>& a_chunk, std::size_t a_max) {
+			std::size_t count = std::min<std::uint64_t>(a_max, remaining());
+			a_chunk.clear();
+			a_chunk.resize(count);
+			detail::read_all(m_file.descriptor, a_chunk.begin(), count*sizeof(T));
+			m_checksum.update(a_chunk.begin(), count*sizeof(T));
+			m_read += count;
+			if (count > 0 && remaining() == 0 && m_checksum.value() != m_header.checksum) {
+				throw std::runtime_error("serialization: checksum mismatch");
+			}
+			return count;
+		}
+
+	private:
+		detail::File m_file;
+		Header m_header;
+		std::uint64_t m_read;
+		Checksum m_checksum;
+	};
+}
@@ -0,0 +1,133 @@
+// The generic kernels of simd_sort.h. It includes this file once per
+// instruction set, inside a namespace of its own and with
+// CUSTOM_SIMD_TARGET set to the target attribute, so registers are only
+// ever passed between functions compiled for the same instruction set.
+// Deliberately no include guard.
+
+template<class V>
+CUSTOM_SIMD_TARGET void exchange(typename V::reg& v, const int* a_index, unsigned a_take_max) {
+	typename V::reg other = V::permute(v, a_index);
+	v = V::blend(V::lower(v, other), V::upper(v, other), a_take_max);
+}
+
+// Sorts R registers as one sequence of R*lanes elements: every
+// register is sorted by itself, then they are merged pairwise
+template<class V, int R>
+CUSTOM_SIMD_TARGET void sort_registers(typename V::reg* v) {
+	typedef typename V::reg reg;
+	const bitonic_stages<V::lanes>& stages = stage_table<V::lanes>::value;
+	const int merge_first = stages.count - stages.log;
+	for(int r = 0; r < R; r++) {
+		for(int s = 0; s < stages.count; s++) {
+			exchange<V>(v[r], stages.index[s], stages.take_max[s]);
+		}
+	}
+	for(int width = 1; width < R; width *= 2) {
+		for(int base = 0; base < R; base += 2*width) {
+			// The second run is compared in reverse, both halves become bitonic
+			for(int t = 0; t < width; t++) {
+				reg a = v[base + t];
+				reg b = V::permute(v[base + 2*width - 1 - t], stages.reverse);
+				v[base + t] = V::lower(a, b);
+				v[base + 2*width - 1 - t] = V::permute(V::upper(b, a), stages.reverse);
+			}
+			for(int d = width/2; d > 0; d /= 2) {
+				for(int r = base; r < base + 2*width; r++) {
+					if (((r - base) & d) == 0) {
+						reg low = V::lower(v[r], v[r + d]);
+						v[r + d] = V::upper(v[r + d], v[r]);
+						v[r] = low;
+					}
+				}
+			}
+			for(int r = base; r < base + 2*width; r++) {
+				for(int s = merge_first; s < stages.count; s++) {
+					exchange<V>(v[r], stages.index[s], stages.take_max[s]);
+				}
+			}
+		}
+	}
+}
+
+template<class V, int R>
+CUSTOM_SIMD_TARGET void sort_padded(typename V::value_type* a_buffer) {
+	typename V::reg v[R];
+	for(int r = 0; r < R; r++) {
+		v[r] = V::load(a_buffer + r*V::lanes);
+	}
+	sort_registers<V, R>(v);
+	for(int r = 0; r < R; r++) {
+		V::store(a_buffer + r*V::lanes, v[r]);
+	}
+}
+
+// Up to block_registers*lanes elements go through a padded copy
+template<class V>
+CUSTOM_SIMD_TARGET __attribute__((flatten))
+void sort_block(typename V::value_type* first, typename V::value_type* last) {
+	typedef typename V::value_type value_type;
+	const std::ptrdiff_t size = last - first;
+	const value_type padding = std::numeric_limits<value_type>::has_infinity ?
+		std::numeric_limits<value_type>::infinity() : std::numeric_limits<value_type>::max();
+	value_type buffer[block_registers*V::lanes];
+	std::fill(buffer, buffer + block_registers*V::lanes, padding);
+	std::memcpy(buffer, first, size*sizeof(value_type));
+	if (size <= V::lanes) {
+		sort_padded<V, 1>(buffer);
+	} else if (size <= 2*V::lanes) {
+		sort_padded<V, 2>(buffer);
+	} else {
+		sort_padded<V, block_registers>(buffer);
+	}
+	std::memcpy(first, buffer, size*sizeof(value_type));
+}
+
+// In-place vector partition. The first and the last register are
+// loaded up front, after that the next register is always read from
+// the side with less free space, so stores never overwrite unread
+// elements. The last size % lanes elements are placed one by one.
+template<class V>
+CUSTOM_SIMD_TARGET __attribute__((flatten))
+typename V::value_type* partition(typename V::value_type* first, typename V::value_type* last,
+	typename V::value_type a_pivot, bool a_left_equal)
+{
+	typedef typename V::value_type value_type;
+	typedef typename V::reg reg;
+	const std::ptrdiff_t lanes = V::lanes;
+	if (last - first < 2*lanes) {
+		return std::partition(first, last, [a_pivot, a_left_equal](value_type a_value) {
+			return a_left_equal ? !(a_pivot < a_value) : a_value < a_pivot;
+		});
+	}
+	value_type* end = last - (last - first) % lanes;
+	reg pivot = V::set1(a_pivot);
+	reg front = V::load(first);
+	reg back = V::load(end - lanes);
+	value_type* left = first + lanes;
+	value_type* right = end - lanes;
+	value_type* left_store = first;
+	value_type* right_store = end;
+	while (left != right) {
+		reg v;
+		if (right_store - right < left - left_store) {
+			right -= lanes;
+			v = V::load(right);
+		} else {
+			v = V::load(left);
+			left += lanes;
+		}
+		unsigned count = V::store_partitioned(left_store, right_store, v, pivot, a_left_equal);
+		left_store += count;
+		right_store -= lanes - count;
+	}
+	unsigned count = V::store_partitioned_exact(left_store, right_store, front, pivot, a_left_equal);
+	left_store += count;
+	right_store -= lanes - count;
+	left_store += V::store_partitioned_exact(left_store, right_store, back, pivot, a_left_equal);
+	for(value_type* tail = end; tail != last; ++tail) {
+		if (a_left_equal ? !(a_pivot < *tail) : *tail < a_pivot) {
+			std::iter_swap(left_store++, tail);
+		}
+	}
+	return left_store;
+}
@@ -0,0 +1,443 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CUSTOM_SIMD_SORT 1
+#include <immintrin.h>
+#define CUSTOM_AVX2   __attribute__((target("avx2,popcnt")))
+#define CUSTOM_AVX512 __attribute__((target("avx512f,popcnt")))
+#endif
+
+// Vector kernels behind custom::sort() for arrays of int32_t, int64_t,
+// float and double. Every kernel is compiled for AVX2 and AVX-512, the
+// widest one the CPU supports is picked at run time.
+namespace custom {
+	namespace simd {
+		template<class T>
+		struct kernels {
+			// Moves the elements that go left to the front of [first, last)
+			// and returns the end of them. Elements less than a_pivot go left,
+			// with a_left_equal the ones equal to it too.
+			T* (*partition)(T* first, T* last, T a_pivot, bool a_left_equal);
+			// Sorts ranges of up to block elements
+			void (*sort_block)(T* first, T* last);
+			std::ptrdiff_t block;
+		};
+
+#ifdef CUSTOM_SIMD_SORT
+#pragma GCC diagnostic push
+// _mm512_undefined_*() inside the intrinsics trips it
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+		// Stages of a bitonic sorting network over the N lanes of one
+		// register: at stage s lane i is compared with lane index[s][i]
+		// and keeps the bigger value if bit i of take_max[s] is set.
+		// The last log stages alone merge a bitonic register.
+		template<int N>
+		struct bitonic_stages {
+			enum {
+				log = N == 4 ? 2 : N == 8 ? 3 : 4,
+				count = log*(log + 1)/2
+			};
+
+			int index[count][N];
+			unsigned take_max[count];
+			int reverse[N];
+
+			constexpr bitonic_stages() : index(), take_max(), reverse() {
+				int stage = 0;
+				for(int k = 2; k <= N; k *= 2) {
+					for(int j = k/2; j > 0; j /= 2, stage++) {
+						for(int i = 0; i < N; i++) {
+							int partner = i ^ j;
+							index[stage][i] = partner;
+							// Blocks of k lanes are sorted ascending and descending in turn
+							if (((i & k) == 0) == (i > partner)) {
+								take_max[stage] |= 1u << i;
+							}
+						}
+					}
+				}
+				for(int i = 0; i < N; i++) {
+					reverse[i] = N - 1 - i;
+				}
+			}
+		};
+
+		// AVX2 has no compress store. For every mask of lanes that go left
+		// this is the dword permutation that packs them in front of the rest.
+		template<int N>
+		struct compress_table {
+			int index[1 << N][8];
+
+			constexpr compress_table() : index() {
+				const int scale = 8/N;
+				for(int mask = 0; mask < (1 << N); mask++) {
+					int out = 0;
+					for(int left = 1; left >= 0; left--) {
+						for(int lane = 0; lane < N; lane++) {
+							if (((mask >> lane) & 1) != left) {
+								continue;
+							}
+							for(int s = 0; s < scale; s++) {
+								index[mask][out*scale + s] = lane*scale + s;
+							}
+							++out;
+						}
+					}
+				}
+			}
+		};
+
+		template<int N>
+		struct stage_table {
+			static constexpr bitonic_stages<N> value = bitonic_stages<N>();
+		};
+
+		template<int N>
+		constexpr bitonic_stages<N> stage_table<N>::value;
+
+		template<int N>
+		struct pack_table {
+			static constexpr compress_table<N> value = compress_table<N>();
+		};
+
+		template<int N>
+		constexpr compress_table<N> pack_table<N>::value;
+
+		// Register traits. lower(own, other) and upper(own, other) return own
+		// unless other is strictly smaller or bigger, so equal floats such as
+		// -0.0 and +0.0 are never duplicated.
+
+		struct avx512_int32 {
+			typedef std::int32_t value_type;
+			typedef __m512i reg;
+			enum { lanes = 16 };
+
+			CUSTOM_AVX512 static reg load(const value_type* p) { return _mm512_loadu_si512(p); }
+			CUSTOM_AVX512 static void store(value_type* p, reg v) { _mm512_storeu_si512(p, v); }
+			CUSTOM_AVX512 static reg set1(value_type a_value) { return _mm512_set1_epi32(a_value); }
+			CUSTOM_AVX512 static reg permute(reg v, const int* a_index) {
+				return _mm512_permutexvar_epi32(_mm512_loadu_si512(a_index), v);
+			}
+			CUSTOM_AVX512 static reg blend(reg a, reg b, unsigned a_mask) { return _mm512_mask_mov_epi32(a, __mmask16(a_mask), b); }
+			CUSTOM_AVX512 static reg lower(reg own, reg other) { return _mm512_min_epi32(own, other); }
+			CUSTOM_AVX512 static reg upper(reg own, reg other) { return _mm512_max_epi32(own, other); }
+			CUSTOM_AVX512 static unsigned left_mask(reg v, reg pivot, bool a_left_equal) {
+				return a_left_equal ? _mm512_cmp_epi32_mask(v, pivot, _MM_CMPINT_LE) : _mm512_cmp_epi32_mask(v, pivot, _MM_CMPINT_LT);
+			}
+			CUSTOM_AVX512 static unsigned store_partitioned(value_type* left, value_type* right, reg v, reg pivot, bool a_left_equal) {
+				unsigned mask = left_mask(v, pivot, a_left_equal);
+				unsigned count = __builtin_popcount(mask);
+				_mm512_mask_compressstoreu_epi32(left, __mmask16(mask), v);
+				_mm512_mask_compressstoreu_epi32(right - (lanes - count), __mmask16(~mask), v);
+				return count;
+			}
+			CUSTOM_AVX512 static unsigned store_partitioned_exact(value_type* left, value_type* right, reg v, reg pivot, bool a_left_equal) {
+				return store_partitioned(left, right, v, pivot, a_left_equal);
+			}
+		};
+
+		struct avx512_float {
+			typedef float value_type;
+			typedef __m512 reg;
+			enum { lanes = 16 };
+
+			CUSTOM_AVX512 static reg load(const value_type* p) { return _mm512_loadu_ps(p); }
+			CUSTOM_AVX512 static void store(value_type* p, reg v) { _mm512_storeu_ps(p, v); }
+			CUSTOM_AVX512 static reg set1(value_type a_value) { return _mm512_set1_ps(a_value); }
+			CUSTOM_AVX512 static reg permute(reg v, const int* a_index) {
+				return _mm512_permutexvar_ps(_mm512_loadu_si512(a_index), v);
+			}
+			CUSTOM_AVX512 static reg blend(reg a, reg b, unsigned a_mask) { return _mm512_mask_mov_ps(a, __mmask16(a_mask), b); }
+			CUSTOM_AVX512 static reg lower(reg own, reg other) {
+				return _mm512_mask_mov_ps(own, _mm512_cmp_ps_mask(other, own, _CMP_LT_OQ), other);
+			}
+			CUSTOM_AVX512 static reg upper(reg own, reg other) {
+				return _mm512_mask_mov_ps(own, _mm512_cmp_ps_mask(own, other, _CMP_LT_OQ), other);
+			}
+			CUSTOM_AVX512 static unsigned left_mask(reg v, reg pivot, bool a_left_equal) {
+				return a_left_equal ? _mm512_cmp_ps_mask(v, pivot, _CMP_LE_OQ) : _mm512_cmp_ps_mask(v, pivot, _CMP_LT_OQ);
+			}
+			CUSTOM_AVX512 static unsigned store_partitioned(value_type* left, value_type* right, reg v, reg pivot, bool a_left_equal) {
+				unsigned mask = left_mask(v, pivot, a_left_equal);
+				unsigned count = __builtin_popcount(mask);
+				_mm512_mask_compressstoreu_ps(left, __mmask16(mask), v);
+				_mm512_mask_compressstoreu_ps(right - (lanes - count), __mmask16(~mask), v);
+				return count;
+			}
+			CUSTOM_AVX512 static unsigned store_partitioned_exact(value_type* left, value_type* right, reg v, reg pivot, bool a_left_equal) {
+				return store_partitioned(left, right, v, pivot, a_left_equal);
+			}
+		};
+
+		struct avx512_int64 {
+			typedef std::int64_t value_type;
+			typedef __m512i reg;
+			enum { lanes = 8 };
+
+			CUSTOM_AVX512 static reg load(const value_type* p) { return _mm512_loadu_si512(p); }
+			CUSTOM_AVX512 static void store(value_type* p, reg v) { _mm512_storeu_si512(p, v); }
+			CUSTOM_AVX512 static reg set1(value_type a_value) { return _mm512_set1_epi64(a_value); }
+			CUSTOM_AVX512 static reg permute(reg v, const int* a_index) {
+				return _mm512_permutexvar_epi64(_mm512_cvtepi32_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a_index))), v);
+			}
+			CUSTOM_AVX512 static reg blend(reg a, reg b, unsigned a_mask) { return _mm512_mask_mov_epi64(a, __mmask8(a_mask), b); }
+			CUSTOM_AVX512 static reg lower(reg own, reg other) { return _mm512_min_epi64(own, other); }
+			CUSTOM_AVX512 static reg upper(reg own, reg other) { return _mm512_max_epi64(own, other); }
+			CUSTOM_AVX512 static unsigned left_mask(reg v, reg pivot, bool a_left_equal) {
+				return a_left_equal ? _mm512_cmp_epi64_mask(v, pivot, _MM_CMPINT_LE) : _mm512_cmp_epi64_mask(v, pivot, _MM_CMPINT_LT);
+			}
+			CUSTOM_AVX512 static unsigned store_partitioned(value_type* left, value_type* right, reg v, reg pivot, bool a_left_equal) {
+				unsigned mask = left_mask(v, pivot, a_left_equal);
+				unsigned count = __builtin_popcount(mask);
+				_mm512_mask_compressstoreu_epi64(left, __mmask8(mask), v);
+				_mm512_mask_compressstoreu_epi64(right - (lanes - count), __mmask8(~mask), v);
+				return count;
+			}
+			CUSTOM_AVX512 static unsigned store_partitioned_exact(value_type* left, value_type* right, reg v, reg pivot, bool a_left_equal) {
+				return store_partitioned(left, right, v, pivot, a_left_equal);
+			}
+		};
+
+		struct avx512_double {
+			typedef double value_type;
+			typedef __m512d reg;
+			enum { lanes = 8 };
+
+			CUSTOM_AVX512 static reg load(const value_type* p) { return _mm512_loadu_pd(p); }
+			CUSTOM_AVX512 static void store(value_type* p, reg v) { _mm512_storeu_pd(p, v); }
+			CUSTOM_AVX512 static reg set1(value_type a_value) { return _mm512_set1_pd(a_value); }
+			CUSTOM_AVX512 static reg permute(reg v, const int* a_index) {
+				return _mm512_permutexvar_pd(_mm512_cvtepi32_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a_index))), v);
+			}
+			CUSTOM_AVX512 static reg blend(reg a, reg b, unsigned a_mask) { return _mm512_mask_mov_pd(a, __mmask8(a_mask), b); }
+			CUSTOM_AVX512 static reg lower(reg own, reg other) {
+				return _mm512_mask_mov_pd(own, _mm512_cmp_pd_mask(other, own, _CMP_LT_OQ), other);
+			}
+			CUSTOM_AVX512 static reg upper(reg own, reg other) {
+				return _mm512_mask_mov_pd(own, _mm512_cmp_pd_mask(own, other, _CMP_LT_OQ), other);
+			}
+			CUSTOM_AVX512 static unsigned left_mask(reg v, reg pivot, bool a_left_equal) {
+				return a_left_equal ? _mm512_cmp_pd_mask(v, pivot, _CMP_LE_OQ) : _mm512_cmp_pd_mask(v, pivot, _CMP_LT_OQ);
+			}
+			CUSTOM_AVX512 static unsigned store_partitioned(value_type* left, value_type* right, reg v, reg pivot, bool a_left_equal) {
+				unsigned mask = left_mask(v, pivot, a_left_equal);
+				unsigned count = __builtin_popcount(mask);
+				_mm512_mask_compressstoreu_pd(left, __mmask8(mask), v);
+				_mm512_mask_compressstoreu_pd(right - (lanes - count), __mmask8(~mask), v);
+				return count;
+			}
+			CUSTOM_AVX512 static unsigned store_partitioned_exact(value_type* left, value_type* right, reg v, reg pivot, bool a_left_equal) {
+				return store_partitioned(left, right, v, pivot, a_left_equal);
+			}
+		};
+
+		// Lanes whose bit is set in a_mask become all ones
+		CUSTOM_AVX2 inline __m256i avx2_mask32(unsigned a_mask) {
+			const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+			return _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(a_mask), bits), bits);
+		}
+
+		CUSTOM_AVX2 inline __m256i avx2_mask64(unsigned a_mask) {
+			const __m256i bits = _mm256_setr_epi64x(1, 2, 4, 8);
+			return _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_set1_epi64x(a_mask), bits), bits);
+		}
+
+		// Dword permutation that moves whole 64 bit lanes
+		CUSTOM_AVX2 inline __m256i avx2_index64(const int* a_index) {
+			__m256i lane = _mm256_slli_epi64(_mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a_index))), 1);
+			return _mm256_or_si256(lane, _mm256_slli_epi64(_mm256_add_epi64(lane, _mm256_set1_epi64x(1)), 32));
+		}
+
+		// Packs the lanes that go left in front of the others. The loop of
+		// partition() has room for a whole register on both sides, so the
+		// packed register is stored twice instead of compressed.
+		template<class V>
+		struct avx2_partition_store {
+			template<class value_type, class reg>
+			CUSTOM_AVX2 static unsigned store_partitioned(value_type* left, value_type* right, reg v, reg pivot, bool a_left_equal) {
+				unsigned mask = V::left_mask(v, pivot, a_left_equal);
+				reg packed = V::pack(v, pack_table<V::lanes>::value.index[mask]);
+				V::store(left, packed);
+				V::store(right - V::lanes, packed);
+				return __builtin_popcount(mask);
+			}
+
+			template<class value_type, class reg>
+			CUSTOM_AVX2 static unsigned store_partitioned_exact(value_type* left, value_type* right, reg v, reg pivot, bool a_left_equal) {
+				unsigned mask = V::left_mask(v, pivot, a_left_equal);
+				unsigned count = __builtin_popcount(mask);
+				value_type packed[V::lanes];
+				V::store(packed, V::pack(v, pack_table<V::lanes>::value.index[mask]));
+				std::memcpy(left, packed, count*sizeof(value_type));
+				std::memcpy(right - (V::lanes - count), packed + count, (V::lanes - count)*sizeof(value_type));
+				return count;
+			}
+		};
+
+		struct avx2_int32 : avx2_partition_store<avx2_int32> {
+			typedef std::int32_t value_type;
+			typedef __m256i reg;
+			enum { lanes = 8 };
+
+			CUSTOM_AVX2 static reg load(const value_type* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+			CUSTOM_AVX2 static void store(value_type* p, reg v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+			CUSTOM_AVX2 static reg set1(value_type a_value) { return _mm256_set1_epi32(a_value); }
+			CUSTOM_AVX2 static reg pack(reg v, const int* a_dwords) {
+				return _mm256_permutevar8x32_epi32(v, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a_dwords)));
+			}
+			CUSTOM_AVX2 static reg permute(reg v, const int* a_index) { return pack(v, a_index); }
+			CUSTOM_AVX2 static reg blend(reg a, reg b, unsigned a_mask) { return _mm256_blendv_epi8(a, b, avx2_mask32(a_mask)); }
+			CUSTOM_AVX2 static reg lower(reg own, reg other) { return _mm256_min_epi32(own, other); }
+			CUSTOM_AVX2 static reg upper(reg own, reg other) { return _mm256_max_epi32(own, other); }
+			CUSTOM_AVX2 static unsigned left_mask(reg v, reg pivot, bool a_left_equal) {
+				if (a_left_equal) {
+					return ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v, pivot))) & 0xFF;
+				}
+				return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(pivot, v)));
+			}
+		};
+
+		struct avx2_float : avx2_partition_store<avx2_float> {
+			typedef float value_type;
+			typedef __m256 reg;
+			enum { lanes = 8 };
+
+			CUSTOM_AVX2 static reg load(const value_type* p) { return _mm256_loadu_ps(p); }
+			CUSTOM_AVX2 static void store(value_type* p, reg v) { _mm256_storeu_ps(p, v); }
+			CUSTOM_AVX2 static reg set1(value_type a_value) { return _mm256_set1_ps(a_value); }
+			CUSTOM_AVX2 static reg pack(reg v, const int* a_dwords) {
+				return _mm256_permutevar8x32_ps(v, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a_dwords)));
+			}
+			CUSTOM_AVX2 static reg permute(reg v, const int* a_index) { return pack(v, a_index); }
+			CUSTOM_AVX2 static reg blend(reg a, reg b, unsigned a_mask) {
+				return _mm256_blendv_ps(a, b, _mm256_castsi256_ps(avx2_mask32(a_mask)));
+			}
+			CUSTOM_AVX2 static reg lower(reg own, reg other) {
+				return _mm256_blendv_ps(own, other, _mm256_cmp_ps(other, own, _CMP_LT_OQ));
+			}
+			CUSTOM_AVX2 static reg upper(reg own, reg other) {
+				return _mm256_blendv_ps(own, other, _mm256_cmp_ps(own, other, _CMP_LT_OQ));
+			}
+			CUSTOM_AVX2 static unsigned left_mask(reg v, reg pivot, bool a_left_equal) {
+				if (a_left_equal) {
+					return _mm256_movemask_ps(_mm256_cmp_ps(v, pivot, _CMP_LE_OQ));
+				}
+				return _mm256_movemask_ps(_mm256_cmp_ps(v, pivot, _CMP_LT_OQ));
+			}
+		};
+
+		struct avx2_int64 : avx2_partition_store<avx2_int64> {
+			typedef std::int64_t value_type;
+			typedef __m256i reg;
+			enum { lanes = 4 };
+
+			CUSTOM_AVX2 static reg load(const value_type* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+			CUSTOM_AVX2 static void store(value_type* p, reg v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+			CUSTOM_AVX2 static reg set1(value_type a_value) { return _mm256_set1_epi64x(a_value); }
+			CUSTOM_AVX2 static reg pack(reg v, const int* a_dwords) {
+				return _mm256_permutevar8x32_epi32(v, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a_dwords)));
+			}
+			CUSTOM_AVX2 static reg permute(reg v, const int* a_index) { return _mm256_permutevar8x32_epi32(v, avx2_index64(a_index)); }
+			CUSTOM_AVX2 static reg blend(reg a, reg b, unsigned a_mask) { return _mm256_blendv_epi8(a, b, avx2_mask64(a_mask)); }
+			CUSTOM_AVX2 static reg lower(reg own, reg other) { return _mm256_blendv_epi8(own, other, _mm256_cmpgt_epi64(own, other)); }
+			CUSTOM_AVX2 static reg upper(reg own, reg other) { return _mm256_blendv_epi8(own, other, _mm256_cmpgt_epi64(other, own)); }
+			CUSTOM_AVX2 static unsigned left_mask(reg v, reg pivot, bool a_left_equal) {
+				if (a_left_equal) {
+					return ~_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(v, pivot))) & 0xF;
+				}
+				return _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(pivot, v)));
+			}
+		};
+
+		struct avx2_double : avx2_partition_store<avx2_double> {
+			typedef double value_type;
+			typedef __m256d reg;
+			enum { lanes = 4 };
+
+			CUSTOM_AVX2 static reg load(const value_type* p) { return _mm256_loadu_pd(p); }
+			CUSTOM_AVX2 static void store(value_type* p, reg v) { _mm256_storeu_pd(p, v); }
+			CUSTOM_AVX2 static reg set1(value_type a_value) { return _mm256_set1_pd(a_value); }
+			CUSTOM_AVX2 static reg pack(reg v, const int* a_dwords) {
+				return _mm256_castps_pd(_mm256_permutevar8x32_ps(_mm256_castpd_ps(v), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a_dwords))));
+			}
+			CUSTOM_AVX2 static reg permute(reg v, const int* a_index) {
+				return _mm256_castps_pd(_mm256_permutevar8x32_ps(_mm256_castpd_ps(v), avx2_index64(a_index)));
+			}
+			CUSTOM_AVX2 static reg blend(reg a, reg b, unsigned a_mask) {
+				return _mm256_blendv_pd(a, b, _mm256_castsi256_pd(avx2_mask64(a_mask)));
+			}
+			CUSTOM_AVX2 static reg lower(reg own, reg other) {
+				return _mm256_blendv_pd(own, other, _mm256_cmp_pd(other, own, _CMP_LT_OQ));
+			}
+			CUSTOM_AVX2 static reg upper(reg own, reg other) {
+				return _mm256_blendv_pd(own, other, _mm256_cmp_pd(own, other, _CMP_LT_OQ));
+			}
+			CUSTOM_AVX2 static unsigned left_mask(reg v, reg pivot, bool a_left_equal) {
+				if (a_left_equal) {
+					return _mm256_movemask_pd(_mm256_cmp_pd(v, pivot, _CMP_LE_OQ));
+				}
+				return _mm256_movemask_pd(_mm256_cmp_pd(v, pivot, _CMP_LT_OQ));
+			}
+		};
+
+		// Registers per sort_block(): up to 4*lanes elements are sorted at once
+		const int block_registers = 4;
+
+		// The generic kernels compiled for each instruction set
+		namespace avx512 {
+#define CUSTOM_SIMD_TARGET CUSTOM_AVX512
+#include "simd_kernels.h"
+#undef CUSTOM_SIMD_TARGET
+		}
+
+		namespace avx2 {
+#define CUSTOM_SIMD_TARGET CUSTOM_AVX2
+#include "simd_kernels.h"
+#undef CUSTOM_SIMD_TARGET
+		}
+
+		// Kernels of one instruction set, nullptr if the CPU lacks it
+		template<class V>
+		const kernels<typename V::value_type>* avx512_kernels() {
+			static const kernels<typename V::value_type> table = {
+				&avx512::partition<V>, &avx512::sort_block<V>, block_registers*V::lanes
+			};
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx512f") ? &table : nullptr;
+		}
+
+		template<class V>
+		const kernels<typename V::value_type>* avx2_kernels() {
+			static const kernels<typename V::value_type> table = {
+				&avx2::partition<V>, &avx2::sort_block<V>, block_registers*V::lanes
+			};
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2") ? &table : nullptr;
+		}
+
+		template<class V512, class V2>
+		const kernels<typename V512::value_type>* best_kernels() {
+			static const kernels<typename V512::value_type>* best =
+				avx512_kernels<V512>() != nullptr ? avx512_kernels<V512>() : avx2_kernels<V2>();
+			return best;
+		}
+
+		inline const kernels<std::int32_t>* find_kernels(std::int32_t*) { return best_kernels<avx512_int32, avx2_int32>(); }
+		inline const kernels<std::int64_t>* find_kernels(std::int64_t*) { return best_kernels<avx512_int64, avx2_int64>(); }
+		inline const kernels<float>* find_kernels(float*) { return best_kernels<avx512_float, avx2_float>(); }
+		inline const kernels<double>* find_kernels(double*) { return best_kernels<avx512_double, avx2_double>(); }
+#pragma GCC diagnostic pop
+#else
+		template<class T>
+		const kernels<T>* find_kernels(T*) {
+			return nullptr;
+		}
+#endif
+	}
+}
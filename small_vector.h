@@ -0,0 +1,285 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include "vector.h"
+
+// Serves the first N elements from a buffer inside the allocator itself
+// and everything bigger from the upstream allocator A. Copies never share
+// the buffer, each one starts with its own empty storage.
+template<class T, std::size_t N, class A = std::allocator<T>>
+class InlineAllocator {
+public:
+	typedef typename A::value_type      value_type;
+	typedef typename A::size_type       size_type;
+	typedef typename A::difference_type difference_type;
+	typedef typename A::pointer         pointer;
+	typedef typename A::reference       reference;
+	typedef typename A::const_pointer   const_pointer;
+	typedef typename A::const_reference const_reference;
+	typedef std::false_type             is_always_equal;
+
+	template<class U>
+	struct rebind {
+		typedef InlineAllocator<U, N, typename std::allocator_traits<A>::template rebind_alloc<U>> other;
+	};
+
+	InlineAllocator() : m_inline_used(false) {
+	}
+
+	InlineAllocator(const InlineAllocator& other) : m_upstream(other.m_upstream), m_inline_used(false) {
+	}
+
+	InlineAllocator& operator=(const InlineAllocator& other) {
+		m_upstream = other.m_upstream;
+		return *this;
+	}
+
+	pointer inline_buffer() {
+		return reinterpret_cast<pointer>(&m_buffer);
+	}
+
+	const_pointer inline_buffer() const {
+		return reinterpret_cast<const_pointer>(&m_buffer);
+	}
+
+	// The inline buffer goes to one owner at a time
+	pointer allocate(size_type n, const_pointer hint = 0) {
+		if (n <= N && !m_inline_used) {
+			m_inline_used = true;
+			return inline_buffer();
+		}
+		return m_upstream.allocate(n);
+	}
+
+	void deallocate(pointer p, size_type n) {
+		if (p == inline_buffer()) {
+			m_inline_used = false;
+		} else {
+			m_upstream.deallocate(p, n);
+		}
+	}
+
+	// The inline buffer always has room for N elements
+	bool extend(pointer p, size_type, size_type a_new_size) {
+		return p == inline_buffer() && a_new_size <= N;
+	}
+
+	// Heap buffers are moved to shrink, the inline
+	// buffer keeps its room for N elements
+	bool relocate_to_shrink(pointer p) const {
+		return p != inline_buffer();
+	}
+
+	size_type max_size() const {
+		return m_upstream.max_size();
+	}
+
+	template<class U, class... Args>
+	void construct(U* p, Args&&... args) {
+		m_upstream.construct(p, std::forward<Args>(args)...);
+	}
+
+	template<class U>
+	void destroy(U* p) {
+		m_upstream.destroy(p);
+	}
+
+	bool operator==(const InlineAllocator& other) const {
+		return this == &other;
+	}
+
+	bool operator!=(const InlineAllocator& other) const {
+		return this != &other;
+	}
+
+private:
+	A m_upstream;
+	bool m_inline_used;
+	typename std::aligned_storage<N*sizeof(T), alignof(T)>::type m_buffer;
+};
+
+// Vector with room for N elements inside the object. It touches the
+// upstream allocator only when it grows beyond N. The Vector base is
+// private: its move and swap would hand the inline buffer to another
+// vector.
+template<class T, std::size_t N, class A = std::allocator<T>, class G = growth::Default, class S = stats::None, class R = reclaim::Never>
+class SmallVector : private Vector<T, InlineAllocator<T, N, A>, G, S, R> {
+	static_assert(N > 0, "SmallVector needs at least one inline element");
+
+	typedef Vector<T, InlineAllocator<T, N, A>, G, S, R> base;
+
+public:
+	typedef typename base::allocator_type         allocator_type;
+	typedef typename base::growth_policy          growth_policy;
+	typedef typename base::stats_policy           stats_policy;
+	typedef typename base::reclaim_policy         reclaim_policy;
+	typedef typename base::value_type             value_type;
+	typedef typename base::reference              reference;
+	typedef typename base::const_reference        const_reference;
+	typedef typename base::size_type              size_type;
+	typedef typename base::difference_type        difference_type;
+	typedef typename base::pointer                pointer;
+	typedef typename base::const_pointer          const_pointer;
+	typedef typename base::iterator               iterator;
+	typedef typename base::const_iterator         const_iterator;
+	typedef typename base::reverse_iterator       reverse_iterator;
+	typedef typename base::const_reverse_iterator const_reverse_iterator;
+
+	static const size_type inline_capacity = N;
+
+// Constructors
+
+	SmallVector() {
+		this->reserve(N);
+	}
+
+	explicit SmallVector(size_type a_size) {
+		this->reserve(N);
+		this->resize(a_size);
+	}
+
+	SmallVector(size_type a_size, const_reference a_value) {
+		this->reserve(N);
+		this->assign(a_size, a_value);
+	}
+
+	SmallVector(std::initializer_list<value_type> il) {
+		this->reserve(N);
+		this->assign(il.begin(), il.end());
+	}
+
+	template <class InputIterator>
+	SmallVector(InputIterator a_first, InputIterator a_last) {
+		this->reserve(N);
+		this->assign(a_first, a_last);
+	}
+
+	SmallVector(const SmallVector& other) : base() {
+		this->reserve(N);
+		this->assign(other.begin(), other.end());
+	}
+
+	SmallVector(SmallVector&& other) noexcept(std::is_nothrow_move_constructible<T>::value) : base() {
+		this->reserve(N);
+		take(other);
+	}
+
+	SmallVector& operator=(const SmallVector& other) {
+		if (this != &other) {
+			this->assign(other.begin(), other.end());
+		}
+		return *this;
+	}
+
+	SmallVector& operator=(SmallVector&& other) noexcept(std::is_nothrow_move_constructible<T>::value) {
+		if (this != &other) {
+			this->clear();
+			take(other);
+		}
+		return *this;
+	}
+
+// Iterators
+
+	using base::begin;
+	using base::end;
+	using base::rbegin;
+	using base::rend;
+
+// Capacity
+
+	using base::size;
+	using base::capacity;
+	using base::empty;
+	using base::stats;
+	using base::reserve;
+	using base::resize;
+	using base::resize_with;
+	using base::resize_default_init;
+	using base::resize_and_overwrite;
+
+	// True while the elements live in the inline buffer
+	bool is_small() const {
+		return this->begin() == this->m_allocator.inline_buffer();
+	}
+
+	// Elements moved back into the inline buffer get all of its room
+	void shrink_to_fit() {
+		base::shrink_to_fit();
+		keep_inline_room();
+	}
+
+	template<class Policy>
+	size_type trim(Policy a_policy = Policy()) {
+		size_type bytes = base::trim(a_policy);
+		keep_inline_room();
+		return bytes;
+	}
+
+// Element access
+
+	using base::front;
+	using base::back;
+	using base::at;
+	using base::operator[];
+	using base::data;
+
+// Modifiers
+
+	using base::insert;
+	using base::append_range;
+	using base::assign;
+	using base::emplace;
+	using base::emplace_back;
+	using base::push_back;
+	using base::erase;
+	using base::erase_if;
+	using base::pop_back;
+	using base::clear;
+
+	void swap(SmallVector& other) {
+		SmallVector temporary(std::move(other));
+		other = std::move(*this);
+		*this = std::move(temporary);
+	}
+
+private:
+	void keep_inline_room() {
+		if (is_small()) {
+			this->m_memory_end = this->m_memory_begin + N;
+		}
+	}
+
+	// Heap buffers change hands, inline elements are moved one by one.
+	// Leaves other empty and small.
+	void take(SmallVector& other) {
+		if (other.is_small()) {
+			this->assign(std::make_move_iterator(other.begin()), std::make_move_iterator(other.end()));
+			other.clear();
+			return;
+		}
+		this->free_storage();
+		this->take_stats(other, other.capacity());
+		this->m_memory_begin = other.m_memory_begin;
+		this->m_end = other.m_end;
+		this->m_memory_end = other.m_memory_end;
+		// Hands out the inline buffer
+		other.m_end = other.allocate(N);
+	}
+};
+
+template<class T, std::size_t N, class A, class G, class S, class R>
+const typename SmallVector<T, N, A, G, S, R>::size_type SmallVector<T, N, A, G, S, R>::inline_capacity;
+
+template<class T, std::size_t N, class A, class G, class S, class R>
+void swap(SmallVector<T, N, A, G, S, R>& a, SmallVector<T, N, A, G, S, R>& b) {
+	a.swap(b);
+}
+
+template<class T, std::size_t N, class A, class G, class S, class R, class Predicate>
+typename SmallVector<T, N, A, G, S, R>::size_type erase_if(SmallVector<T, N, A, G, S, R>& a_vector, Predicate a_predicate) {
+	return a_vector.erase_if(a_predicate);
+}
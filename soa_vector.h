@@ -0,0 +1,524 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "vector.h"
+#include "sort.h"
+
+// Contiguous view of one column
+template<class T>
+class Column {
+public:
+	typedef T*          iterator;
+	typedef std::size_t size_type;
+
+	Column(T* a_data, size_type a_size) : m_data(a_data), m_size(a_size) {
+	}
+
+	T* data() const {
+		return m_data;
+	}
+
+	size_type size() const {
+		return m_size;
+	}
+
+	T* begin() const {
+		return m_data;
+	}
+
+	T* end() const {
+		return m_data + m_size;
+	}
+
+	T& operator[](size_type a_index) const {
+		return m_data[a_index];
+	}
+
+private:
+	T* m_data;
+	size_type m_size;
+};
+
+// Structure of arrays: one Vector per field, rows addressed by index.
+// Rows are read and written through proxy references, which convert to
+// and from std::tuple<Fields...>; scans over a field use column<I>().
+// Iterators are random access, so custom::sort() and the std algorithms
+// work on rows, see field_less.
+template<class... Fields>
+class SoAVector {
+	static_assert(sizeof...(Fields) > 0, "SoAVector needs at least one field");
+
+	typedef std::tuple<Vector<Fields>...> columns_type;
+	typedef std::index_sequence_for<Fields...> indices;
+
+public:
+	typedef std::tuple<Fields...> value_type;
+	typedef std::size_t           size_type;
+	typedef std::ptrdiff_t        difference_type;
+
+	template<std::size_t I>
+	using field_type = typename std::tuple_element<I, value_type>::type;
+
+	// Refers to one row. Assignment writes the fields, it never rebinds.
+	template<bool Const>
+	class basic_reference {
+		typedef typename std::conditional<Const, const SoAVector, SoAVector>::type owner_type;
+
+	public:
+		basic_reference(owner_type* a_owner, size_type a_index) : m_owner(a_owner), m_index(a_index) {
+		}
+
+		basic_reference(const basic_reference&) = default;
+
+		// reference converts to const_reference
+		template<bool Other, typename = typename std::enable_if<Const && !Other>::type>
+		basic_reference(const basic_reference<Other>& other) : m_owner(other.m_owner), m_index(other.m_index) {
+		}
+
+		template<std::size_t I>
+		typename std::conditional<Const, const field_type<I>&, field_type<I>&>::type get() const {
+			return std::get<I>(m_owner->m_columns)[m_index];
+		}
+
+		operator value_type() const {
+			return copy(indices());
+		}
+
+		const basic_reference& operator=(const value_type& a_value) const {
+			assign(a_value, indices());
+			return *this;
+		}
+
+		const basic_reference& operator=(value_type&& a_value) const {
+			assign_moved(a_value, indices());
+			return *this;
+		}
+
+		// Copies even from a temporary proxy: rows[i] = rows[j] leaves row j alone
+		const basic_reference& operator=(const basic_reference& other) const {
+			assign(other, indices());
+			return *this;
+		}
+
+		friend void swap(const basic_reference& a, const basic_reference& b) {
+			a.swap_fields(b, indices());
+		}
+
+		bool operator==(const value_type& a_value) const {
+			return value_type(*this) == a_value;
+		}
+
+		bool operator!=(const value_type& a_value) const {
+			return value_type(*this) != a_value;
+		}
+
+	private:
+		template<bool> friend class basic_reference;
+
+		owner_type* m_owner;
+		size_type m_index;
+
+		template<std::size_t... I>
+		value_type copy(std::index_sequence<I...>) const {
+			return value_type(get<I>()...);
+		}
+
+		template<class Row, std::size_t... I>
+		void assign(const Row& a_row, std::index_sequence<I...>) const {
+			int expand[] = {0, (get<I>() = field<I>(a_row), 0)...};
+			(void)expand;
+		}
+
+		template<class Row, std::size_t... I>
+		void assign_moved(Row& a_row, std::index_sequence<I...>) const {
+			int expand[] = {0, (get<I>() = std::move(field<I>(a_row)), 0)...};
+			(void)expand;
+		}
+
+		template<std::size_t... I>
+		void swap_fields(const basic_reference& other, std::index_sequence<I...>) const {
+			using std::swap;
+			int expand[] = {0, (swap(get<I>(), other.template get<I>()), 0)...};
+			(void)expand;
+		}
+
+		template<std::size_t I>
+		static const field_type<I>& field(const value_type& a_row) {
+			return std::get<I>(a_row);
+		}
+
+		template<std::size_t I>
+		static field_type<I>& field(value_type& a_row) {
+			return std::get<I>(a_row);
+		}
+
+		template<std::size_t I, bool Other>
+		static decltype(auto) field(const basic_reference<Other>& a_row) {
+			return a_row.template get<I>();
+		}
+	};
+
+	typedef basic_reference<false> reference;
+	typedef basic_reference<true>  const_reference;
+
+	template<bool Const>
+	class basic_iterator {
+		typedef typename std::conditional<Const, const SoAVector, SoAVector>::type owner_type;
+
+	public:
+		typedef std::random_access_iterator_tag iterator_category;
+		typedef typename SoAVector::value_type value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef basic_reference<Const> reference;
+		typedef void pointer;
+
+		basic_iterator() : m_owner(nullptr), m_index(0) {
+		}
+
+		basic_iterator(owner_type* a_owner, size_type a_index) : m_owner(a_owner), m_index(a_index) {
+		}
+
+		// iterator converts to const_iterator
+		template<bool Other, typename = typename std::enable_if<Const && !Other>::type>
+		basic_iterator(const basic_iterator<Other>& other) : m_owner(other.m_owner), m_index(other.m_index) {
+		}
+
+		reference operator*() const {
+			return reference(m_owner, m_index);
+		}
+
+		reference operator[](difference_type a_offset) const {
+			return reference(m_owner, m_index + a_offset);
+		}
+
+		basic_iterator& operator++() {
+			++m_index;
+			return *this;
+		}
+
+		basic_iterator operator++(int) {
+			basic_iterator old(*this);
+			++m_index;
+			return old;
+		}
+
+		basic_iterator& operator--() {
+			--m_index;
+			return *this;
+		}
+
+		basic_iterator operator--(int) {
+			basic_iterator old(*this);
+			--m_index;
+			return old;
+		}
+
+		basic_iterator& operator+=(difference_type a_offset) {
+			m_index += a_offset;
+			return *this;
+		}
+
+		basic_iterator& operator-=(difference_type a_offset) {
+			m_index -= a_offset;
+			return *this;
+		}
+
+		basic_iterator operator+(difference_type a_offset) const {
+			return basic_iterator(m_owner, m_index + a_offset);
+		}
+
+		friend basic_iterator operator+(difference_type a_offset, const basic_iterator& a_iterator) {
+			return a_iterator + a_offset;
+		}
+
+		basic_iterator operator-(difference_type a_offset) const {
+			return basic_iterator(m_owner, m_index - a_offset);
+		}
+
+		template<bool Other>
+		difference_type operator-(const basic_iterator<Other>& other) const {
+			return difference_type(m_index) - difference_type(other.m_index);
+		}
+
+		template<bool Other>
+		bool operator==(const basic_iterator<Other>& other) const {
+			return m_index == other.m_index;
+		}
+
+		template<bool Other>
+		bool operator!=(const basic_iterator<Other>& other) const {
+			return m_index != other.m_index;
+		}
+
+		template<bool Other>
+		bool operator<(const basic_iterator<Other>& other) const {
+			return m_index < other.m_index;
+		}
+
+		template<bool Other>
+		bool operator>(const basic_iterator<Other>& other) const {
+			return m_index > other.m_index;
+		}
+
+		template<bool Other>
+		bool operator<=(const basic_iterator<Other>& other) const {
+			return m_index <= other.m_index;
+		}
+
+		template<bool Other>
+		bool operator>=(const basic_iterator<Other>& other) const {
+			return m_index >= other.m_index;
+		}
+
+	private:
+		template<bool> friend class basic_iterator;
+
+		owner_type* m_owner;
+		size_type m_index;
+	};
+
+	typedef basic_iterator<false> iterator;
+	typedef basic_iterator<true>  const_iterator;
+
+// Iterators
+
+	iterator begin() {
+		return iterator(this, 0);
+	}
+
+	const_iterator begin() const {
+		return const_iterator(this, 0);
+	}
+
+	iterator end() {
+		return iterator(this, size());
+	}
+
+	const_iterator end() const {
+		return const_iterator(this, size());
+	}
+
+// Capacity
+
+	size_type size() const {
+		return std::get<0>(m_columns).size();
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+
+	void reserve(size_type a_size) {
+		for_each_column([a_size](auto& a_column) {
+			a_column.reserve(a_size);
+		});
+	}
+
+	// New rows are value-initialized
+	void resize(size_type a_size) {
+		for_each_column([a_size](auto& a_column) {
+			a_column.resize(a_size);
+		});
+	}
+
+// Element access
+
+	reference operator[](size_type a_index) {
+		return reference(this, a_index);
+	}
+
+	const_reference operator[](size_type a_index) const {
+		return const_reference(this, a_index);
+	}
+
+	reference at(size_type a_index) {
+		if (a_index >= size()) {
+			throw std::out_of_range("custom soa vector out of range");
+		}
+		return (*this)[a_index];
+	}
+
+	const_reference at(size_type a_index) const {
+		if (a_index >= size()) {
+			throw std::out_of_range("custom soa vector out of range");
+		}
+		return (*this)[a_index];
+	}
+
+	reference front() {
+		return (*this)[0];
+	}
+
+	const_reference front() const {
+		return (*this)[0];
+	}
+
+	reference back() {
+		return (*this)[size() - 1];
+	}
+
+	const_reference back() const {
+		return (*this)[size() - 1];
+	}
+
+	// All values of field I, contiguous
+	template<std::size_t I>
+	Column<field_type<I>> column() {
+		return Column<field_type<I>>(std::get<I>(m_columns).begin(), size());
+	}
+
+	template<std::size_t I>
+	Column<const field_type<I>> column() const {
+		return Column<const field_type<I>>(std::get<I>(m_columns).begin(), size());
+	}
+
+// Modifiers
+
+	// One argument per field. If a field throws, the columns
+	// already extended are cut back.
+	template<class... Args>
+	void emplace_back(Args&&... args) {
+		static_assert(sizeof...(Args) == sizeof...(Fields), "emplace_back takes one argument per field");
+		size_type old_size = size();
+		try {
+			append(indices(), std::forward<Args>(args)...);
+		} catch (...) {
+			truncate(old_size);
+			throw;
+		}
+	}
+
+	void push_back(const value_type& a_value) {
+		push_back_row(a_value, indices());
+	}
+
+	void push_back(value_type&& a_value) {
+		push_back_row(std::move(a_value), indices());
+	}
+
+	template<bool Const>
+	void push_back(const basic_reference<Const>& a_row) {
+		push_back(value_type(a_row));
+	}
+
+	void pop_back() {
+		for_each_column([](auto& a_column) {
+			a_column.pop_back();
+		});
+	}
+
+	iterator erase(const_iterator a_first, const_iterator a_last) {
+		size_type first = a_first - begin();
+		size_type last = a_last - begin();
+		for_each_column([first, last](auto& a_column) {
+			a_column.erase(a_column.begin() + first, a_column.begin() + last);
+		});
+		return begin() + first;
+	}
+
+	iterator erase(const_iterator a_position) {
+		return erase(a_position, a_position + 1);
+	}
+
+	void clear() {
+		truncate(0);
+	}
+
+	void swap(SoAVector& other) {
+		m_columns.swap(other.m_columns);
+	}
+
+	// Sorts the rows by field I. Sorts (key, row) pairs and gathers
+	// every column once, so each field is moved once instead of at every
+	// swap; the gain over sorting through proxies grows with the row.
+	template<std::size_t I, class Compare = std::less<>>
+	void sort_by(Compare comp = Compare()) {
+		typedef std::pair<field_type<I>, size_type> entry;
+		Vector<entry> order;
+		order.reserve(size());
+		const Vector<field_type<I>>& keys = std::get<I>(m_columns);
+		for(size_type i = 0; i < size(); i++) {
+			order.push_back(entry(keys[i], i));
+		}
+		custom::sort(order.begin(), order.end(), [&comp](const entry& a, const entry& b) {
+			return comp(a.first, b.first);
+		});
+		for_each_column([&order](auto& a_column) {
+			typename std::remove_reference<decltype(a_column)>::type sorted;
+			sorted.reserve(order.size());
+			for(const entry& e : order) {
+				sorted.push_back(std::move(a_column[e.second]));
+			}
+			a_column.swap(sorted);
+		});
+	}
+
+private:
+	columns_type m_columns;
+
+	template<class Function>
+	void for_each_column(Function a_function) {
+		for_each_column(a_function, indices());
+	}
+
+	template<class Function, std::size_t... I>
+	void for_each_column(Function& a_function, std::index_sequence<I...>) {
+		int expand[] = {0, (a_function(std::get<I>(m_columns)), 0)...};
+		(void)expand;
+	}
+
+	void truncate(size_type a_size) {
+		for_each_column([a_size](auto& a_column) {
+			if (a_column.size() > a_size) {
+				a_column.erase(a_column.begin() + a_size, a_column.end());
+			}
+		});
+	}
+
+	template<std::size_t... I, class... Args>
+	void append(std::index_sequence<I...>, Args&&... args) {
+		int expand[] = {0, (std::get<I>(m_columns).emplace_back(std::forward<Args>(args)), 0)...};
+		(void)expand;
+	}
+
+	template<class Row, std::size_t... I>
+	void push_back_row(Row&& a_row, std::index_sequence<I...>) {
+		emplace_back(std::get<I>(std::forward<Row>(a_row))...);
+	}
+};
+
+template<class... Fields>
+void swap(SoAVector<Fields...>& a, SoAVector<Fields...>& b) {
+	a.swap(b);
+}
+
+// Compares rows, proxies or tuples, by field I
+template<std::size_t I, class Compare = std::less<>>
+struct field_less {
+	Compare comp;
+
+	field_less(Compare a_comp = Compare()) : comp(a_comp) {
+	}
+
+	template<class A, class B>
+	bool operator()(const A& a, const B& b) const {
+		return comp(field(a), field(b));
+	}
+
+private:
+	template<class... Fields>
+	static const typename std::tuple_element<I, std::tuple<Fields...>>::type& field(const std::tuple<Fields...>& a_row) {
+		return std::get<I>(a_row);
+	}
+
+	template<class Row>
+	static decltype(auto) field(const Row& a_row) {
+		return a_row.template get<I>();
+	}
+};
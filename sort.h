@@ -1,8 +1,18 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <type_traits>
 #include <iterator>
 #include <algorithm>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+#include "simd_sort.h"
 
 namespace custom {
 	template<class I, typename = void>
@@ -12,32 +22,1132 @@ namespace custom {
 
 	template<class I>
 	struct is_random_access_iterator<I, typename std::enable_if< std::is_same<
-		typename std::iterator_traits<I>::iterator_category, 
+		typename std::iterator_traits<I>::iterator_category,
 		std::random_access_iterator_tag
 	>::value >::type> {
 		static const bool value = true;
 	};
 
+	namespace detail {
+		// Partitions not longer than this are finished by insertion sort
+		const std::ptrdiff_t insertion_threshold = 16;
+		// Ranges longer than this take the pivot as a median of three medians
+		const std::ptrdiff_t ninther_threshold = 128;
+
+		template<class iterator, class Compare>
+		void insertion_sort(iterator first, iterator last, Compare comp) {
+			if (first == last) {
+				return;
+			}
+			for(iterator i = first + 1; i != last; ++i) {
+				typename std::iterator_traits<iterator>::value_type value = std::move(*i);
+				iterator j = i;
+				if (comp(value, *first)) {
+					std::move_backward(first, i, i + 1);
+					j = first;
+				} else {
+					// *first is not greater than value, so the scan stops there
+					for(; comp(value, *(j - 1)); --j) {
+						*j = std::move(*(j - 1));
+					}
+				}
+				*j = std::move(value);
+			}
+		}
+
+		// Insertion sort for ranges that have a sentinel not greater
+		// than any of their elements right before first
+		template<class iterator, class Compare>
+		void unguarded_insertion_sort(iterator first, iterator last, Compare comp) {
+			for(iterator i = first; i != last; ++i) {
+				typename std::iterator_traits<iterator>::value_type value = std::move(*i);
+				iterator j = i;
+				for(; comp(value, *(j - 1)); --j) {
+					*j = std::move(*(j - 1));
+				}
+				*j = std::move(value);
+			}
+		}
+
+		// Insertion sort that gives up after moving a_limit elements.
+		// Returns true if the range got sorted.
+		template<class iterator, class Compare>
+		bool partial_insertion_sort(iterator first, iterator last, std::ptrdiff_t a_limit, Compare comp) {
+			if (first == last) {
+				return true;
+			}
+			std::ptrdiff_t moved = 0;
+			for(iterator i = first + 1; i != last; ++i) {
+				if (!comp(*i, *(i - 1))) {
+					continue;
+				}
+				typename std::iterator_traits<iterator>::value_type value = std::move(*i);
+				iterator j = i;
+				do {
+					*j = std::move(*(j - 1));
+					--j;
+				} while (j != first && comp(value, *(j - 1)));
+				*j = std::move(value);
+				moved += i - j;
+				if (moved > a_limit) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		template<class iterator, class Compare>
+		void sift_down(iterator first, std::ptrdiff_t index, std::ptrdiff_t size, Compare comp) {
+			typename std::iterator_traits<iterator>::value_type value = std::move(*(first + index));
+			for(std::ptrdiff_t child = 2*index + 1; child < size; child = 2*index + 1) {
+				if (child + 1 < size && comp(*(first + child), *(first + child + 1))) {
+					++child;
+				}
+				if (!comp(value, *(first + child))) {
+					break;
+				}
+				*(first + index) = std::move(*(first + child));
+				index = child;
+			}
+			*(first + index) = std::move(value);
+		}
+
+		template<class iterator, class Compare>
+		void heap_sort(iterator first, iterator last, Compare comp) {
+			std::ptrdiff_t size = last - first;
+			for(std::ptrdiff_t i = size/2 - 1; i >= 0; --i) {
+				detail::sift_down(first, i, size, comp);
+			}
+			for(std::ptrdiff_t i = size - 1; i > 0; --i) {
+				std::iter_swap(first, first + i);
+				detail::sift_down(first, 0, i, comp);
+			}
+		}
+
+		// Orders *a, *b, *c so that *b is the median
+		template<class iterator, class Compare>
+		void sort3(iterator a, iterator b, iterator c, Compare comp) {
+			if (comp(*b, *a)) std::iter_swap(a, b);
+			if (comp(*c, *b)) std::iter_swap(b, c);
+			if (comp(*b, *a)) std::iter_swap(a, b);
+		}
+
+		// Puts the pivot into *first and leaves an element not less than
+		// the pivot further right, so hoare_partition() can scan without bounds
+		// checks: the left scan stops there, the right one at *first.
+		template<class iterator, class Compare>
+		void choose_pivot(iterator first, iterator last, Compare comp) {
+			std::ptrdiff_t size = last - first;
+			iterator middle = first + size/2;
+			if (size > ninther_threshold) {
+				// Samples sit next to each other, so a sorted
+				// or reversed input stays almost intact
+				detail::sort3(first, middle, last - 1, comp);
+				detail::sort3(first + 1, middle - 1, last - 2, comp);
+				detail::sort3(first + 2, middle + 1, last - 3, comp);
+				detail::sort3(middle - 1, middle, middle + 1, comp);
+			} else {
+				detail::sort3(first + 1, middle, last - 1, comp);
+			}
+			std::iter_swap(first, middle);
+		}
+
+		// Hoare partition around *first. Elements equal to the pivot
+		// stop both scans, so runs of equal keys split evenly.
+		// a_swapped tells whether the range was not partitioned already.
+		template<class iterator, class Compare>
+		iterator hoare_partition(iterator first, iterator last, bool& a_swapped, Compare comp) {
+			iterator left = first + 1;
+			iterator right = last;
+			a_swapped = false;
+			while (true) {
+				while (comp(*left, *first)) ++left;
+				--right;
+				while (comp(*first, *right)) --right;
+				if (!(left < right)) {
+					return left;
+				}
+				std::iter_swap(left, right);
+				a_swapped = true;
+				++left;
+			}
+		}
+
+		// Elements per block of block_partition(), offsets fit in a byte
+		const std::ptrdiff_t partition_block = 64;
+
+		// Comparisons cheap enough to be evaluated into a flag
+		template<class T, class Compare>
+		struct is_branchless {
+			static const bool value = std::is_arithmetic<T>::value && (
+				std::is_same<Compare, std::less<T>>::value || std::is_same<Compare, std::less<>>::value ||
+				std::is_same<Compare, std::greater<T>>::value || std::is_same<Compare, std::greater<>>::value);
+		};
+
+		// Moves the elements at a_left_base + a_left[i] and a_right_base - a_right[i]
+		// to the other side, as a cycle rather than swaps
+		template<class iterator>
+		void swap_offsets(iterator a_left_base, iterator a_right_base,
+			const unsigned char* a_left, const unsigned char* a_right, std::ptrdiff_t a_count) {
+			if (a_count == 0) {
+				return;
+			}
+			iterator left = a_left_base + a_left[0];
+			iterator right = a_right_base - a_right[0];
+			typename std::iterator_traits<iterator>::value_type value = std::move(*left);
+			*left = std::move(*right);
+			for(std::ptrdiff_t i = 1; i < a_count; ++i) {
+				left = a_left_base + a_left[i];
+				*right = std::move(*left);
+				right = a_right_base - a_right[i];
+				*left = std::move(*right);
+			}
+			*right = std::move(value);
+		}
+
+		// hoare_partition() without branches on the comparisons: a block
+		// of each side is scanned first, recording the offsets of misplaced
+		// elements, then as many of them as match up are swapped. Elements
+		// less than the pivot go left, the ones equal to it right.
+		template<class iterator, class Compare>
+		iterator block_partition(iterator first, iterator last, bool& a_swapped, Compare comp) {
+			typename std::iterator_traits<iterator>::value_type pivot = *first;
+			iterator left = first;
+			iterator right = last;
+			while (comp(*++left, pivot));
+			if (left - 1 == first) {
+				while (left < right && !comp(*--right, pivot));
+			} else {
+				// The elements skipped on the left stop this scan
+				while (!comp(*--right, pivot));
+			}
+			a_swapped = left < right;
+			if (!a_swapped) {
+				return left;
+			}
+			std::iter_swap(left, right);
+			++left;
+
+			unsigned char left_offsets[partition_block];
+			unsigned char right_offsets[partition_block];
+			iterator left_base = left;
+			iterator right_base = right;
+			std::ptrdiff_t left_count = 0, right_count = 0, left_start = 0, right_start = 0;
+			while (left < right) {
+				// The last blocks share the elements that are left
+				std::ptrdiff_t unknown = right - left;
+				std::ptrdiff_t left_size = left_count == 0 ? (right_count == 0 ? unknown/2 : unknown) : 0;
+				std::ptrdiff_t right_size = right_count == 0 ? unknown - left_size : 0;
+				left_size = std::min(left_size, partition_block);
+				right_size = std::min(right_size, partition_block);
+				for(std::ptrdiff_t i = 0; i < left_size; ++i) {
+					left_offsets[left_count] = static_cast<unsigned char>(i);
+					left_count += !comp(*left, pivot);
+					++left;
+				}
+				for(std::ptrdiff_t i = 0; i < right_size; ++i) {
+					right_offsets[right_count] = static_cast<unsigned char>(i + 1);
+					right_count += comp(*--right, pivot);
+				}
+				std::ptrdiff_t count = std::min(left_count, right_count);
+				detail::swap_offsets(left_base, right_base, left_offsets + left_start, right_offsets + right_start, count);
+				left_count -= count;
+				right_count -= count;
+				left_start += count;
+				right_start += count;
+				if (left_count == 0) {
+					left_start = 0;
+					left_base = left;
+				}
+				if (right_count == 0) {
+					right_start = 0;
+					right_base = right;
+				}
+			}
+			// Misplaced elements of one side are left over, they go
+			// to the far end of that side from the last to the first
+			if (left_count > 0) {
+				while (left_count > 0) {
+					--left_count;
+					std::iter_swap(left_base + left_offsets[left_start + left_count], --right);
+				}
+				left = right;
+			}
+			while (right_count > 0) {
+				--right_count;
+				std::iter_swap(right_base - right_offsets[right_start + right_count], left);
+				++left;
+			}
+			return left;
+		}
+
+		template<class iterator, class Compare>
+		typename std::enable_if<!is_branchless<typename std::iterator_traits<iterator>::value_type, Compare>::value, iterator>::type
+		partition_around(iterator first, iterator last, bool& a_swapped, Compare comp) {
+			return detail::hoare_partition(first, last, a_swapped, comp);
+		}
+
+		template<class iterator, class Compare>
+		typename std::enable_if<is_branchless<typename std::iterator_traits<iterator>::value_type, Compare>::value, iterator>::type
+		partition_around(iterator first, iterator last, bool& a_swapped, Compare comp) {
+			return detail::block_partition(first, last, a_swapped, comp);
+		}
+
+		// Partition around *first for ranges where every element is not
+		// less than the pivot: elements equal to it go left and need no
+		// further sorting. Returns where the pivot ended up.
+		template<class iterator, class Compare>
+		iterator partition_equal(iterator first, iterator last, Compare comp) {
+			iterator left = first;
+			iterator right = last;
+			while (comp(*first, *--right));
+			if (right + 1 == last) {
+				while (left < right && !comp(*first, *++left));
+			} else {
+				while (!comp(*first, *++left));
+			}
+			while (left < right) {
+				std::iter_swap(left, right);
+				while (comp(*first, *--right));
+				while (!comp(*first, *++left));
+			}
+			std::iter_swap(first, right);
+			return right;
+		}
+
+		// Swaps elements a quarter of the way in from both ends with
+		// elements near the ends, keeps the range a permutation of itself
+		template<class iterator>
+		void break_pattern(iterator first, iterator last) {
+			std::ptrdiff_t size = last - first;
+			if (size < insertion_threshold) {
+				return;
+			}
+			std::iter_swap(first, first + size/4);
+			std::iter_swap(last - 1, last - size/4);
+			if (size > ninther_threshold) {
+				std::iter_swap(first + 1, first + size/4 + 1);
+				std::iter_swap(first + 2, first + size/4 + 2);
+				std::iter_swap(last - 2, last - size/4 - 1);
+				std::iter_swap(last - 3, last - size/4 - 2);
+			}
+		}
+
+		// Partitions of up to insertion_threshold elements are insertion
+		// sorted right away, while they are still in cache.
+		// If a_leftmost is false, *(first - 1) is a previous pivot
+		// not greater than any element of the range, so the insertion
+		// sort needs no bounds check.
+		template<class iterator, class Compare>
+		void introsort(iterator first, iterator last, int depth, bool a_leftmost, Compare comp) {
+			while (last - first > insertion_threshold) {
+				if (depth == 0) {
+					detail::heap_sort(first, last, comp);
+					return;
+				}
+				--depth;
+				detail::choose_pivot(first, last, comp);
+				// The pivot equals the previous one: skip the whole run of equal keys
+				if (!a_leftmost && !comp(*(first - 1), *first)) {
+					first = detail::partition_equal(first, last, comp) + 1;
+					continue;
+				}
+				bool swapped;
+				iterator cut = detail::partition_around(first, last, swapped, comp);
+				// The pivot takes its final place between the two sides
+				std::iter_swap(first, cut - 1);
+				// A lopsided split means the samples hit a pattern in the
+				// input, shuffle a few elements so the next pivots miss it
+				std::ptrdiff_t smallest = (last - first)/8;
+				bool lopsided = cut - 1 - first < smallest || last - cut < smallest;
+				if (lopsided) {
+					detail::break_pattern(first, cut - 1);
+					detail::break_pattern(cut, last);
+				}
+				// Nothing moved: the input is likely sorted already, try to
+				// finish both sides cheaply before partitioning further
+				if (!lopsided && !swapped &&
+					detail::partial_insertion_sort(first, cut - 1, 8, comp) &&
+					detail::partial_insertion_sort(cut, last, 8, comp)) {
+					return;
+				}
+				// Recursing only into the smaller side bounds the stack by log(n)
+				if (cut - first < last - cut) {
+					detail::introsort(first, cut - 1, depth, a_leftmost, comp);
+					first = cut;
+					a_leftmost = false;
+				} else {
+					detail::introsort(cut, last, depth, false, comp);
+					last = cut - 1;
+				}
+			}
+			if (a_leftmost) {
+				detail::insertion_sort(first, last, comp);
+			} else {
+				detail::unguarded_insertion_sort(first, last, comp);
+			}
+		}
+
+		inline int depth_limit(std::ptrdiff_t a_size) {
+			int depth = 0;
+			for(; a_size > 1; a_size >>= 1) {
+				++depth;
+			}
+			return 2*depth;
+		}
+	}
+
+	// Introsort: quicksort with median-of-three (ninther on big ranges)
+	// pivots, insertion sort for short partitions and heapsort once the
+	// recursion gets deeper than 2*log2(n). O(n log n) in the worst case.
+	// std::less and std::greater on arithmetic types partition without
+	// branches on the comparisons.
+	template<class iterator, class Compare>
+	typename std::enable_if<is_random_access_iterator<iterator>::value, void>::type
+	sort(iterator first, iterator last, Compare comp) {
+		if (last - first < 2) {
+			return;
+		}
+		detail::introsort(first, last, detail::depth_limit(last - first), true, comp);
+	}
+
+	namespace detail {
+		template<class T>
+		struct is_simd_sortable {
+			static const bool value =
+				std::is_same<T, std::int32_t>::value || std::is_same<T, std::int64_t>::value ||
+				std::is_same<T, float>::value || std::is_same<T, double>::value;
+		};
+
+		template<class T>
+		bool has_nan(const T* first, const T* last) {
+			if (!std::is_floating_point<T>::value) {
+				return false;
+			}
+			for(; first != last; ++first) {
+				if (*first != *first) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// introsort() on the vector kernels: partitions are split by
+		// a_kernels.partition() and blocks are sorted by a network
+		template<class T>
+		void simd_introsort(T* first, T* last, int depth, bool a_leftmost, const simd::kernels<T>& a_kernels) {
+			std::less<T> comp;
+			while (last - first > a_kernels.block) {
+				if (depth == 0) {
+					detail::heap_sort(first, last, comp);
+					return;
+				}
+				--depth;
+				detail::choose_pivot(first, last, comp);
+				if (!a_leftmost && !comp(*(first - 1), *first)) {
+					first = a_kernels.partition(first + 1, last, *first, true);
+					continue;
+				}
+				T* cut = a_kernels.partition(first + 1, last, *first, false);
+				std::iter_swap(first, cut - 1);
+				std::ptrdiff_t smallest = (last - first)/8;
+				if (cut - 1 - first < smallest || last - cut < smallest) {
+					detail::break_pattern(first, cut - 1);
+					detail::break_pattern(cut, last);
+				}
+				if (cut - first < last - cut) {
+					detail::simd_introsort(first, cut - 1, depth, a_leftmost, a_kernels);
+					first = cut;
+					a_leftmost = false;
+				} else {
+					detail::simd_introsort(cut, last, depth, false, a_kernels);
+					last = cut - 1;
+				}
+			}
+			a_kernels.sort_block(first, last);
+		}
+
+		template<class iterator>
+		bool simd_sort(iterator, iterator) {
+			return false;
+		}
+
+		// Arrays without NaNs go to the widest vector kernels the CPU has
+		template<class T>
+		typename std::enable_if<is_simd_sortable<T>::value, bool>::type
+		simd_sort(T* first, T* last) {
+			const simd::kernels<T>* kernels = simd::find_kernels(first);
+			if (kernels == nullptr || detail::has_nan(first, last)) {
+				return false;
+			}
+			// Partitions do not notice sorted input, check it up front
+			if (std::is_sorted(first, last)) {
+				return true;
+			}
+			if (std::is_sorted(first, last, std::greater<T>())) {
+				std::reverse(first, last);
+				return true;
+			}
+			detail::simd_introsort(first, last, detail::depth_limit(last - first), true, *kernels);
+			return true;
+		}
+	}
+
+	// Arrays of int32_t, int64_t, float and double are sorted with AVX2
+	// or AVX-512 kernels when the CPU supports them. Vector iterators are
+	// pointers, so Vectors of these types take that path too.
 	template<class iterator>
-	typename std::enable_if<is_random_access_iterator<iterator>::value, void>::type 
+	typename std::enable_if<is_random_access_iterator<iterator>::value, void>::type
 	sort(iterator first, iterator last) {
-		--last;
-		if (first >= last) {
-			return;
-		}
-		iterator i = first;
-		iterator j = last;
-		iterator x = first + rand()%(last - first);
-		do {
-			while (*i < *x) ++i;		
-			while (*j > *x) --j;		
-			if (i <= j) {
-				std::swap(*i, *j);
-				++i;
-				--j;
-			}
-		} while (i < j);
-		custom::sort(first, j + 1);
-		custom::sort(i, last + 1);
+		if (last - first < 2 || detail::simd_sort(first, last)) {
+			return;
+		}
+		custom::sort(first, last, std::less<>());
+	}
+
+	namespace detail {
+		// Runs shorter than this are extended by binary insertion sort
+		const std::ptrdiff_t min_run = 32;
+		// Enough for runs obeying the merge invariants on any addressable range
+		const int max_runs = 85;
+
+		// Uninitialized memory for up to capacity() elements. Asks for
+		// a_wanted elements and settles for less if the allocator throws
+		// std::bad_alloc, down to none at all.
+		template<class T, class Allocator>
+		class scratch_buffer {
+		public:
+			typedef typename std::allocator_traits<Allocator>::template rebind_alloc<T> allocator_type;
+			typedef std::allocator_traits<allocator_type> allocator_traits;
+
+			scratch_buffer(const Allocator& a_allocator, std::ptrdiff_t a_wanted)
+				: m_allocator(a_allocator), m_data(nullptr), m_capacity(0) {
+				for(; a_wanted > 0 && m_data == nullptr; a_wanted /= 2) {
+					try {
+						m_data = allocator_traits::allocate(m_allocator, a_wanted);
+						m_capacity = a_wanted;
+					} catch (const std::bad_alloc&) {
+					}
+				}
+			}
+
+			scratch_buffer(const scratch_buffer&) = delete;
+			scratch_buffer& operator=(const scratch_buffer&) = delete;
+
+			~scratch_buffer() {
+				if (m_data != nullptr) {
+					allocator_traits::deallocate(m_allocator, m_data, m_capacity);
+				}
+			}
+
+			T* data() const {
+				return m_data;
+			}
+
+			std::ptrdiff_t capacity() const {
+				return m_capacity;
+			}
+
+			template<class iterator>
+			void construct(iterator first, iterator last) {
+				for(T* p = m_data; first != last; ++first, ++p) {
+					allocator_traits::construct(m_allocator, p, std::move(*first));
+				}
+			}
+
+			void destroy(std::ptrdiff_t a_count) {
+				for(T* p = m_data; p != m_data + a_count; ++p) {
+					allocator_traits::destroy(m_allocator, p);
+				}
+			}
+
+		private:
+			allocator_type m_allocator;
+			T* m_data;
+			std::ptrdiff_t m_capacity;
+		};
+
+		// Inserts [middle, last) into the sorted [first, middle),
+		// equal elements stay in their order
+		template<class iterator, class Compare>
+		void binary_insertion_sort(iterator first, iterator middle, iterator last, Compare comp) {
+			for(; middle != last; ++middle) {
+				iterator position = std::upper_bound(first, middle, *middle, comp);
+				if (position != middle) {
+					typename std::iterator_traits<iterator>::value_type value = std::move(*middle);
+					std::move_backward(position, middle, middle + 1);
+					*position = std::move(value);
+				}
+			}
+		}
+
+		// Sorts [middle, last) into the sorted [first, middle). Cheap
+		// comparisons make a linear scan faster than binary search.
+		template<class iterator, class Compare>
+		typename std::enable_if<!is_branchless<typename std::iterator_traits<iterator>::value_type, Compare>::value, void>::type
+		extend_run(iterator first, iterator middle, iterator last, Compare comp) {
+			detail::binary_insertion_sort(first, middle, last, comp);
+		}
+
+		template<class iterator, class Compare>
+		typename std::enable_if<is_branchless<typename std::iterator_traits<iterator>::value_type, Compare>::value, void>::type
+		extend_run(iterator first, iterator, iterator last, Compare comp) {
+			detail::insertion_sort(first, last, comp);
+		}
+
+		// Length of the run at first. Strictly descending runs are reversed,
+		// so equal elements never change their order.
+		template<class iterator, class Compare>
+		std::ptrdiff_t count_run(iterator first, iterator last, Compare comp) {
+			iterator it = first + 1;
+			if (it == last) {
+				return 1;
+			}
+			if (comp(*it, *first)) {
+				while (++it != last && comp(*it, *(it - 1)));
+				std::reverse(first, it);
+			} else {
+				while (++it != last && !comp(*it, *(it - 1)));
+			}
+			return it - first;
+		}
+
+		// Between min_run/2 and min_run, so that n/result is a power of two or a bit less
+		inline std::ptrdiff_t compute_min_run(std::ptrdiff_t a_size) {
+			std::ptrdiff_t odd = 0;
+			while (a_size >= min_run) {
+				odd |= a_size & 1;
+				a_size >>= 1;
+			}
+			return a_size + odd;
+		}
+
+		// One run winning this many times in a row switches the merge to galloping
+		const int gallop_threshold = 7;
+
+		// End of the prefix of [first, last) where a_predicate holds, found
+		// by exponential search: O(log k) comparisons for a prefix of k elements
+		template<class iterator, class Predicate>
+		iterator gallop(iterator first, iterator last, Predicate a_predicate) {
+			std::ptrdiff_t size = last - first;
+			std::ptrdiff_t step = 1;
+			while (step < size && a_predicate(*(first + step))) {
+				step *= 2;
+			}
+			return std::partition_point(first + step/2, first + std::min(step, size), a_predicate);
+		}
+
+		// Merges one element at a time until a run is used up or wins
+		// gallop_threshold times in a row
+		template<class T, class iterator, class Compare>
+		void merge_forward(std::false_type, T*& a_left, T* a_left_end, iterator& a_right, iterator a_right_end,
+			iterator& a_dest, int& a_left_wins, int& a_right_wins, Compare comp) {
+			while (a_left != a_left_end && a_right != a_right_end && a_left_wins < gallop_threshold && a_right_wins < gallop_threshold) {
+				if (comp(*a_right, *a_left)) {
+					*a_dest++ = std::move(*a_right++);
+					++a_right_wins;
+					a_left_wins = 0;
+				} else {
+					*a_dest++ = std::move(*a_left++);
+					++a_left_wins;
+					a_right_wins = 0;
+				}
+			}
+		}
+
+		// Cheap comparisons select the next value instead of branching
+		// on what is a coin toss for random input
+		template<class T, class iterator, class Compare>
+		void merge_forward(std::true_type, T*& a_left, T* a_left_end, iterator& a_right, iterator a_right_end,
+			iterator& a_dest, int& a_left_wins, int& a_right_wins, Compare comp) {
+			while (a_left != a_left_end && a_right != a_right_end && a_left_wins < gallop_threshold && a_right_wins < gallop_threshold) {
+				T left = *a_left;
+				T right = *a_right;
+				bool right_first = comp(right, left);
+				*a_dest++ = right_first ? right : left;
+				a_right += right_first;
+				a_left += !right_first;
+				a_right_wins = (a_right_wins + 1)*right_first;
+				a_left_wins = (a_left_wins + 1)*!right_first;
+			}
+		}
+
+		// Same from the back: a_left_end and a_right_end move down
+		// to a_left and a_right, the left run wins ties
+		template<class T, class iterator, class Compare>
+		void merge_backward(std::false_type, iterator& a_left_end, iterator a_left, T*& a_right_end, T* a_right,
+			iterator& a_dest, int& a_left_wins, int& a_right_wins, Compare comp) {
+			while (a_right != a_right_end && a_left != a_left_end && a_left_wins < gallop_threshold && a_right_wins < gallop_threshold) {
+				if (comp(*(a_right_end - 1), *(a_left_end - 1))) {
+					*--a_dest = std::move(*--a_left_end);
+					++a_left_wins;
+					a_right_wins = 0;
+				} else {
+					*--a_dest = std::move(*--a_right_end);
+					++a_right_wins;
+					a_left_wins = 0;
+				}
+			}
+		}
+
+		template<class T, class iterator, class Compare>
+		void merge_backward(std::true_type, iterator& a_left_end, iterator a_left, T*& a_right_end, T* a_right,
+			iterator& a_dest, int& a_left_wins, int& a_right_wins, Compare comp) {
+			while (a_right != a_right_end && a_left != a_left_end && a_left_wins < gallop_threshold && a_right_wins < gallop_threshold) {
+				T left = *(a_left_end - 1);
+				T right = *(a_right_end - 1);
+				bool left_first = comp(right, left);
+				*--a_dest = left_first ? left : right;
+				a_left_end -= left_first;
+				a_right_end -= !left_first;
+				a_left_wins = (a_left_wins + 1)*left_first;
+				a_right_wins = (a_right_wins + 1)*!left_first;
+			}
+		}
+
+		// Merges through the buffer holding the left run. If comp throws,
+		// the buffered elements are moved into the gap, which is exactly their size.
+		template<class iterator, class T, class Allocator, class Compare>
+		void merge_low(iterator first, iterator middle, iterator last, scratch_buffer<T, Allocator>& a_buffer, Compare comp) {
+			std::ptrdiff_t count = middle - first;
+			a_buffer.construct(first, middle);
+			T* left = a_buffer.data();
+			T* left_end = left + count;
+			iterator dest = first;
+			try {
+				while (left != left_end && middle != last) {
+					int left_wins = 0, right_wins = 0;
+					detail::merge_forward(std::integral_constant<bool, is_branchless<T, Compare>::value>(), left, left_end, middle, last, dest, left_wins, right_wins, comp);
+					if (left_wins == gallop_threshold && middle != last) {
+						const T& pivot = *middle;
+						T* end = detail::gallop(left, left_end, [&](const T& a_value) {
+							return !comp(pivot, a_value);
+						});
+						dest = std::move(left, end, dest);
+						left = end;
+					} else if (right_wins == gallop_threshold && left != left_end) {
+						const T& pivot = *left;
+						iterator end = detail::gallop(middle, last, [&](const T& a_value) {
+							return comp(a_value, pivot);
+						});
+						dest = std::move(middle, end, dest);
+						middle = end;
+					}
+				}
+			} catch (...) {
+				std::move(left, left_end, dest);
+				a_buffer.destroy(count);
+				throw;
+			}
+			std::move(left, left_end, dest);
+			a_buffer.destroy(count);
+		}
+
+		// Same from the back, the buffer holds the right run
+		template<class iterator, class T, class Allocator, class Compare>
+		void merge_high(iterator first, iterator middle, iterator last, scratch_buffer<T, Allocator>& a_buffer, Compare comp) {
+			std::ptrdiff_t count = last - middle;
+			a_buffer.construct(middle, last);
+			T* right = a_buffer.data();
+			T* right_end = right + count;
+			iterator dest = last;
+			try {
+				while (right != right_end && middle != first) {
+					int left_wins = 0, right_wins = 0;
+					detail::merge_backward(std::integral_constant<bool, is_branchless<T, Compare>::value>(), middle, first, right_end, right, dest, left_wins, right_wins, comp);
+					if (left_wins == gallop_threshold && right != right_end) {
+						const T& pivot = *(right_end - 1);
+						iterator begin = detail::gallop(std::reverse_iterator<iterator>(middle), std::reverse_iterator<iterator>(first), [&](const T& a_value) {
+							return comp(pivot, a_value);
+						}).base();
+						dest = std::move_backward(begin, middle, dest);
+						middle = begin;
+					} else if (right_wins == gallop_threshold && middle != first) {
+						const T& pivot = *(middle - 1);
+						T* begin = detail::gallop(std::reverse_iterator<T*>(right_end), std::reverse_iterator<T*>(right), [&](const T& a_value) {
+							return !comp(a_value, pivot);
+						}).base();
+						dest = std::move_backward(begin, right_end, dest);
+						right_end = begin;
+					}
+				}
+			} catch (...) {
+				std::move_backward(right, right_end, dest);
+				a_buffer.destroy(count);
+				throw;
+			}
+			std::move_backward(right, right_end, dest);
+			a_buffer.destroy(count);
+		}
+
+		// Stable merge of two adjacent sorted runs. The parts already in
+		// place are skipped by binary search. Uses the buffer when the
+		// shorter run fits, otherwise splits the merge in two with a rotation.
+		template<class iterator, class T, class Allocator, class Compare>
+		void merge_adaptive(iterator first, iterator middle, iterator last, scratch_buffer<T, Allocator>& a_buffer, Compare comp) {
+			if (first == middle || middle == last) {
+				return;
+			}
+			first = std::upper_bound(first, middle, *middle, comp);
+			if (first == middle) {
+				return;
+			}
+			last = std::lower_bound(middle, last, *(middle - 1), comp);
+			std::ptrdiff_t left = middle - first;
+			std::ptrdiff_t right = last - middle;
+			if (left <= right && left <= a_buffer.capacity()) {
+				detail::merge_low(first, middle, last, a_buffer, comp);
+				return;
+			}
+			if (right <= a_buffer.capacity()) {
+				detail::merge_high(first, middle, last, a_buffer, comp);
+				return;
+			}
+			// The trimming above left *middle less than *first
+			if (left == 1 && right == 1) {
+				std::iter_swap(first, middle);
+				return;
+			}
+			iterator left_cut, right_cut;
+			if (left > right) {
+				left_cut = first + left/2;
+				right_cut = std::lower_bound(middle, last, *left_cut, comp);
+			} else {
+				right_cut = middle + right/2;
+				left_cut = std::upper_bound(first, middle, *right_cut, comp);
+			}
+			iterator new_middle = std::rotate(left_cut, middle, right_cut);
+			detail::merge_adaptive(first, left_cut, new_middle, a_buffer, comp);
+			detail::merge_adaptive(new_middle, right_cut, last, a_buffer, comp);
+		}
+
+		template<class iterator>
+		struct run {
+			iterator first;
+			std::ptrdiff_t length;
+		};
+
+		// Merges runs a_at and a_at + 1 of the stack
+		template<class iterator, class T, class Allocator, class Compare>
+		void merge_at(run<iterator>* a_runs, int& a_count, int a_at, scratch_buffer<T, Allocator>& a_buffer, Compare comp) {
+			run<iterator>& left = a_runs[a_at];
+			const run<iterator>& right = a_runs[a_at + 1];
+			detail::merge_adaptive(left.first, right.first, right.first + right.length, a_buffer, comp);
+			left.length += right.length;
+			if (a_at + 2 < a_count) {
+				a_runs[a_at + 1] = a_runs[a_at + 2];
+			}
+			--a_count;
+		}
+
+		// Keeps every run longer than the two above it together, which
+		// balances the merges and bounds the stack by log(n)
+		template<class iterator, class T, class Allocator, class Compare>
+		void merge_collapse(run<iterator>* a_runs, int& a_count, scratch_buffer<T, Allocator>& a_buffer, Compare comp) {
+			while (a_count > 1) {
+				int n = a_count - 2;
+				if ((n > 0 && a_runs[n - 1].length <= a_runs[n].length + a_runs[n + 1].length) ||
+					(n > 1 && a_runs[n - 2].length <= a_runs[n - 1].length + a_runs[n].length)) {
+					if (a_runs[n - 1].length < a_runs[n + 1].length) {
+						--n;
+					}
+				} else if (a_runs[n].length > a_runs[n + 1].length) {
+					break;
+				}
+				detail::merge_at(a_runs, a_count, n, a_buffer, comp);
+			}
+		}
+
+		template<class iterator, class Compare>
+		void nth_element(iterator first, iterator nth, iterator last, int depth, Compare comp) {
+			bool leftmost = true;
+			while (last - first > insertion_threshold) {
+				if (depth == 0) {
+					detail::heap_sort(first, last, comp);
+					return;
+				}
+				--depth;
+				detail::choose_pivot(first, last, comp);
+				if (!leftmost && !comp(*(first - 1), *first)) {
+					iterator pivot = detail::partition_equal(first, last, comp);
+					if (nth <= pivot) {
+						return;
+					}
+					first = pivot + 1;
+					continue;
+				}
+				bool swapped;
+				iterator cut = detail::partition_around(first, last, swapped, comp);
+				std::iter_swap(first, cut - 1);
+				std::ptrdiff_t smallest = (last - first)/8;
+				if (cut - 1 - first < smallest || last - cut < smallest) {
+					detail::break_pattern(first, cut - 1);
+					detail::break_pattern(cut, last);
+				}
+				if (nth < cut - 1) {
+					last = cut - 1;
+				} else if (cut - 1 < nth) {
+					first = cut;
+					leftmost = false;
+				} else {
+					return;
+				}
+			}
+			detail::insertion_sort(first, last, comp);
+		}
+	}
+
+	// Timsort: natural runs are found and reversed if descending, short ones
+	// are extended to a minimal length by binary insertion sort and adjacent
+	// runs are merged while keeping their lengths balanced. Sorted and nearly
+	// sorted inputs take O(n) comparisons. Merges use up to n/2 elements of
+	// scratch memory from a_allocator. With less memory, or none, they fall
+	// back to rotations and the sort takes O(n log^2 n) instead.
+	template<class iterator, class Compare, class Allocator>
+	typename std::enable_if<is_random_access_iterator<iterator>::value, void>::type
+	stable_sort(iterator first, iterator last, Compare comp, const Allocator& a_allocator) {
+		typedef typename std::iterator_traits<iterator>::value_type value_type;
+		std::ptrdiff_t size = last - first;
+		if (size < 2) {
+			return;
+		}
+		if (size <= detail::min_run) {
+			detail::extend_run(first, first + detail::count_run(first, last, comp), last, comp);
+			return;
+		}
+		detail::scratch_buffer<value_type, Allocator> buffer(a_allocator, size/2);
+		detail::run<iterator> runs[detail::max_runs];
+		int count = 0;
+		std::ptrdiff_t min_run = detail::compute_min_run(size);
+		for(iterator it = first; it != last;) {
+			std::ptrdiff_t length = detail::count_run(it, last, comp);
+			if (length < min_run) {
+				std::ptrdiff_t extended = std::min(min_run, last - it);
+				detail::extend_run(it, it + length, it + extended, comp);
+				length = extended;
+			}
+			runs[count].first = it;
+			runs[count].length = length;
+			++count;
+			detail::merge_collapse(runs, count, buffer, comp);
+			it += length;
+		}
+		while (count > 1) {
+			int n = count - 2;
+			if (n > 0 && runs[n - 1].length < runs[n + 1].length) {
+				--n;
+			}
+			detail::merge_at(runs, count, n, buffer, comp);
+		}
+	}
+
+	template<class iterator, class Compare>
+	typename std::enable_if<is_random_access_iterator<iterator>::value, void>::type
+	stable_sort(iterator first, iterator last, Compare comp) {
+		custom::stable_sort(first, last, comp, std::allocator<typename std::iterator_traits<iterator>::value_type>());
+	}
+
+	template<class iterator>
+	typename std::enable_if<is_random_access_iterator<iterator>::value, void>::type
+	stable_sort(iterator first, iterator last) {
+		custom::stable_sort(first, last, std::less<>());
+	}
+
+	// Introselect: quickselect on the introsort pivots that switches
+	// to heapsort on too deep recursion. Puts into nth the element that
+	// would be there after sorting, nothing after it is less and nothing
+	// before it is greater.
+	template<class iterator, class Compare>
+	typename std::enable_if<is_random_access_iterator<iterator>::value, void>::type
+	nth_element(iterator first, iterator nth, iterator last, Compare comp) {
+		if (nth == last || last - first < 2) {
+			return;
+		}
+		detail::nth_element(first, nth, last, detail::depth_limit(last - first), comp);
+	}
+
+	template<class iterator>
+	typename std::enable_if<is_random_access_iterator<iterator>::value, void>::type
+	nth_element(iterator first, iterator nth, iterator last) {
+		custom::nth_element(first, nth, last, std::less<>());
+	}
+
+	// Sorts the middle - first smallest elements into [first, middle):
+	// a selection around middle, then a sort of the front part.
+	// O(n + k log k) on average, k = middle - first.
+	template<class iterator, class Compare>
+	typename std::enable_if<is_random_access_iterator<iterator>::value, void>::type
+	partial_sort(iterator first, iterator middle, iterator last, Compare comp) {
+		if (first == middle) {
+			return;
+		}
+		custom::nth_element(first, middle - 1, last, comp);
+		custom::sort(first, middle - 1, comp);
+	}
+
+	template<class iterator>
+	typename std::enable_if<is_random_access_iterator<iterator>::value, void>::type
+	partial_sort(iterator first, iterator middle, iterator last) {
+		custom::partial_sort(first, middle, last, std::less<>());
+	}
+
+	namespace detail {
+		// Ranges not longer than this are insertion sorted by radix_sort()
+		const std::ptrdiff_t radix_threshold = 64;
+
+		// Maps keys to unsigned integers with the same order
+		template<class K, bool = std::is_floating_point<K>::value>
+		struct radix_traits {
+			static_assert(std::is_integral<K>::value && !std::is_same<K, bool>::value, "radix_sort needs integral or floating point keys");
+
+			typedef typename std::make_unsigned<K>::type type;
+
+			static type encode(K a_key) {
+				// Flipping the sign bit puts negative numbers first
+				const type sign = std::is_signed<K>::value ? type(type(1) << (std::numeric_limits<type>::digits - 1)) : type(0);
+				return type(a_key) ^ sign;
+			}
+		};
+
+		template<class K>
+		struct radix_traits<K, true> {
+			static_assert(std::numeric_limits<K>::is_iec559 && (sizeof(K) == 4 || sizeof(K) == 8), "radix_sort needs IEEE single or double precision keys");
+
+			typedef typename std::conditional<sizeof(K) == 4, std::uint32_t, std::uint64_t>::type type;
+
+			// Negative numbers have all bits flipped, so the bigger the magnitude
+			// the smaller the code, positive ones only get the sign bit set
+			static type encode(K a_key) {
+				const type sign = type(1) << (std::numeric_limits<type>::digits - 1);
+				type bits;
+				std::memcpy(&bits, &a_key, sizeof(K));
+				return (bits & sign) ? type(~bits) : type(bits | sign);
+			}
+		};
+
+		template<class T>
+		struct identity_key {
+			const T& operator()(const T& a_value) const {
+				return a_value;
+			}
+		};
+
+		// Moves [first, last) to dest ordered by the digit at a_shift.
+		// a_offsets holds the start of every bucket and is advanced.
+		template<class source, class destination, class Encode>
+		void radix_scatter(source first, source last, destination dest, std::size_t* a_offsets,
+			unsigned a_shift, std::size_t a_mask, Encode encode)
+		{
+			for(; first != last; ++first) {
+				std::size_t digit = (encode(*first) >> a_shift) & a_mask;
+				*(dest + a_offsets[digit]++) = std::move(*first);
+			}
+		}
+	}
+
+	// Stable LSD radix sort by a_key(element), which returns an integral or
+	// floating point key. 32 and 64 bit keys use 11 bit digits, narrower
+	// ones 8 bit digits. The histograms of all digits are counted in one
+	// pass and digits that are equal for every key are skipped. The scratch
+	// buffer of last - first elements comes from a_allocator.
+	// Floating point keys order -0.0 before +0.0 and put NaNs at the ends.
+	template<class iterator, class Key, class Allocator>
+	typename std::enable_if<is_random_access_iterator<iterator>::value, void>::type
+	radix_sort(iterator first, iterator last, Key a_key, const Allocator& a_allocator) {
+		typedef typename std::iterator_traits<iterator>::value_type value_type;
+		typedef typename std::decay<decltype(a_key(*first))>::type key_type;
+		typedef detail::radix_traits<key_type> traits;
+		typedef typename traits::type bits_type;
+		typedef typename std::allocator_traits<Allocator>::template rebind_alloc<value_type> allocator_type;
+		typedef std::allocator_traits<allocator_type> allocator_traits;
+
+		auto encode = [&a_key](const value_type& a_value) {
+			return traits::encode(a_key(a_value));
+		};
+		std::ptrdiff_t size = last - first;
+		if (size <= detail::radix_threshold) {
+			detail::insertion_sort(first, last, [&encode](const value_type& a, const value_type& b) {
+				return encode(a) < encode(b);
+			});
+			return;
+		}
+
+		const unsigned digit_bits = sizeof(bits_type) <= 2 ? 8 : 11;
+		const unsigned passes = (std::numeric_limits<bits_type>::digits + digit_bits - 1)/digit_bits;
+		const std::size_t buckets = std::size_t(1) << digit_bits;
+		const std::size_t mask = buckets - 1;
+		std::vector<std::size_t> counts(passes*buckets, 0);
+		for(iterator it = first; it != last; ++it) {
+			bits_type bits = encode(*it);
+			for(unsigned pass = 0; pass < passes; pass++) {
+				++counts[pass*buckets + ((bits >> (pass*digit_bits)) & mask)];
+			}
+		}
+
+		// Counts become bucket offsets, passes with a single bucket are dropped
+		std::vector<unsigned> active;
+		bits_type front = encode(*first);
+		for(unsigned pass = 0; pass < passes; pass++) {
+			std::size_t* count = &counts[pass*buckets];
+			if (count[(front >> (pass*digit_bits)) & mask] == std::size_t(size)) {
+				continue;
+			}
+			active.push_back(pass);
+			std::size_t offset = 0;
+			for(std::size_t digit = 0; digit < buckets; digit++) {
+				std::size_t bucket = count[digit];
+				count[digit] = offset;
+				offset += bucket;
+			}
+		}
+		if (active.empty()) {
+			return;
+		}
+
+		allocator_type allocator(a_allocator);
+		value_type* buffer = allocator_traits::allocate(allocator, size);
+		std::ptrdiff_t constructed = 0;
+		try {
+			for(; constructed < size; constructed++) {
+				allocator_traits::construct(allocator, buffer + constructed, std::move(*(first + constructed)));
+			}
+			// The elements are in the buffer now, every pass swaps the roles
+			bool in_buffer = true;
+			for(unsigned pass : active) {
+				std::size_t* offsets = &counts[pass*buckets];
+				if (in_buffer) {
+					detail::radix_scatter(buffer, buffer + size, first, offsets, pass*digit_bits, mask, encode);
+				} else {
+					detail::radix_scatter(first, last, buffer, offsets, pass*digit_bits, mask, encode);
+				}
+				in_buffer = !in_buffer;
+			}
+			if (in_buffer) {
+				std::move(buffer, buffer + size, first);
+			}
+		} catch (...) {
+			for(std::ptrdiff_t i = 0; i < constructed; i++) {
+				allocator_traits::destroy(allocator, buffer + i);
+			}
+			allocator_traits::deallocate(allocator, buffer, size);
+			throw;
+		}
+		for(std::ptrdiff_t i = 0; i < size; i++) {
+			allocator_traits::destroy(allocator, buffer + i);
+		}
+		allocator_traits::deallocate(allocator, buffer, size);
+	}
+
+	template<class iterator, class Key>
+	typename std::enable_if<is_random_access_iterator<iterator>::value, void>::type
+	radix_sort(iterator first, iterator last, Key a_key) {
+		custom::radix_sort(first, last, a_key, std::allocator<typename std::iterator_traits<iterator>::value_type>());
+	}
+
+	template<class iterator>
+	typename std::enable_if<is_random_access_iterator<iterator>::value, void>::type
+	radix_sort(iterator first, iterator last) {
+		typedef typename std::iterator_traits<iterator>::value_type value_type;
+		custom::radix_sort(first, last, detail::identity_key<value_type>());
 	}
 }
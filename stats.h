@@ -0,0 +1,206 @@
+#pragma once
+
+#include <cstddef>
+#include <atomic>
+
+// Stats policies let a Vector report what its storage costs. A policy is
+// a base of Vector and provides the hooks
+//     void on_allocate(std::size_t a_bytes)
+//     void on_deallocate(std::size_t a_bytes)
+//     void on_extend(std::size_t a_bytes)      buffer grew in place
+//     void on_shrink(std::size_t a_bytes)      buffer shrank in place
+//     void on_reclaim(std::size_t a_bytes)     capacity given back by a trim
+//     void on_transfer(Policy& a_from, std::size_t a_bytes)   buffer changed owner
+//     void on_reallocate()                     elements moved to a new buffer
+//     void on_move(std::size_t a_count)
+//     void on_copy(std::size_t a_count)
+// plus Counters counters() const.
+namespace stats {
+	struct Counters {
+		std::size_t allocations;
+		std::size_t deallocations;
+		// Bytes allocated and not yet freed, and their maximum
+		std::size_t bytes;
+		std::size_t peak_bytes;
+		std::size_t reallocations;
+		// Elements moved or copied by relocation and shifting
+		std::size_t moves;
+		std::size_t copies;
+		// Bytes of capacity given back by trims
+		std::size_t reclaimed;
+	};
+
+	namespace detail {
+		struct GlobalCounters {
+			std::atomic<std::size_t> allocations;
+			std::atomic<std::size_t> deallocations;
+			std::atomic<std::size_t> bytes;
+			std::atomic<std::size_t> peak_bytes;
+			std::atomic<std::size_t> reallocations;
+			std::atomic<std::size_t> moves;
+			std::atomic<std::size_t> copies;
+			std::atomic<std::size_t> reclaimed;
+		};
+
+		// Zero-initialized as every object with static storage
+		inline GlobalCounters& global_counters() {
+			static GlobalCounters counters;
+			return counters;
+		}
+
+		inline void raise_peak(std::atomic<std::size_t>& a_peak, std::size_t a_bytes) {
+			std::size_t peak = a_peak.load(std::memory_order_relaxed);
+			while (a_bytes > peak && !a_peak.compare_exchange_weak(peak, a_bytes, std::memory_order_relaxed)) {
+			}
+		}
+	}
+
+	// Sum over all Counting instances of the process
+	inline Counters global() {
+		const detail::GlobalCounters& counters = detail::global_counters();
+		Counters result = {
+			counters.allocations.load(std::memory_order_relaxed),
+			counters.deallocations.load(std::memory_order_relaxed),
+			counters.bytes.load(std::memory_order_relaxed),
+			counters.peak_bytes.load(std::memory_order_relaxed),
+			counters.reallocations.load(std::memory_order_relaxed),
+			counters.moves.load(std::memory_order_relaxed),
+			counters.copies.load(std::memory_order_relaxed),
+			counters.reclaimed.load(std::memory_order_relaxed)
+		};
+		return result;
+	}
+
+	// Bytes still allocated are kept, the peak restarts from them
+	inline void reset_global() {
+		detail::GlobalCounters& counters = detail::global_counters();
+		counters.allocations = 0;
+		counters.deallocations = 0;
+		counters.peak_bytes = counters.bytes.load();
+		counters.reallocations = 0;
+		counters.moves = 0;
+		counters.copies = 0;
+		counters.reclaimed = 0;
+	}
+
+	// Counts nothing. It is empty, so it adds nothing to the size of Vector,
+	// and every hook compiles away.
+	struct None {
+		void on_allocate(std::size_t) {
+		}
+
+		void on_deallocate(std::size_t) {
+		}
+
+		void on_extend(std::size_t) {
+		}
+
+		void on_shrink(std::size_t) {
+		}
+
+		void on_reclaim(std::size_t) {
+		}
+
+		void on_transfer(None&, std::size_t) {
+		}
+
+		void on_reallocate() {
+		}
+
+		void on_move(std::size_t) {
+		}
+
+		void on_copy(std::size_t) {
+		}
+
+		Counters counters() const {
+			return Counters();
+		}
+	};
+
+	// Counts per instance and into global()
+	class Counting {
+	public:
+		Counting() : m_counters() {
+		}
+
+		// A copy of a container starts with its own counters
+		Counting(const Counting&) : m_counters() {
+		}
+
+		Counting& operator=(const Counting&) {
+			return *this;
+		}
+
+		void on_allocate(std::size_t a_bytes) {
+			++m_counters.allocations;
+			add_bytes(a_bytes);
+			++detail::global_counters().allocations;
+			detail::raise_peak(detail::global_counters().peak_bytes, detail::global_counters().bytes += a_bytes);
+		}
+
+		void on_deallocate(std::size_t a_bytes) {
+			++m_counters.deallocations;
+			m_counters.bytes -= a_bytes;
+			++detail::global_counters().deallocations;
+			detail::global_counters().bytes -= a_bytes;
+		}
+
+		void on_extend(std::size_t a_bytes) {
+			add_bytes(a_bytes);
+			detail::raise_peak(detail::global_counters().peak_bytes, detail::global_counters().bytes += a_bytes);
+		}
+
+		void on_shrink(std::size_t a_bytes) {
+			m_counters.bytes -= a_bytes;
+			detail::global_counters().bytes -= a_bytes;
+		}
+
+		void on_reclaim(std::size_t a_bytes) {
+			m_counters.reclaimed += a_bytes;
+			detail::global_counters().reclaimed += a_bytes;
+		}
+
+		// The process total does not change
+		void on_transfer(Counting& a_from, std::size_t a_bytes) {
+			a_from.m_counters.bytes -= a_bytes;
+			add_bytes(a_bytes);
+		}
+
+		void on_reallocate() {
+			++m_counters.reallocations;
+			++detail::global_counters().reallocations;
+		}
+
+		void on_move(std::size_t a_count) {
+			m_counters.moves += a_count;
+			detail::global_counters().moves += a_count;
+		}
+
+		void on_copy(std::size_t a_count) {
+			m_counters.copies += a_count;
+			detail::global_counters().copies += a_count;
+		}
+
+		const Counters& counters() const {
+			return m_counters;
+		}
+
+		// Bytes still allocated are kept, the peak restarts from them
+		void reset() {
+			std::size_t bytes = m_counters.bytes;
+			m_counters = Counters();
+			m_counters.bytes = m_counters.peak_bytes = bytes;
+		}
+
+	private:
+		Counters m_counters;
+
+		void add_bytes(std::size_t a_bytes) {
+			m_counters.bytes += a_bytes;
+			if (m_counters.bytes > m_counters.peak_bytes) {
+				m_counters.peak_bytes = m_counters.bytes;
+			}
+		}
+	};
+}
@@ -1,24 +1,47 @@
 #include <vector>
+#include <array>
+#include <string>
+#include <sstream>
+#include <iterator>
+#include <thread>
+#include <atomic>
+#include <stdexcept>
+#include <cmath>
+#include <limits>
 #include <gtest/gtest.h>
 #include <memory>
 #include <random>
-#include <chrono>
+#include <numeric>
 #include <algorithm>
 #include "vector.h"
+#include "small_vector.h"
+#include "segmented_vector.h"
+#include "mapped_vector.h"
+#include "serialization.h"
+#include "soa_vector.h"
+#include "concurrent_vector.h"
+#include "gap_buffer.h"
 #include "allocator.h"
+#include "pool_allocator.h"
+#include "arena_allocator.h"
 #include "sort.h"
+#include "parallel_sort.h"
+#include "parallel_algorithm.h"
 
 class Class {
 public:
 	static const int default_value = 11;
 	static int count;
+	static int constructions;
 	int value;
-	Class():   value(Class::default_value) {++Class::count;}
-	Class(int a)          : value(a)       {++Class::count;}
-	Class(const Class& b) : value(b.value) {++Class::count;}
+	Class():   value(Class::default_value) {++Class::count; ++Class::constructions;}
+	Class(int a)          : value(a)       {++Class::count; ++Class::constructions;}
+	Class(int a, int b)   : value(a*b)     {++Class::count; ++Class::constructions;}
+	Class(const Class& b) : value(b.value) {++Class::count; ++Class::constructions;}
 	Class(Class&& b) {
 		value = b.value;
 		++Class::count;
+		++Class::constructions;
 		b.value = 0;
 	}
 	int get_value() const {return value;}
@@ -32,6 +55,104 @@ public:
 };
 
 int Class::count = 0;
+int Class::constructions = 0;
+
+// Counts copies and moves separately
+class Tracked {
+public:
+	static int copies;
+	static int moves;
+	int value;
+	Tracked(int a = 0)              : value(a)       {}
+	Tracked(const Tracked& b)       : value(b.value) {++Tracked::copies;}
+	Tracked(Tracked&& b) noexcept   : value(b.value) {++Tracked::moves;}
+	Tracked& operator=(const Tracked& b)     {value = b.value; ++Tracked::copies; return *this;}
+	Tracked& operator=(Tracked&& b) noexcept {value = b.value; ++Tracked::moves; return *this;}
+	~Tracked() {}
+};
+
+int Tracked::copies = 0;
+int Tracked::moves = 0;
+
+// Not trivially copyable, but opted in as trivially relocatable
+class Relocatable : public Tracked {
+public:
+	Relocatable(int a = 0) : Tracked(a) {}
+};
+
+template<>
+struct is_trivially_relocatable<Relocatable> : std::true_type {};
+
+// Move may throw, so relocation copies it
+class ThrowingMove {
+public:
+	int value;
+	ThrowingMove(int a = 0)                   : value(a)       {}
+	ThrowingMove(const ThrowingMove& b)       : value(b.value) {}
+	ThrowingMove(ThrowingMove&& b) noexcept(false) : value(b.value) {}
+	ThrowingMove& operator=(const ThrowingMove& b) {value = b.value; return *this;}
+};
+
+// Copy number fail_at throws, from any thread; the counters are atomic
+class FailingCopy {
+public:
+	static std::atomic<int> live;
+	static std::atomic<int> copies;
+	static int fail_at;
+	FailingCopy() {++live;}
+	FailingCopy(const FailingCopy&) {
+		if (++copies == fail_at) {
+			throw std::runtime_error("copy");
+		}
+		++live;
+	}
+	~FailingCopy() {--live;}
+};
+
+std::atomic<int> FailingCopy::live(0);
+std::atomic<int> FailingCopy::copies(0);
+int FailingCopy::fail_at = 0;
+
+// Stateful allocator; instances with different ids may not free each other's memory
+template<class T>
+class TaggedAllocator : public Allocator<T> {
+public:
+	typedef std::false_type propagate_on_container_move_assignment;
+	typedef std::false_type is_always_equal;
+	template<class U>
+	struct rebind {
+		typedef TaggedAllocator<U> other;
+	};
+	int id;
+	TaggedAllocator(int a_id = 0) : id(a_id) {}
+	template<class U>
+	TaggedAllocator(const TaggedAllocator<U>& b) : id(b.id) {}
+	bool operator==(const TaggedAllocator& b) const {return id == b.id;}
+	bool operator!=(const TaggedAllocator& b) const {return id != b.id;}
+};
+
+// Fails every request for more than limit elements
+template<class T>
+class LimitedAllocator : public Allocator<T> {
+public:
+	template<class U>
+	struct rebind {
+		typedef LimitedAllocator<U> other;
+	};
+	static std::size_t limit;
+	LimitedAllocator() {}
+	template<class U>
+	LimitedAllocator(const LimitedAllocator<U>&) {}
+	T* allocate(std::size_t n) {
+		if (n > limit) {
+			throw std::bad_alloc();
+		}
+		return Allocator<T>::allocate(n);
+	}
+};
+
+template<class T>
+std::size_t LimitedAllocator<T>::limit = 0;
 
 class VectorTest        : public ::testing::Test {};
 class AllocatorTest     : public ::testing::Test {};
@@ -40,6 +161,42 @@ class TestIterators     : public VectorTest {};
 class TestCapacity      : public VectorTest {};
 class TestElementAccess : public VectorTest {};
 class TestModifiers     : public VectorTest {};
+class TestGrowth        : public VectorTest {};
+class TestRelocation    : public VectorTest {};
+class TestStats         : public VectorTest {};
+class TestReclaim       : public VectorTest {};
+class TestPoolAllocator : public AllocatorTest {};
+class TestArenaAllocator: public AllocatorTest {};
+class TestAlignment     : public AllocatorTest {};
+class TestSmallVector   : public VectorTest {};
+class TestSegmentedVector : public VectorTest {};
+class TestSoAVector     : public VectorTest {};
+class TestConcurrentVector : public VectorTest {};
+class TestGapBuffer     : public VectorTest {};
+
+// Every test works on its own temporary file
+class TestFile : public VectorTest {
+protected:
+	std::string path;
+
+	void SetUp() override {
+		char name[] = "/tmp/mapped_vector_XXXXXX";
+		int file = mkstemp(name);
+		ASSERT_GE(file, 0);
+		close(file);
+		path = name;
+	}
+
+	void TearDown() override {
+		unlink(path.c_str());
+	}
+};
+
+class TestMappedVector  : public TestFile {};
+class TestSerialization : public TestFile {};
+class TestSort          : public ::testing::Test {};
+class TestThreadPool    : public ::testing::Test {};
+class TestParallelAlgorithms : public ::testing::Test {};
 
 typedef int TType;
 typedef Vector<TType, Allocator<TType>> Result;
@@ -54,14 +211,14 @@ std::random_device rd;
 
 void compare_vectors(const Expect& expect, const Result& result) {
 	ASSERT_EQ(expect.size(), result.size());
-	for(typename Expect::size_type i; i < expect.size(); i++) {
+	for(typename Expect::size_type i = 0; i < expect.size(); i++) {
 		ASSERT_EQ(expect.at(i), result.at(i));
 	}
 }
 
 void compare_vectors_br(const Expect& expect, const Result& result) {
 	ASSERT_EQ(expect.size(), result.size());
-	for(typename Expect::size_type i; i < expect.size(); i++) {
+	for(typename Expect::size_type i = 0; i < expect.size(); i++) {
 		ASSERT_EQ(expect[i], result[i]);
 	}
 }
@@ -69,7 +226,7 @@ void compare_vectors_br(const Expect& expect, const Result& result) {
 void compare_vectors(const Result& result_1, const Result& result_2) {
 	ASSERT_EQ(result_1.size(), result_2.size());
 	ASSERT_NE(&result_1, &result_2);
-	for(typename Result::size_type i; i < result_1.size(); i++) {
+	for(typename Result::size_type i = 0; i < result_1.size(); i++) {
 		ASSERT_EQ(result_1.at(i), result_2.at(i));
 	}
 }
@@ -77,7 +234,7 @@ void compare_vectors(const Result& result_1, const Result& result_2) {
 void compare_vectors(const Expect& expect_1, const Expect& expect_2) {
 	ASSERT_EQ(expect_1.size(), expect_2.size());
 	ASSERT_NE(&expect_1, &expect_2);
-	for(typename Expect::size_type i; i < expect_1.size(); i++) {
+	for(typename Expect::size_type i = 0; i < expect_1.size(); i++) {
 		ASSERT_EQ(expect_1.at(i), expect_2.at(i));
 	}
 }
@@ -110,7 +267,6 @@ TEST_F(TestIterators, BEGIN_END) {
 	Result result(SIZE, 0);
 	random_fill(result);
 	ASSERT_EQ(result.begin() + SIZE, result.end());
-	ASSERT_EQ(*(result.begin() + SIZE), *result.end());
 	result.clear();
 	ASSERT_EQ(0, Class::count);
 }
@@ -236,6 +392,99 @@ TEST_F(TestBasic, RANGE_CONSTRUCTOR_2) {
 	ASSERT_EQ(0, Class::count);
 }
 
+TEST_F(TestBasic, DEFAULT_CONSTRUCTOR_NO_ALLOCATION) {
+	Result result;
+	ASSERT_EQ(nullptr, result.begin());
+	ASSERT_EQ(0, result.capacity());
+	Result copy(result);
+	ASSERT_EQ(nullptr, copy.begin());
+	result.push_back(1);
+	ASSERT_EQ(1, result.front());
+}
+
+TEST_F(TestBasic, COPY_CONSTRUCTOR) {
+	Result result_1(1000, 0);
+	random_fill(result_1);
+	Result result_2(result_1);
+	ASSERT_NE(result_1.begin(), result_2.begin());
+	ASSERT_TRUE(std::equal(result_1.begin(), result_1.end(), result_2.begin()));
+}
+
+TEST_F(TestBasic, MOVE_CONSTRUCTOR) {
+	Result result_1(1000, 0);
+	random_fill(result_1);
+	Expect expect(result_1.begin(), result_1.end());
+	auto memory = result_1.begin();
+	Result result_2(std::move(result_1));
+	ASSERT_EQ(memory, result_2.begin());
+	ASSERT_EQ(0, result_1.size());
+	compare_vectors(expect, result_2);
+	result_1.push_back(1);
+	ASSERT_EQ(1, result_1.size());
+}
+
+TEST_F(TestBasic, MOVE_ASSIGN) {
+	Class::count = 0;
+	{
+		Vector<Class, Allocator<Class>> result_1(100, Class(1));
+		Vector<Class, Allocator<Class>> result_2(10, Class(2));
+		auto memory = result_1.begin();
+		result_2 = std::move(result_1);
+		ASSERT_EQ(memory, result_2.begin());
+		ASSERT_EQ(100, result_2.size());
+		ASSERT_EQ(100, Class::count);
+	}
+	ASSERT_EQ(0, Class::count);
+}
+
+TEST_F(TestBasic, MOVE_ASSIGN_UNEQUAL_ALLOCATORS) {
+	Vector<TType, TaggedAllocator<TType>> result_1(100, 1, TaggedAllocator<TType>(1));
+	Vector<TType, TaggedAllocator<TType>> result_2(10, 2, TaggedAllocator<TType>(2));
+	auto memory = result_1.begin();
+	result_2 = std::move(result_1);
+	ASSERT_NE(memory, result_2.begin());
+	ASSERT_EQ(100, result_2.size());
+	ASSERT_EQ(1, result_2.back());
+}
+
+TEST_F(TestBasic, SWAP) {
+	Result result_1(1000, 1);
+	Result result_2(10, 2);
+	auto memory_1 = result_1.begin();
+	auto memory_2 = result_2.begin();
+	swap(result_1, result_2);
+	ASSERT_EQ(memory_2, result_1.begin());
+	ASSERT_EQ(memory_1, result_2.begin());
+	ASSERT_EQ(10, result_1.size());
+	ASSERT_EQ(1000, result_2.size());
+	result_1.swap(result_2);
+	ASSERT_EQ(memory_1, result_1.begin());
+}
+
+TEST_F(TestBasic, ASSIGN_REUSES_STORAGE) {
+	Result result_1(100, 1);
+	Result result_2(1000, 2);
+	auto memory = result_2.begin();
+	result_2 = result_1;
+	ASSERT_EQ(memory, result_2.begin());
+	ASSERT_EQ(1000, result_2.capacity());
+	compare_vectors(result_1, result_2);
+}
+
+TEST_F(TestBasic, NESTED) {
+	Vector<Result> result;
+	for(int i = 0; i < 100; i++) {
+		result.push_back(Result(10, i));
+	}
+	auto memory = result[0].begin();
+	result.reserve(1000);
+	ASSERT_EQ(memory, result[0].begin());
+	for(int i = 0; i < 100; i++) {
+		ASSERT_EQ(10, result[i].size());
+		ASSERT_EQ(i, result[i][9]);
+	}
+}
+
 TEST_F(TestBasic, ASSIGN_1) {
 	Class::count = 0;
 	Result result_1(1000, 0);
@@ -352,222 +601,2327 @@ TEST_F(TestCapacity, RESIZE) {
 	ASSERT_EQ(0, Class::count);
 }
 
+TEST_F(TestCapacity, RESIZE_DEFAULT_INIT) {
+	Result result(10, 7);
+	result.reserve(100);
+	// Left as they were: nothing is written into the new elements
+	std::fill(result.data() + 10, result.data() + 100, 3);
+	result.resize_default_init(100);
+	ASSERT_EQ(100, result.size());
+	ASSERT_EQ(7, result[9]);
+	ASSERT_EQ(3, result[99]);
+	result.resize_default_init(5);
+	ASSERT_EQ(5, result.size());
+	ASSERT_EQ(7, result[4]);
+	result.resize_default_init(5000);
+	ASSERT_EQ(5000, result.size());
+	ASSERT_EQ(7, result[4]);
+	Result raw(1000, default_init);
+	ASSERT_EQ(1000, raw.size());
+	Class::count = 0;
+	Vector<Class> objects(3, default_init);
+	objects.resize_default_init(10);
+	ASSERT_EQ(10, Class::count);
+	ASSERT_EQ(int(Class::default_value), objects[9].value);
+	Vector<std::string> strings(2, default_init);
+	ASSERT_EQ("", strings[1]);
+}
+
+TEST_F(TestCapacity, RESIZE_AND_OVERWRITE) {
+	const std::string text = "resize and overwrite";
+	Vector<char> result{'>', ' '};
+	result.resize_and_overwrite(100, [&text](char* a_buffer, std::size_t a_size) {
+		EXPECT_EQ(100, a_size);
+		std::copy(text.begin(), text.end(), a_buffer + 2);
+		return text.size() + 2;
+	});
+	ASSERT_EQ("> " + text, std::string(result.begin(), result.end()));
+	result.resize_and_overwrite(1, [](char* a_buffer, std::size_t) {
+		a_buffer[0] = '<';
+		return 1000;
+	});
+	ASSERT_EQ(1, result.size());
+	ASSERT_EQ('<', result[0]);
+	Class::count = 0;
+	Vector<Class> objects(5);
+	objects.resize_and_overwrite(20, [](Class* a_objects, std::size_t) {
+		a_objects[10] = Class(4);
+		return 11;
+	});
+	ASSERT_EQ(11, objects.size());
+	ASSERT_EQ(11, Class::count);
+	ASSERT_EQ(4, objects.back().value);
+}
 
 
 
 
 
-TEST_F(TestElementAccess, FRONT_1) {
-	Class::count = 0;
-	Expect expect(1000, 0);
-	random_fill(expect);
-	Result result(expect.begin(), expect.end());
-	ASSERT_EQ(expect.front(), result.front());
-	expect.clear();
-	result.clear();
-	ASSERT_EQ(0, Class::count);
+
+TEST_F(TestGrowth, DOUBLE) {
+	Vector<TType, Allocator<TType>, growth::Double> result;
+	for(int i = 0; i < 1000; i++) {
+		result.push_back(i);
+		ASSERT_GE(result.capacity(), result.size());
+		ASSERT_LE(result.capacity(), 2*result.size());
+	}
 }
 
-TEST_F(TestElementAccess, FRONT_2) {
-	Class::count = 0;
-	Expect expect(1);
-	random_fill(expect);
-	Result result(expect.begin(), expect.end());
-	ASSERT_EQ(expect.front(), result.front());
-	expect.clear();
-	result.clear();
-	ASSERT_EQ(0, Class::count);
+TEST_F(TestGrowth, ONE_AND_HALF) {
+	Vector<TType, Allocator<TType>, growth::OneAndHalf> result;
+	for(int i = 0; i < 1000; i++) {
+		result.push_back(i);
+		ASSERT_GE(result.capacity(), result.size());
+		ASSERT_LE(result.capacity(), 3*result.size()/2 + 1);
+	}
 }
 
-TEST_F(TestElementAccess, FRONT_3) {
-	Class::count = 0;
-	Expect expect(1);
-	random_fill(expect);
-	Result result(expect.begin(), expect.end());
-	auto value = expect.front();
-	expect.front() = value*2;
-	result.front() = value*2;
-	compare_vectors(expect, result);
-	expect.clear();
-	result.clear();
-	ASSERT_EQ(1, Class::count);
+TEST_F(TestGrowth, EXACT) {
+	Vector<TType, Allocator<TType>, growth::Exact> result;
+	for(int i = 0; i < 1000; i++) {
+		result.push_back(i);
+		ASSERT_EQ(result.size(), result.capacity());
+	}
 }
 
-TEST_F(TestElementAccess, BACK_1) {
-	Class::count = 0;
-	Expect expect(1000, 0);
-	random_fill(expect);
-	Result result(expect.begin(), expect.end());
-	ASSERT_EQ(expect.back(), result.back());
-	expect.clear();
-	result.clear();
-	ASSERT_EQ(0, Class::count);
+TEST_F(TestGrowth, CAPPED_CHUNK) {
+	Vector<TType, Allocator<TType>, growth::CappedChunk<64>> result;
+	for(int i = 0; i < 1000; i++) {
+		result.push_back(i);
+		ASSERT_GE(result.capacity(), result.size());
+		ASSERT_LT(result.capacity() - result.size(), 64);
+	}
+	ASSERT_EQ(0, result.capacity()%64);
 }
 
-TEST_F(TestElementAccess, BACK_2) {
-	Class::count = 0;
-	Expect expect(1);
-	random_fill(expect);
-	Result result(expect.begin(), expect.end());
-	ASSERT_EQ(expect.back(), result.back());
-	expect.clear();
-	result.clear();
-	ASSERT_EQ(0, Class::count);
+TEST_F(TestGrowth, RESIZE) {
+	Result result;
+	result.resize(1000000);
+	ASSERT_EQ(1000000, result.capacity());
+	result.resize(1000001);
+	ASSERT_EQ(2000000, result.capacity());
 }
 
-TEST_F(TestElementAccess, BACK_3) {
-	Class::count = 0;
-	Expect expect(1);
-	random_fill(expect);
-	Result result(expect.begin(), expect.end());
-	auto value = expect.back();
-	expect.back() = value*2;
-	result.back() = value*2;
-	compare_vectors(expect, result);
-	expect.clear();
-	result.clear();
-	ASSERT_EQ(1, Class::count);
+TEST_F(TestGrowth, SIZE_CONSTRUCTOR) {
+	Result result(1000);
+	ASSERT_EQ(1000, result.capacity());
 }
 
-TEST_F(TestElementAccess, AT_1) {
+
+
+
+
+
+TEST_F(TestRelocation, DESTROYS_OLD) {
 	Class::count = 0;
-	Expect expect(1000, 0);
-	random_fill(expect);
-	Result result(expect.begin(), expect.end());
-	compare_vectors(expect, result);
-	expect.clear();
-	result.clear();
+	{
+		Vector<Class, Allocator<Class>> result;
+		for(int i = 0; i < 1000; i++) {
+			result.push_back(Class(i));
+		}
+		ASSERT_EQ(1000, Class::count);
+		result.reserve(5000);
+		result.resize(3000);
+		ASSERT_EQ(3000, Class::count);
+		result.resize(10);
+		ASSERT_EQ(10, Class::count);
+		for(int i = 0; i < 10; i++) {
+			ASSERT_EQ(i, result[i].get_value());
+		}
+	}
 	ASSERT_EQ(0, Class::count);
 }
 
-TEST_F(TestElementAccess, AT_2) {
-	Class::count = 0;
-	Expect expect(1000, 0);
-	random_fill(expect);
-	Result result(expect.begin(), expect.end());
-	int index = rd()%expect.size();
-	auto value = expect.at(index);
-	expect.at(index) = value*2;
-	result.at(index) = value*2;
-	compare_vectors(expect, result);
-	expect.clear();
-	result.clear();
-	ASSERT_EQ(1, Class::count);
+TEST_F(TestRelocation, STRINGS) {
+	std::vector<std::string> expect;
+	Vector<std::string, Allocator<std::string>> result;
+	for(int i = 0; i < 1000; i++) {
+		std::string value(50, 'a' + i%26);
+		size_t index = i == 0 ? 0 : rd()%expect.size();
+		expect.insert(expect.begin() + index, value);
+		result.insert(result.begin() + index, value);
+	}
+	expect.resize(2000);
+	result.resize(2000);
+	ASSERT_EQ(expect.size(), result.size());
+	for(size_t i = 0; i < expect.size(); i++) {
+		ASSERT_EQ(expect[i], result[i]);
+	}
 }
 
-TEST_F(TestElementAccess, BRACES_1) {
-	Class::count = 0;
-	Expect expect(1000, 0);
-	random_fill(expect);
-	Result result(expect.begin(), expect.end());
-	compare_vectors_br(expect, result);
-	expect.clear();
-	result.clear();
-	ASSERT_EQ(0, Class::count);
+TEST_F(TestRelocation, NOEXCEPT_MOVE) {
+	Vector<Tracked, Allocator<Tracked>> result;
+	result.resize(100);
+	Tracked::copies = 0;
+	Tracked::moves = 0;
+	result.reserve(1000);
+	ASSERT_EQ(0, Tracked::copies);
+	ASSERT_EQ(100, Tracked::moves);
 }
 
-TEST_F(TestElementAccess, BRACES_2) {
-	Class::count = 0;
-	Expect expect(1000, 0);
-	random_fill(expect);
-	Result result(expect.begin(), expect.end());
-	int index = rd()%expect.size();
-	auto value = expect.at(index);
-	expect[index] = value*2;
-	result[index] = value*2;
-	compare_vectors(expect, result);
-	expect.clear();
-	result.clear();
-	ASSERT_EQ(1, Class::count);
+TEST_F(TestRelocation, TRIVIALLY_RELOCATABLE) {
+	Vector<Relocatable, Allocator<Relocatable>> result;
+	for(int i = 0; i < 100; i++) {
+		result.insert(result.begin(), Relocatable(i));
+	}
+	Tracked::copies = 0;
+	Tracked::moves = 0;
+	result.reserve(1000);
+	result.insert(result.begin() + 50, Relocatable(-1));
+	ASSERT_EQ(0, Tracked::copies);
+	ASSERT_EQ(1, Tracked::moves);
+	ASSERT_EQ(99, result[0].value);
+	ASSERT_EQ(-1, result[50].value);
+	ASSERT_EQ(0, result[100].value);
 }
 
+typedef Vector<TType, Allocator<TType>, growth::Double, stats::Counting> Counted;
 
+TEST_F(TestStats, NONE_COSTS_NOTHING) {
+	struct Plain {
+		TType* pointers[3];
+		Allocator<TType> allocator;
+	};
+	ASSERT_TRUE(std::is_empty<stats::None>::value);
+	ASSERT_EQ(sizeof(Plain), sizeof(Result));
+	ASSERT_EQ(0, Result(100).stats().counters().allocations);
+}
 
+TEST_F(TestStats, PUSH_BACK) {
+	Counted result;
+	for(int i = 0; i < 1024; i++) {
+		result.push_back(i);
+	}
+	const stats::Counters& counters = result.stats().counters();
+	ASSERT_EQ(11, counters.allocations);
+	ASSERT_EQ(10, counters.deallocations);
+	ASSERT_EQ(10, counters.reallocations);
+	ASSERT_EQ(1023, counters.moves);
+	ASSERT_EQ(0, counters.copies);
+	ASSERT_EQ(1024*sizeof(TType), counters.bytes);
+	ASSERT_EQ((512 + 1024)*sizeof(TType), counters.peak_bytes);
+}
 
+TEST_F(TestStats, RESERVE_RESIZE) {
+	Counted result;
+	result.reserve(10);
+	ASSERT_EQ(0, result.stats().counters().reallocations);
+	result.resize(10);
+	result.resize(11);
+	result.reserve(100);
+	ASSERT_EQ(2, result.stats().counters().reallocations);
+	ASSERT_EQ(21, result.stats().counters().moves);
+	ASSERT_EQ(100*sizeof(TType), result.stats().counters().bytes);
+}
 
+TEST_F(TestStats, INSERT_ERASE) {
+	Counted result(10);
+	result.reserve(100);
+	const_cast<stats::Counting&>(result.stats()).reset();
+	result.insert(result.begin() + 2, 7);
+	ASSERT_EQ(8, result.stats().counters().moves);
+	result.erase(result.begin());
+	ASSERT_EQ(18, result.stats().counters().moves);
+	ASSERT_EQ(0, result.stats().counters().allocations);
+	ASSERT_EQ(100*sizeof(TType), result.stats().counters().peak_bytes);
+}
 
-TEST_F(TestModifiers, INSERT) {
-	Class::count = 0;
-	Expect expect;
-	Result result;
-	for(int i = 0; i < 1000; i++) {
-		TType value(rd());
-		size_t index = i == 0 ? 0 : rd()%expect.size();
-		auto ie = expect.insert(expect.begin() + index, value);
-		auto ir = result.insert(result.begin() + index, value);
-		ASSERT_EQ(expect.end() - ie, result.end() - ir);
+TEST_F(TestStats, COPIES) {
+	Vector<ThrowingMove, Allocator<ThrowingMove>, growth::Double, stats::Counting> result;
+	for(int i = 0; i < 100; i++) {
+		result.push_back(ThrowingMove(i));
 	}
-	compare_vectors(expect, result);
-	expect.clear();
-	result.clear();
-	ASSERT_EQ(0, Class::count);
+	ASSERT_EQ(127, result.stats().counters().copies);
+	ASSERT_EQ(0, result.stats().counters().moves);
+	Vector<Relocatable, Allocator<Relocatable>, growth::Double, stats::Counting> relocated(100);
+	relocated.reserve(1000);
+	ASSERT_EQ(100, relocated.stats().counters().moves);
+	ASSERT_EQ(0, relocated.stats().counters().copies);
 }
 
-TEST_F(TestModifiers, CLEAR) {
-	Class::count = 0;
-	Result result(1000);
-	random_fill(result);
-	result.clear();
-	ASSERT_EQ(0, result.size());
-	ASSERT_EQ(0, Class::count);
+TEST_F(TestStats, OWNERSHIP) {
+	Counted first(100);
+	Counted second(std::move(first));
+	ASSERT_EQ(0, first.stats().counters().bytes);
+	ASSERT_EQ(100*sizeof(TType), second.stats().counters().bytes);
+	Counted third(10);
+	third.swap(second);
+	ASSERT_EQ(10*sizeof(TType), second.stats().counters().bytes);
+	ASSERT_EQ(100*sizeof(TType), third.stats().counters().bytes);
+	first = std::move(third);
+	ASSERT_EQ(100*sizeof(TType), first.stats().counters().bytes);
+	ASSERT_EQ(0, third.stats().counters().bytes);
+	Counted copy(first);
+	ASSERT_EQ(1, copy.stats().counters().allocations);
+	ASSERT_EQ(100*sizeof(TType), copy.stats().counters().bytes);
 }
 
-TEST_F(TestModifiers, EMPLACE) {
-	Class::count = 0;
-	Expect expect;
-	Result result;
-	for(int i = 0; i < 1000; i++) {
-		int value = rd();
-		size_t index = i == 0 ? 0 : rd()%expect.size();
-		auto ie = expect.emplace(expect.begin() + index, value);
-		auto ir = result.emplace(result.begin() + index, value);
-		ASSERT_EQ(expect.end() - ie, result.end() - ir);
+TEST_F(TestStats, GLOBAL) {
+	stats::reset_global();
+	std::size_t bytes = stats::global().bytes;
+	{
+		Counted first(100);
+		SmallVector<TType, 4, std::allocator<TType>, growth::Double, stats::Counting> second;
+		for(int i = 0; i < 10; i++) {
+			second.push_back(i);
+		}
+		SmallVector<TType, 4, std::allocator<TType>, growth::Double, stats::Counting> third(std::move(second));
+		ASSERT_EQ(4*sizeof(TType), second.stats().counters().bytes);
+		stats::Counters counters = stats::global();
+		ASSERT_EQ(first.stats().counters().allocations + second.stats().counters().allocations +
+			third.stats().counters().allocations, counters.allocations);
+		ASSERT_EQ(bytes + (100 + 4 + 16)*sizeof(TType), counters.bytes);
+		ASSERT_EQ(2, counters.reallocations);
+		// Of other vectors alive meanwhile
+		Result plain(1000);
+		ASSERT_EQ(bytes + (100 + 4 + 16)*sizeof(TType), stats::global().bytes);
 	}
-	compare_vectors(expect, result);
-	expect.clear();
-	result.clear();
-	ASSERT_EQ(0, Class::count);
+	ASSERT_EQ(bytes, stats::global().bytes);
 }
 
-TEST_F(TestModifiers, PUSH_BACK) {
-	Class::count = 0;
-	Expect expect;
-	Result result;
+TEST_F(TestReclaim, SHRINK_TO_FIT) {
+	Counted result;
 	for(int i = 0; i < 1000; i++) {
-		int value = rd();
-		expect.push_back(value);
-		result.push_back(value);
+		result.push_back(i);
 	}
-	compare_vectors(expect, result);
-	expect.clear();
+	ASSERT_EQ(1024, result.capacity());
+	ASSERT_EQ(&result[0], result.data());
+	result.resize(300);
+	result.shrink_to_fit();
+	ASSERT_EQ(300, result.capacity());
+	ASSERT_EQ(result.begin(), result.data());
+	for(int i = 0; i < 300; i++) {
+		ASSERT_EQ(i, result[i]);
+	}
+	ASSERT_EQ(300*sizeof(TType), result.stats().counters().bytes);
+	ASSERT_EQ(724*sizeof(TType), result.stats().counters().reclaimed);
+	result.shrink_to_fit();
+	ASSERT_EQ(724*sizeof(TType), result.stats().counters().reclaimed);
 	result.clear();
-	ASSERT_EQ(0, Class::count);
+	result.shrink_to_fit();
+	ASSERT_EQ(0, result.capacity());
+	ASSERT_EQ(nullptr, result.data());
+	ASSERT_EQ(0, result.stats().counters().bytes);
+	result.push_back(7);
+	ASSERT_EQ(7, result[0]);
+	const Counted& constant = result;
+	ASSERT_EQ(7, *constant.data());
 }
 
-TEST_F(TestModifiers, ERASE) {
-	Class::count = 0;
-	Expect expect;
-	Result result;
-	for(int i = 0; i < 1000; i++) {
-		int value = rd();
-		expect.push_back(value);
-		result.push_back(value);
-	}
-	for(int i = 0; i < 500; i++) {
-		int index = rd()%expect.size();
-		auto ie = expect.erase(expect.begin() + index);
-		auto ir = result.erase(result.begin() + index);
-		ASSERT_EQ(expect.end() - ie, result.end() - ir);
+TEST_F(TestReclaim, TRIM) {
+	Result result(100);
+	result.reserve(1000);
+	ASSERT_EQ(850*sizeof(TType), result.trim(reclaim::Slack<50>()));
+	ASSERT_EQ(150, result.capacity());
+	ASSERT_EQ(0, result.trim<reclaim::Slack<50>>());
+	ASSERT_EQ(50*sizeof(TType), result.trim<reclaim::Exact>());
+	ASSERT_EQ(100, result.capacity());
+	Vector<std::string> strings(10, "reclaimed");
+	strings.reserve(100);
+	strings.trim<reclaim::Exact>();
+	ASSERT_EQ(10, strings.capacity());
+	ASSERT_EQ("reclaimed", strings[9]);
+}
+
+TEST_F(TestReclaim, IDLE) {
+	Vector<TType, Allocator<TType>, growth::Double, stats::Counting, reclaim::Idle<8>> result;
+	for(int i = 0; i < 1024; i++) {
+		result.push_back(i);
 	}
+	result.resize(100);
+	for(int i = 0; i < 6; i++) {
+		result.pop_back();
+	}
+	ASSERT_EQ(1024, result.capacity());
+	// The eighth operation in a row below a quarter of the capacity
+	auto position = result.erase(result.begin() + 10, result.begin() + 20);
+	ASSERT_EQ(2*84, result.capacity());
+	ASSERT_EQ(result.begin() + 10, position);
+	ASSERT_EQ(20, *position);
+	ASSERT_EQ((1024 - 2*84)*sizeof(TType), result.stats().counters().reclaimed);
+	for(int i = 0; i < 8; i++) {
+		result.push_back(i);
+	}
+	ASSERT_EQ(2*84, result.capacity());
+	result.clear();
+	ASSERT_EQ(2*84, result.capacity());
+	for(int i = 0; i < 7; i++) {
+		result.resize(0);
+	}
+	ASSERT_EQ(0, result.capacity());
+	ASSERT_EQ(0, result.stats().counters().bytes);
+}
+
+TEST_F(TestReclaim, IN_PLACE) {
+	typedef Allocator<float, 0, 1 << 20> Huge;
+	std::size_t page = Huge::huge_page_size/sizeof(float);
+	Vector<float, Huge, growth::Double, stats::Counting> huge(4*page, 1.0f);
+	float* memory = huge.data();
+	huge.resize(page + 1);
+	huge.shrink_to_fit();
+	ASSERT_EQ(memory, huge.data());
+	ASSERT_EQ(page + 1, huge.capacity());
+	ASSERT_EQ(0, huge.stats().counters().reallocations);
+	ASSERT_EQ((page + 1)*sizeof(float), huge.stats().counters().bytes);
+	ASSERT_EQ(1.0f, huge.back());
+	huge.resize(10);
+	huge.shrink_to_fit();
+	ASSERT_NE(memory, huge.data());
+	ASSERT_EQ(1, huge.stats().counters().reallocations);
+
+	Arena arena(1 << 16);
+	Vector<TType, ArenaAllocator<TType>> first{ArenaAllocator<TType>(arena)};
+	first.resize(1000);
+	auto begin = first.data();
+	first.resize(10);
+	first.shrink_to_fit();
+	ASSERT_EQ(begin, first.data());
+	ASSERT_EQ(10, first.capacity());
+	// The tail went back to the arena
+	Vector<TType, ArenaAllocator<TType>> second(100, 2, ArenaAllocator<TType>(arena));
+	ASSERT_EQ(begin + 10, second.data());
+	// Not the last allocation any more: nothing to give back
+	second.resize(10);
+	first.resize(5);
+	ASSERT_EQ(0, first.trim<reclaim::Exact>());
+	ASSERT_EQ(begin, first.data());
+	ASSERT_EQ(10, first.capacity());
+	ASSERT_EQ(90*sizeof(TType), second.trim<reclaim::Exact>());
+
+	SmallVector<TType, 8> small;
+	for(int i = 0; i < 100; i++) {
+		small.push_back(i);
+	}
+	small.resize(3);
+	small.shrink_to_fit();
+	ASSERT_TRUE(small.is_small());
+	ASSERT_EQ(2, small[2]);
+	// The inline buffer in use is not handed out a second time
+	small.assign(6, 5);
+	ASSERT_EQ(6, small.size());
+	ASSERT_EQ(5, small[0]);
+	ASSERT_EQ(5, small[5]);
+	small.assign(3, 4);
+	small.shrink_to_fit();
+	ASSERT_TRUE(small.is_small());
+	ASSERT_EQ(4, small[2]);
+	ASSERT_EQ(8, small.capacity());
+	// Inline elements keep their room
+	SmallVector<TType, 8> inline_only(2, 1);
+	ASSERT_EQ(0, inline_only.trim<reclaim::Exact>());
+	ASSERT_EQ(8, inline_only.capacity());
+	inline_only.assign(8, 3);
+	ASSERT_TRUE(inline_only.is_small());
+	small.clear();
+	small.shrink_to_fit();
+	ASSERT_TRUE(small.is_small());
+	for(int i = 0; i < 8; i++) {
+		small.push_back(i);
+	}
+	ASSERT_TRUE(small.is_small());
+	ASSERT_EQ(7, small.back());
+}
+
+
+
+
+
+
+TEST_F(TestPoolAllocator, REUSE) {
+	PoolAllocator<TType> allocator;
+	TType* first = allocator.allocate(10);
+	allocator.deallocate(first, 10);
+	TType* second = allocator.allocate(12);
+	ASSERT_EQ(first, second);
+	allocator.deallocate(second, 12);
+	ASSERT_EQ(nullptr, allocator.allocate(0));
+}
+
+TEST_F(TestPoolAllocator, SIZE_CLASSES) {
+	ASSERT_EQ(0, PoolResource::size_class(1));
+	ASSERT_EQ(0, PoolResource::size_class(16));
+	ASSERT_EQ(1, PoolResource::size_class(17));
+	ASSERT_EQ(PoolResource::class_count - 1, PoolResource::size_class(PoolResource::max_block));
+	ASSERT_EQ(PoolResource::class_count, PoolResource::size_class(PoolResource::max_block + 1));
+}
+
+TEST_F(TestPoolAllocator, VECTOR) {
+	Class::count = 0;
+	{
+		Vector<Class, PoolAllocator<Class, false>> result;
+		std::vector<Class> expect;
+		for(int i = 0; i < 100000; i++) {
+			result.push_back(Class(i));
+			expect.push_back(Class(i));
+		}
+		ASSERT_TRUE(std::equal(expect.begin(), expect.end(), result.begin()));
+	}
+	ASSERT_EQ(0, Class::count);
+}
+
+TEST_F(TestPoolAllocator, REBIND) {
+	typedef PoolAllocator<TType>::rebind<double>::other Rebound;
+	Rebound allocator(PoolAllocator<TType>{});
+	double* p = allocator.allocate(3);
+	p[2] = 1.5;
+	allocator.deallocate(p, 3);
+	ASSERT_TRUE(PoolAllocator<TType>() == allocator);
+}
+
+TEST_F(TestPoolAllocator, THREADS) {
+	std::vector<std::thread> threads;
+	std::vector<int> failures(4, 0);
+	for(int t = 0; t < 4; t++) {
+		threads.emplace_back([t, &failures]() {
+			for(int i = 0; i < 10000; i++) {
+				Vector<TType, PoolAllocator<TType>> result;
+				for(int j = 0; j < i%40; j++) {
+					result.push_back(t*j);
+				}
+				for(int j = 0; j < i%40; j++) {
+					failures[t] += result[j] != t*j;
+				}
+			}
+		});
+	}
+	for(auto& thread: threads) {
+		thread.join();
+	}
+	ASSERT_EQ(std::vector<int>(4, 0), failures);
+}
+
+
+
+
+
+
+TEST_F(TestArenaAllocator, SHARED) {
+	Arena arena(1024);
+	ArenaAllocator<TType> allocator(arena);
+	Vector<TType, ArenaAllocator<TType>> result_1(allocator);
+	Vector<TType, ArenaAllocator<TType>> result_2(allocator);
+	for(int i = 0; i < 10000; i++) {
+		result_1.push_back(i);
+		result_2.insert(result_2.begin(), i);
+	}
+	for(int i = 0; i < 10000; i++) {
+		ASSERT_EQ(i, result_1[i]);
+		ASSERT_EQ(9999 - i, result_2[i]);
+	}
+}
+
+TEST_F(TestArenaAllocator, EXTEND_IN_PLACE) {
+	Arena arena(1 << 20);
+	Vector<TType, ArenaAllocator<TType>> result{ArenaAllocator<TType>(arena)};
+	result.push_back(0);
+	auto memory = result.begin();
+	for(int i = 1; i < 10000; i++) {
+		result.push_back(i);
+	}
+	result.insert(result.begin(), -1);
+	ASSERT_EQ(memory, result.begin());
+	ASSERT_EQ(-1, result[0]);
+	ASSERT_EQ(9999, result.back());
+}
+
+TEST_F(TestArenaAllocator, RESET) {
+	Arena arena(256);
+	ArenaAllocator<double> allocator(arena);
+	double* first = allocator.allocate(10);
+	for(int i = 0; i < 100; i++) {
+		double* p = allocator.allocate(i + 1);
+		ASSERT_EQ(0, reinterpret_cast<std::uintptr_t>(p)%alignof(double));
+	}
+	std::size_t reserved = arena.reserved();
+	arena.reset();
+	ASSERT_EQ(first, allocator.allocate(10));
+	for(int i = 0; i < 100; i++) {
+		allocator.allocate(i + 1);
+	}
+	ASSERT_EQ(reserved, arena.reserved());
+	arena.release();
+	ASSERT_EQ(0, arena.reserved());
+}
+
+TEST_F(TestArenaAllocator, MOVE) {
+	Arena arena;
+	ArenaAllocator<TType> allocator(arena);
+	Vector<TType, ArenaAllocator<TType>> result_1(10, 1, allocator);
+	Vector<TType, ArenaAllocator<TType>> result_2(allocator);
+	auto memory = result_1.begin();
+	result_2 = std::move(result_1);
+	ASSERT_EQ(memory, result_2.begin());
+}
+
+
+
+
+
+
+template<class A>
+void check_alignment(std::size_t a_alignment) {
+	A allocator;
+	for(std::size_t n : {1, 3, 100, 10000}) {
+		typename A::pointer p = allocator.allocate(n);
+		ASSERT_EQ(0, reinterpret_cast<std::uintptr_t>(p)%a_alignment);
+		p[n - 1] = typename A::value_type();
+		allocator.deallocate(p, n);
+	}
+}
+
+TEST_F(TestAlignment, DEFAULT) {
+	ASSERT_EQ(alignof(double), Allocator<double>::alignment);
+	check_alignment<Allocator<double>>(alignof(double));
+}
+
+TEST_F(TestAlignment, CACHE_LINE) {
+	ASSERT_EQ(64, (Allocator<float, 64>::alignment));
+	check_alignment<Allocator<float, 64>>(64);
+	check_alignment<Allocator<char, 64>>(64);
+}
+
+TEST_F(TestAlignment, AVX512) {
+	check_alignment<Allocator<double, 128>>(128);
+	Vector<float, Allocator<float, 64>> result;
+	for(int i = 0; i < 1000; i++) {
+		result.push_back(i);
+		ASSERT_EQ(0, reinterpret_cast<std::uintptr_t>(result.begin())%64);
+	}
+}
+
+TEST_F(TestAlignment, REBIND) {
+	typedef Allocator<float, 64, 1 << 22>::rebind<char>::other Rebound;
+	ASSERT_EQ(64, Rebound::alignment);
+	ASSERT_EQ(1 << 22, Rebound::huge_page_threshold);
+	typedef Rebound::rebind<float>::other Back;
+	ASSERT_TRUE((std::is_same<Back, Allocator<float, 64, 1 << 22>>::value));
+	Rebound rebound = Allocator<float, 64, 1 << 22>();
+	ASSERT_TRUE(rebound == Back());
+	ASSERT_FALSE((Allocator<float>() == Allocator<float, 64>()));
+	check_alignment<Rebound>(64);
+}
+
+TEST_F(TestAlignment, HUGE_PAGES) {
+	typedef Allocator<float, 64, 1 << 20> Huge;
+	check_alignment<Huge>(64);
+	Huge allocator;
+	std::size_t n = 3 << 20;
+	float* p = allocator.allocate(n);
+	ASSERT_EQ(0, reinterpret_cast<std::uintptr_t>(p)%Huge::huge_page_size);
+	for(std::size_t i = 0; i < n; i += 1024) {
+		p[i] = i;
+	}
+	ASSERT_EQ(2048, p[2048]);
+	allocator.deallocate(p, n);
+	Vector<float, Huge> result(n, 1.0f);
+	ASSERT_EQ(1.0f, result[n - 1]);
+}
+
+
+
+
+
+
+template<class V>
+bool is_inside(const V& a_vector) {
+	const char* object = reinterpret_cast<const char*>(&a_vector);
+	const char* memory = reinterpret_cast<const char*>(a_vector.begin());
+	return memory >= object && memory < object + sizeof(V);
+}
+
+TEST_F(TestSmallVector, INLINE) {
+	SmallVector<TType, 8> result;
+	ASSERT_TRUE(result.is_small());
+	ASSERT_TRUE(is_inside(result));
+	ASSERT_EQ(8, result.capacity());
+	for(int i = 0; i < 8; i++) {
+		result.push_back(i);
+	}
+	ASSERT_TRUE(result.is_small());
+	result.push_back(8);
+	ASSERT_FALSE(result.is_small());
+	ASSERT_FALSE(is_inside(result));
+	for(int i = 0; i < 9; i++) {
+		ASSERT_EQ(i, result[i]);
+	}
+}
+
+TEST_F(TestSmallVector, INTERFACE) {
+	Expect expect(100);
+	random_fill(expect);
+	SmallVector<TType, 4> result(expect.begin(), expect.end());
+	ASSERT_EQ(expect.size(), result.size());
+	ASSERT_TRUE(std::equal(expect.begin(), expect.end(), result.begin()));
+	expect.erase(expect.begin() + 10, expect.begin() + 90);
+	result.erase(result.begin() + 10, result.begin() + 90);
+	expect.insert(expect.begin() + 5, 7);
+	result.insert(result.begin() + 5, 7);
+	ASSERT_TRUE(std::equal(expect.rbegin(), expect.rend(), result.rbegin()));
+	ASSERT_EQ(expect.at(3), result.at(3));
+	ASSERT_THROW(result.at(1000), std::out_of_range);
+	SmallVector<TType, 4> filled(3, 5);
+	ASSERT_EQ(3, filled.size());
+	ASSERT_EQ(5, filled.back());
+	// Vector's move and swap would take the inline buffer
+	ASSERT_FALSE((std::is_convertible<SmallVector<TType, 4>*, Vector<TType, InlineAllocator<TType, 4>>*>::value));
+	ASSERT_EQ(3, erase_if(filled, [](TType a) { return a == 5; }));
+	ASSERT_TRUE(filled.empty());
+}
+
+TEST_F(TestSmallVector, COPY_AND_MOVE) {
+	Class::count = 0;
+	{
+		SmallVector<Class, 4> small{Class(1), Class(2)};
+		SmallVector<Class, 4> big(10, Class(3));
+		SmallVector<Class, 4> small_copy(small);
+		SmallVector<Class, 4> big_copy(big);
+		ASSERT_TRUE(small_copy.is_small());
+		ASSERT_EQ(2, small_copy[1].get_value());
+		ASSERT_EQ(10, big_copy.size());
+
+		auto memory = big.begin();
+		SmallVector<Class, 4> big_moved(std::move(big));
+		ASSERT_EQ(memory, big_moved.begin());
+		ASSERT_TRUE(big.is_small());
+		ASSERT_TRUE(big.empty());
+
+		SmallVector<Class, 4> small_moved(std::move(small));
+		ASSERT_TRUE(small_moved.is_small());
+		ASSERT_TRUE(is_inside(small_moved));
+		ASSERT_EQ(2, small_moved.size());
+
+		swap(small_moved, big_moved);
+		ASSERT_EQ(10, small_moved.size());
+		ASSERT_EQ(2, big_moved.size());
+		ASSERT_TRUE(big_moved.is_small());
+		big_copy = small_copy;
+		ASSERT_EQ(2, big_copy.size());
+		ASSERT_EQ(16, Class::count);
+	}
+	ASSERT_EQ(0, Class::count);
+}
+
+TEST_F(TestSmallVector, NESTED) {
+	Vector<SmallVector<TType, 2>> result;
+	for(int i = 0; i < 100; i++) {
+		result.push_back(SmallVector<TType, 2>(i%4, i));
+	}
+	for(int i = 0; i < 100; i++) {
+		ASSERT_EQ(i%4, result[i].size());
+		ASSERT_TRUE(result[i].empty() || result[i].back() == i);
+		ASSERT_EQ(i%4 <= 2, result[i].is_small());
+		ASSERT_EQ(i%4 <= 2, is_inside(result[i]));
+	}
+}
+
+typedef SegmentedVector<TType, Allocator<TType>, 16> Segmented;
+
+TEST_F(TestSegmentedVector, STABLE_REFERENCES) {
+	Segmented result;
+	Vector<const TType*> addresses;
+	for(int i = 0; i < 1000; i++) {
+		result.push_back(i);
+		addresses.push_back(&result.back());
+	}
+	ASSERT_EQ(1000, result.size());
+	ASSERT_EQ(1008, result.capacity());
+	for(int i = 0; i < 1000; i++) {
+		ASSERT_EQ(i, result[i]);
+		ASSERT_EQ(addresses[i], &result[i]);
+	}
+	ASSERT_THROW(result.at(1000), std::out_of_range);
+}
+
+TEST_F(TestSegmentedVector, ITERATORS) {
+	Segmented result(100);
+	std::iota(result.begin(), result.end(), 0);
+	ASSERT_EQ(100, result.end() - result.begin());
+	const Segmented& constant = result;
+	ASSERT_EQ(100, std::distance(constant.begin(), constant.end()));
+	Segmented::const_iterator i = result.begin() + 40;
+	ASSERT_EQ(40, *i);
+	ASSERT_EQ(57, i[17]);
+	ASSERT_EQ(39, *--i);
+	ASSERT_TRUE(i < result.end() && result.end() > i);
+	ASSERT_EQ(99, *result.rbegin());
+	ASSERT_TRUE(std::equal(result.rbegin(), result.rend(), Expect(result.begin(), result.end()).rbegin()));
+}
+
+TEST_F(TestSegmentedVector, ERASE_RESIZE) {
+	Segmented result(50, 7);
+	result.erase(result.begin() + 40, result.end());
+	ASSERT_EQ(40, result.size());
+	result.pop_back();
+	ASSERT_EQ(39, result.size());
+	result.resize(70);
+	ASSERT_EQ(0, result[69]);
+	ASSERT_EQ(7, result[38]);
+	result[0] = 1;
+	result.erase(result.begin());
+	ASSERT_EQ(7, result[0]);
+	ASSERT_EQ(69, result.size());
+	std::size_t capacity = result.capacity();
+	result.clear();
+	ASSERT_TRUE(result.empty());
+	ASSERT_EQ(capacity, result.capacity());
+}
+
+TEST_F(TestSegmentedVector, COPY_AND_MOVE) {
+	SegmentedVector<std::string, std::allocator<std::string>, 4> result;
+	for(int i = 0; i < 10; i++) {
+		result.push_back(std::to_string(i));
+	}
+	SegmentedVector<std::string, std::allocator<std::string>, 4> copy(result);
+	ASSERT_TRUE(std::equal(result.begin(), result.end(), copy.begin()));
+	SegmentedVector<std::string, std::allocator<std::string>, 4> moved(std::move(result));
+	ASSERT_TRUE(result.empty());
+	ASSERT_TRUE(std::equal(copy.begin(), copy.end(), moved.begin()));
+	result = copy;
+	copy = std::move(moved);
+	ASSERT_TRUE(std::equal(result.begin(), result.end(), copy.begin()));
+	result.swap(moved);
+	ASSERT_EQ(10, moved.size());
+	ASSERT_TRUE(result.empty());
+}
+
+TEST_F(TestMappedVector, REOPEN) {
+	{
+		MappedVector<TType> result(path);
+		ASSERT_TRUE(result.empty());
+		for(int i = 0; i < 100000; i++) {
+			result.push_back(i);
+		}
+		result.flush();
+	}
+	MappedVector<TType> result(path);
+	ASSERT_EQ(100000, result.size());
+	ASSERT_LE(100000, result.capacity());
+	for(int i = 0; i < 100000; i++) {
+		ASSERT_EQ(i, result[i]);
+	}
+	result.shrink_to_fit();
+	ASSERT_EQ(100000, result.capacity());
+	struct stat status;
+	ASSERT_EQ(0, stat(path.c_str(), &status));
+	ASSERT_EQ(MappedVector<TType>::header_size + 100000*sizeof(TType), status.st_size);
+}
+
+TEST_F(TestMappedVector, MODIFIERS) {
+	MappedVector<TType> result(path);
+	Expect expect;
+	for(int i = 0; i < 1000; i++) {
+		result.push_back(i);
+		expect.push_back(i);
+	}
+	result.push_back(result[0]);
+	expect.push_back(expect[0]);
+	result.insert(result.begin() + 10, 5, -1);
+	expect.insert(expect.begin() + 10, 5, -1);
+	result.insert(result.end(), result.front());
+	expect.insert(expect.end(), expect.front());
+	result.erase(result.begin() + 100, result.begin() + 200);
+	expect.erase(expect.begin() + 100, expect.begin() + 200);
+	result.pop_back();
+	expect.pop_back();
+	result.resize(2000, 3);
+	expect.resize(2000, 3);
+	ASSERT_TRUE(std::equal(expect.begin(), expect.end(), result.begin(), result.end()));
+	ASSERT_THROW(result.at(2000), std::out_of_range);
+	result.advise(MappedVector<TType>::random);
+	custom::sort(result.begin(), result.end());
+	std::sort(expect.begin(), expect.end());
+	ASSERT_TRUE(std::equal(expect.begin(), expect.end(), result.begin(), result.end()));
+	result.advise(MappedVector<TType>::sequential);
+	result.reserve(100000);
+	result.flush(true);
+	ASSERT_TRUE(std::equal(expect.begin(), expect.end(), result.begin(), result.end()));
+	MappedVector<TType> moved(std::move(result));
+	ASSERT_EQ(2000, moved.size());
+	ASSERT_TRUE(result.empty());
+	ASSERT_EQ(0, result.capacity());
+	ASSERT_EQ(result.begin(), result.end());
+	moved.shrink_to_fit();
+	ASSERT_EQ(2000, moved.capacity());
+	ASSERT_TRUE(std::equal(expect.begin(), expect.end(), moved.begin(), moved.end()));
+	moved.clear();
+	ASSERT_TRUE(moved.empty());
+}
+
+TEST_F(TestMappedVector, WRONG_FORMAT) {
+	{
+		MappedVector<TType> result(path);
+		result.push_back(1);
+	}
+	ASSERT_THROW(MappedVector<double> result(path), std::runtime_error);
+	ASSERT_THROW(MappedVector<TType> result("/nonexistent/directory/file"), std::system_error);
+	FILE* file = fopen(path.c_str(), "w");
+	fputs("not a vector", file);
+	fclose(file);
+	ASSERT_THROW(MappedVector<TType> result(path), std::runtime_error);
+}
+
+TEST_F(TestSerialization, SAVE_LOAD) {
+	for(int size : {0, 1, 7, 1000, 100001}) {
+		Result expect(size);
+		random_fill(expect);
+		serialization::save(path, expect);
+		struct stat status;
+		ASSERT_EQ(0, stat(path.c_str(), &status));
+		ASSERT_EQ(sizeof(serialization::Header) + size*sizeof(TType), status.st_size);
+		Result result(5, 5);
+		serialization::load(path, result);
+		ASSERT_EQ(expect.size(), result.size());
+		ASSERT_TRUE(std::equal(expect.begin(), expect.end(), result.begin()));
+	}
+}
+
+TEST_F(TestSerialization, PIPE) {
+	int pipes[2];
+	ASSERT_EQ(0, pipe(pipes));
+	Vector<double> expect = {1.5, -2, 1e300};
+	serialization::write(pipes[1], expect);
+	serialization::write(pipes[1], Vector<double>());
+	close(pipes[1]);
+	Vector<double> result, empty(3);
+	serialization::read(pipes[0], result);
+	serialization::read(pipes[0], empty);
+	ASSERT_THROW(serialization::read(pipes[0], result), std::runtime_error);
+	close(pipes[0]);
+	ASSERT_TRUE(std::equal(expect.begin(), expect.end(), result.begin(), result.end()));
+	ASSERT_TRUE(empty.empty());
+}
+
+TEST_F(TestSerialization, STREAMING) {
+	Result expect(10000);
+	random_fill(expect);
+	{
+		serialization::Writer<TType> writer(path);
+		writer.write(expect.begin(), 3);
+		writer.write(expect.begin() + 3, 4000);
+	}
+	{
+		serialization::Writer<TType> writer(path, true);
+		ASSERT_EQ(4003, writer.size());
+		writer.write(expect.begin() + 4003, expect.size() - 4003);
+		writer.close();
+	}
+	Result whole;
+	serialization::load(path, whole);
+	ASSERT_TRUE(std::equal(expect.begin(), expect.end(), whole.begin(), whole.end()));
+
+	serialization::Reader<TType> reader(path);
+	ASSERT_EQ(10000, reader.size());
+	Result chunk, result;
+	while (reader.read(chunk, 999) > 0) {
+		ASSERT_LE(chunk.size(), 999);
+		result.insert(result.end(), chunk.begin(), chunk.end());
+	}
+	ASSERT_EQ(0, reader.remaining());
+	ASSERT_TRUE(std::equal(expect.begin(), expect.end(), result.begin(), result.end()));
+}
+
+TEST_F(TestSerialization, APPEND_UNALIGNED) {
+	typedef std::array<char, 3> Triple;
+	Vector<Triple> expect;
+	for(int i = 0; i < 100; i++) {
+		expect.push_back(Triple{{char(i), char(i + 1), char(i + 2)}});
+	}
+	for(int i = 0; i < 100; i += 7) {
+		serialization::Writer<Triple> writer(path, i > 0);
+		writer.write(expect.begin() + i, std::min(7, 100 - i));
+	}
+	Vector<Triple> result;
+	serialization::load(path, result);
+	ASSERT_TRUE(std::equal(expect.begin(), expect.end(), result.begin(), result.end()));
+}
+
+TEST_F(TestSerialization, CORRUPTION) {
+	Result expect(1000);
+	random_fill(expect);
+	serialization::save(path, expect);
+	Vector<short> other;
+	ASSERT_THROW(serialization::load(path, other), std::runtime_error);
+	{
+		serialization::detail::File file(path, O_WRONLY);
+		ASSERT_EQ(1, pwrite(file.descriptor, "x", 1, sizeof(serialization::Header) + 100));
+	}
+	Result result;
+	ASSERT_THROW(serialization::load(path, result), std::runtime_error);
+	serialization::Reader<TType> reader(path);
+	ASSERT_EQ(500, reader.read(result, 500));
+	ASSERT_THROW(reader.read(result, 500), std::runtime_error);
+	ASSERT_EQ(0, truncate(path.c_str(), 100));
+	ASSERT_THROW(serialization::load(path, result), std::runtime_error);
+	ASSERT_THROW(serialization::load(path + ".missing", result), std::system_error);
+}
+
+TEST_F(TestSerialization, TRUNCATED) {
+	Result expect(1000);
+	random_fill(expect);
+	serialization::save(path, expect);
+	std::size_t length = sizeof(serialization::Header) + 1000*sizeof(TType) - 16;
+	ASSERT_EQ(0, truncate(path.c_str(), length));
+	ASSERT_THROW(serialization::Writer<TType> writer(path, true), std::runtime_error);
+	struct stat status;
+	ASSERT_EQ(0, stat(path.c_str(), &status));
+	ASSERT_EQ(length, status.st_size);
+	ASSERT_THROW(serialization::Reader<TType> reader(path), std::runtime_error);
+	// A count far beyond the input fails before anything that big is allocated
+	serialization::Header header = serialization::detail::make_header<TType>(std::uint64_t(1) << 60, 0);
+	{
+		serialization::detail::File file(path, O_WRONLY);
+		ASSERT_EQ(ssize_t(sizeof(header)), pwrite(file.descriptor, &header, sizeof(header), 0));
+	}
+	Result result;
+	ASSERT_THROW(serialization::load(path, result), std::runtime_error);
+	int pipes[2];
+	ASSERT_EQ(0, pipe(pipes));
+	ASSERT_EQ(ssize_t(sizeof(header)), write(pipes[1], &header, sizeof(header)));
+	close(pipes[1]);
+	ASSERT_THROW(serialization::read(pipes[0], result), std::runtime_error);
+	close(pipes[0]);
+	header.count = std::numeric_limits<std::uint64_t>::max()/2;
+	ASSERT_EQ(0, pipe(pipes));
+	ASSERT_EQ(ssize_t(sizeof(header)), write(pipes[1], &header, sizeof(header)));
+	close(pipes[1]);
+	ASSERT_THROW(serialization::read(pipes[0], result), std::runtime_error);
+	close(pipes[0]);
+}
+
+typedef SoAVector<int, double, std::string> Rows;
+typedef std::tuple<int, double, std::string> Row;
+
+TEST_F(TestSoAVector, PUSH_BACK) {
+	Rows rows;
+	std::vector<Row> expect;
+	for(int i = 0; i < SIZE; i++) {
+		Row row(i, i*0.5, std::to_string(i));
+		if (i % 2) {
+			rows.push_back(row);
+		} else {
+			rows.emplace_back(i, i*0.5, std::to_string(i));
+		}
+		expect.push_back(row);
+	}
+	ASSERT_EQ(rows.size(), expect.size());
+	for(int i = 0; i < SIZE; i++) {
+		ASSERT_EQ(Row(rows[i]), expect[i]);
+		ASSERT_TRUE(rows.at(i) == expect[i]);
+	}
+	ASSERT_EQ(rows.front().get<2>(), "0");
+	ASSERT_EQ(rows.back().get<0>(), SIZE - 1);
+	ASSERT_TRUE(std::equal(rows.begin(), rows.end(), expect.begin(), [](Rows::const_reference a, const Row& b) {
+		return Row(a) == b;
+	}));
+	ASSERT_THROW(rows.at(SIZE), std::out_of_range);
+	rows.pop_back();
+	ASSERT_EQ(rows.size(), SIZE - 1);
+	rows.clear();
+	ASSERT_TRUE(rows.empty());
+}
+
+TEST_F(TestSoAVector, PROXIES) {
+	Rows rows;
+	rows.resize(3);
+	ASSERT_EQ(Row(rows[2]), Row(0, 0.0, ""));
+	rows[0] = Row(1, 1.5, "one");
+	rows[1] = rows[0];
+	ASSERT_EQ(Row(rows[1]), Row(1, 1.5, "one"));
+	ASSERT_EQ(rows[0].get<2>(), "one");
+	rows[2] = Row(rows[0]);
+	ASSERT_EQ(rows[2].get<2>(), "one");
+	rows[0].get<0>() = 7;
+	using std::swap;
+	swap(rows[0], rows[2]);
+	ASSERT_EQ(rows[0].get<0>(), 1);
+	ASSERT_EQ(rows[2].get<0>(), 7);
+	const Rows& view = rows;
+	Rows::const_reference row = view[1];
+	ASSERT_EQ(row.get<1>(), 1.5);
+	Rows::const_iterator i = rows.begin();
+	ASSERT_TRUE(i + 3 == rows.end());
+	ASSERT_EQ(rows.end() - i, 3);
+	rows.erase(rows.begin());
+	ASSERT_EQ(rows.size(), 2);
+	ASSERT_EQ(Row(rows[0]), Row(1, 1.5, "one"));
+}
+
+TEST_F(TestSoAVector, COLUMNS) {
+	Rows rows;
+	rows.reserve(SIZE);
+	for(int i = 0; i < SIZE; i++) {
+		rows.emplace_back(i, i*2.0, "");
+	}
+	Column<int> ids = rows.column<0>();
+	ASSERT_EQ(ids.size(), SIZE);
+	ASSERT_EQ(std::accumulate(ids.begin(), ids.end(), 0), SIZE*(SIZE - 1)/2);
+	const Rows& view = rows;
+	Column<const double> values = view.column<1>();
+	for(int i = 0; i < SIZE; i++) {
+		ASSERT_EQ(values.data() + i, &values[i]);
+		ASSERT_EQ(values[i], i*2.0);
+	}
+	ids[5] = -1;
+	ASSERT_EQ(rows[5].get<0>(), -1);
+}
+
+TEST_F(TestConcurrentVector, PUSH_BACK) {
+	ConcurrentVector<TType> result;
+	ASSERT_TRUE(result.empty());
+	ASSERT_EQ(0, result.capacity());
+	Vector<const TType*> addresses;
+	for(int i = 0; i < 1000; i++) {
+		ASSERT_EQ(i, result.push_back(i));
+		addresses.push_back(&result[i]);
+	}
+	ASSERT_EQ(1000, result.size());
+	// Index 992 opened the segment of 1024, which prepared the one of 2048
+	ASSERT_EQ(4064, result.capacity());
+	for(int i = 0; i < 1000; i++) {
+		ASSERT_TRUE(result.published(i));
+		ASSERT_EQ(i, result.at(i));
+		ASSERT_EQ(addresses[i], &result[i]);
+	}
+	ASSERT_FALSE(result.published(1000));
+	ASSERT_THROW(result.at(1000), std::out_of_range);
+	result.reserve(5000);
+	ASSERT_EQ(8160, result.capacity());
+	ASSERT_EQ(addresses[999], &result[999]);
+}
+
+TEST_F(TestConcurrentVector, CLEAR) {
+	Class::count = 0;
+	{
+		ConcurrentVector<Class> result;
+		for(int i = 0; i < 100; i++) {
+			result.emplace_back(i, 2);
+		}
+		ASSERT_EQ(100, Class::count);
+		ASSERT_EQ(198, result[99].value);
+		result.clear();
+		ASSERT_EQ(0, Class::count);
+		ASSERT_TRUE(result.empty());
+		ASSERT_FALSE(result.published(0));
+		result.emplace_back(3);
+		ASSERT_EQ(1, Class::count);
+	}
+	ASSERT_EQ(0, Class::count);
+}
+
+TEST_F(TestConcurrentVector, PRODUCERS) {
+	const int producers = 4;
+	const int count = 20000;
+	ConcurrentVector<TType> result;
+	std::atomic<bool> done(false);
+	std::atomic<int> checked(0);
+	// Reads every published element while the producers run
+	std::thread reader([&]() {
+		while (!done.load()) {
+			std::size_t size = result.size();
+			for(std::size_t i = 0; i < size; i++) {
+				if (result.published(i)) {
+					TType value = result[i];
+					if (value < 0 || value >= producers*count) {
+						checked = -1;
+						return;
+					}
+				}
+			}
+			++checked;
+		}
+	});
+	Vector<std::thread> threads;
+	for(int t = 0; t < producers; t++) {
+		threads.push_back(std::thread([&result, t, count]() {
+			for(int i = 0; i < count; i++) {
+				result.push_back(t*count + i);
+			}
+		}));
+	}
+	for(std::thread& thread : threads) {
+		thread.join();
+	}
+	done = true;
+	reader.join();
+	ASSERT_GE(checked.load(), 0);
+	ASSERT_EQ(std::size_t(producers*count), result.size());
+	Vector<TType> values;
+	for(std::size_t i = 0; i < result.size(); i++) {
+		ASSERT_TRUE(result.published(i));
+		values.push_back(result[i]);
+	}
+	std::sort(values.begin(), values.end());
+	for(int i = 0; i < producers*count; i++) {
+		ASSERT_EQ(i, values[i]);
+	}
+}
+
+// Clusters of edits around a moving cursor, checked against std::vector
+template<class Buffer>
+void check_edits(Buffer& result) {
+	std::vector<typename Buffer::value_type> expect(result.begin(), result.end());
+	std::mt19937 generator(7);
+	std::size_t cursor = 0;
+	for(int step = 0; step < 3000; step++) {
+		if (generator()%16 == 0) {
+			cursor = expect.empty() ? 0 : generator()%expect.size();
+		}
+		cursor = std::min(cursor, expect.size());
+		int value = generator()%1000;
+		switch (generator()%5) {
+		case 0:
+		case 1:
+			result.insert(result.begin() + cursor, value);
+			expect.insert(expect.begin() + cursor, value);
+			++cursor;
+			break;
+		case 2:
+			result.insert(result.begin() + cursor, 3, value);
+			expect.insert(expect.begin() + cursor, 3, value);
+			break;
+		case 3:
+			if (cursor > 0) {
+				--cursor;
+				result.erase(result.begin() + cursor);
+				expect.erase(expect.begin() + cursor);
+			}
+			break;
+		case 4:
+			if (cursor + 2 <= expect.size()) {
+				result.erase(result.begin() + cursor, result.begin() + cursor + 2);
+				expect.erase(expect.begin() + cursor, expect.begin() + cursor + 2);
+			}
+			break;
+		}
+		ASSERT_EQ(expect.size(), result.size());
+	}
+	ASSERT_TRUE(std::equal(expect.begin(), expect.end(), result.begin()));
+}
+
+TEST_F(TestGapBuffer, EDITS) {
+	GapBuffer<TType> result(100, 5);
+	check_edits(result);
+	GapBuffer<std::string> strings;
+	for(int i = 0; i < 50; i++) {
+		strings.push_back(std::to_string(i));
+	}
+	strings.insert(strings.begin() + 10, std::string("x"));
+	ASSERT_EQ(10, strings.gap_position() - 1);
+	ASSERT_EQ("x", strings[10]);
+	ASSERT_EQ("10", strings[11]);
+	ASSERT_EQ("49", strings.back());
+	strings.erase(strings.begin(), strings.begin() + 10);
+	ASSERT_EQ(0, strings.gap_position());
+	ASSERT_EQ("x", strings.front());
+	ASSERT_EQ(41, strings.size());
+}
+
+TEST_F(TestGapBuffer, RESERVE) {
+	GapBuffer<TType> result = {1, 2, 3, 4};
+	result.insert(result.begin(), 0);
+	ASSERT_EQ(1, result.gap_position());
+	result.reserve(100);
+	ASSERT_LE(100, result.capacity());
+	TType expect[] = {0, 1, 2, 3, 4};
+	ASSERT_EQ(5, result.size());
+	ASSERT_TRUE(std::equal(expect, expect + 5, result.begin()));
+	GapBuffer<std::string> strings;
+	for(int i = 0; i < 10; i++) {
+		strings.push_back(std::to_string(i));
+	}
+	strings.insert(strings.begin() + 3, std::string("x"));
+	strings.reserve(100);
+	ASSERT_EQ(11, strings.size());
+	ASSERT_EQ("x", strings[3]);
+	ASSERT_EQ("3", strings[4]);
+	ASSERT_EQ("9", strings.back());
+}
+
+TEST_F(TestGapBuffer, DATA) {
+	GapBuffer<TType> result = {1, 2, 3, 4, 5};
+	result.insert(result.begin() + 2, 9);
+	ASSERT_EQ(3, result.gap_position());
+	TType* data = result.data();
+	ASSERT_EQ(result.size(), result.gap_position());
+	TType expect[] = {1, 2, 9, 3, 4, 5};
+	ASSERT_TRUE(std::equal(expect, expect + 6, data));
+	ASSERT_EQ(&result[5], data + 5);
+	// Appending keeps it contiguous
+	result.push_back(6);
+	ASSERT_EQ(data, result.data());
+	const GapBuffer<TType>& view = result;
+	ASSERT_EQ(6, *(view.end() - 1));
+	ASSERT_EQ(7, std::distance(view.begin(), view.end()));
+	ASSERT_THROW(result.at(7), std::out_of_range);
+}
+
+TEST_F(TestGapBuffer, OBJECTS) {
+	Class::count = 0;
+	{
+		GapBuffer<Class> result(20);
+		check_edits(result);
+		GapBuffer<Class> copy(result);
+		ASSERT_TRUE(std::equal(result.begin(), result.end(), copy.begin()));
+		GapBuffer<Class> moved(std::move(copy));
+		ASSERT_TRUE(copy.empty());
+		copy = moved;
+		ASSERT_EQ(result.size(), copy.size());
+		result.clear();
+		ASSERT_TRUE(result.empty());
+		result.resize(10);
+		ASSERT_EQ(10, result.size());
+		ASSERT_EQ(int(Class::default_value), result[9].value);
+	}
+	ASSERT_EQ(0, Class::count);
+}
+
+TEST_F(TestGapBuffer, ERASE_IF) {
+	GapBuffer<TType> buffer;
+	Vector<TType> vector;
+	std::vector<TType> expect;
+	for(int i = 0; i < SIZE; i++) {
+		buffer.insert(buffer.begin() + buffer.size()/2, i);
+		vector.push_back(i);
+		expect.push_back(i);
+	}
+	auto odd = [](TType a) {
+		return a % 2 != 0;
+	};
+	std::vector<TType> buffer_expect(buffer.begin(), buffer.end());
+	buffer_expect.erase(std::remove_if(buffer_expect.begin(), buffer_expect.end(), odd), buffer_expect.end());
+	ASSERT_EQ(SIZE/2, erase_if(buffer, odd));
+	ASSERT_TRUE(std::equal(buffer_expect.begin(), buffer_expect.end(), buffer.begin()));
+	ASSERT_EQ(buffer_expect.size(), buffer.size());
+	expect.erase(std::remove_if(expect.begin(), expect.end(), odd), expect.end());
+	ASSERT_EQ(SIZE/2, erase_if(vector, odd));
+	ASSERT_EQ(expect.size(), vector.size());
+	ASSERT_TRUE(std::equal(expect.begin(), expect.end(), vector.begin()));
+	ASSERT_EQ(0, erase_if(vector, odd));
+	// Every kept element after the first removed one moves once
+	Counted counted = {0, 1, 2, 3, 4, 5, 6, 7};
+	const_cast<stats::Counting&>(counted.stats()).reset();
+	ASSERT_EQ(3, counted.erase_if([](TType a) {
+		return a == 1 || a == 2 || a == 6;
+	}));
+	ASSERT_EQ(4, counted.stats().counters().moves);
+	ASSERT_EQ(5, counted.size());
+}
+
+
+
+
+
+
+// Inputs that degrade naive quicksorts
+Vector<Expect> sort_patterns(int a_size) {
+	Vector<Expect> patterns;
+	Expect random(a_size);
+	random_fill(random);
+	patterns.push_back(random);
+	Expect sorted(random);
+	std::sort(sorted.begin(), sorted.end());
+	patterns.push_back(sorted);
+	patterns.push_back(Expect(sorted.rbegin(), sorted.rend()));
+	patterns.push_back(Expect(a_size, 7));
+	Expect few(a_size);
+	for(int i = 0; i < a_size; i++) {
+		few[i] = rd()%4;
+	}
+	patterns.push_back(few);
+	Expect organ_pipe(a_size);
+	for(int i = 0; i < a_size; i++) {
+		organ_pipe[i] = std::min(i, a_size - i);
+	}
+	patterns.push_back(organ_pipe);
+	Expect nearly(sorted);
+	for(int i = 0; i < a_size/100; i++) {
+		std::swap(nearly[rd()%a_size], nearly[rd()%a_size]);
+	}
+	patterns.push_back(nearly);
+	return patterns;
+}
+
+TEST_F(TestSort, PATTERNS) {
+	for(int size : {0, 1, 2, 3, 16, 17, 100, 129, 1000, 100000}) {
+		for(const Expect& pattern : sort_patterns(size)) {
+			Expect expect(pattern);
+			Result result(pattern.begin(), pattern.end());
+			std::sort(expect.begin(), expect.end());
+			custom::sort(result.begin(), result.end());
+			ASSERT_TRUE(std::equal(expect.begin(), expect.end(), result.begin()));
+		}
+	}
+}
+
+// std::less and std::greater on arithmetic types take the block partition
+TEST_F(TestSort, BLOCK_PARTITION) {
+	for(int size : {0, 1, 2, 3, 16, 17, 100, 129, 1000, 100000}) {
+		for(const Expect& pattern : sort_patterns(size)) {
+			Expect expect(pattern);
+			Result result(pattern.begin(), pattern.end());
+			std::sort(expect.begin(), expect.end());
+			custom::sort(result.begin(), result.end(), std::less<TType>());
+			ASSERT_TRUE(std::equal(expect.begin(), expect.end(), result.begin()));
+			std::copy(pattern.begin(), pattern.end(), result.begin());
+			custom::sort(result.begin(), result.end(), std::greater<>());
+			ASSERT_TRUE(std::equal(expect.rbegin(), expect.rend(), result.begin()));
+		}
+	}
+}
+
+TEST_F(TestSort, REVERSE_ITERATORS) {
+	for(const Expect& pattern : sort_patterns(10000)) {
+		Expect expect(pattern);
+		Result result(pattern.begin(), pattern.end());
+		std::sort(expect.rbegin(), expect.rend());
+		custom::sort(result.rbegin(), result.rend());
+		ASSERT_TRUE(std::equal(expect.begin(), expect.end(), result.begin()));
+	}
+}
+
+TEST_F(TestSort, COMPARATOR) {
+	Vector<std::string> result;
+	for(int i = 0; i < 1000; i++) {
+		result.push_back(std::to_string(rd()));
+	}
+	auto by_length = [](const std::string& a, const std::string& b) {
+		return a.size() < b.size() || (a.size() == b.size() && a < b);
+	};
+	custom::sort(result.begin(), result.end(), by_length);
+	ASSERT_TRUE(std::is_sorted(result.begin(), result.end(), by_length));
+}
+
+TEST_F(TestSort, HEAPSORT) {
+	for(const Expect& pattern : sort_patterns(1000)) {
+		Expect expect(pattern);
+		custom::detail::heap_sort(expect.begin(), expect.end(), std::less<TType>());
+		ASSERT_TRUE(std::is_sorted(expect.begin(), expect.end()));
+	}
+}
+
+TEST_F(TestSort, COMPARISONS) {
+	// n*log2(n) with a small constant on every pattern
+	const int size = 100000;
+	for(const Expect& pattern : sort_patterns(size)) {
+		Expect expect(pattern);
+		long long comparisons = 0;
+		custom::sort(expect.begin(), expect.end(), [&comparisons](TType a, TType b) {
+			++comparisons;
+			return a < b;
+		});
+		ASSERT_TRUE(std::is_sorted(expect.begin(), expect.end()));
+		ASSERT_LT(comparisons, 3LL*size*17);
+	}
+}
+
+TEST_F(TestSort, PARALLEL) {
+	for(std::size_t threads : {1, 2, 3, 8}) {
+		for(int size : {1000, 20000, 300000}) {
+			for(const Expect& pattern : sort_patterns(size)) {
+				Expect expect(pattern);
+				Result result(pattern.begin(), pattern.end());
+				std::sort(expect.begin(), expect.end());
+				custom::parallel_sort(result.begin(), result.end(), threads);
+				ASSERT_TRUE(std::equal(expect.begin(), expect.end(), result.begin()));
+			}
+		}
+	}
+}
+
+TEST_F(TestSort, PARALLEL_POOL) {
+	ThreadPool pool(3);
+	Vector<double> result;
+	for(int i = 0; i < 500000; i++) {
+		result.push_back(rd()%1000/7.0);
+	}
+	custom::parallel_sort(result.begin(), result.end(), std::greater<double>(), pool);
+	ASSERT_TRUE(std::is_sorted(result.begin(), result.end(), std::greater<double>()));
+	// The pool is reusable
+	custom::parallel_sort(result.begin(), result.end(), std::less<double>(), pool);
+	ASSERT_TRUE(std::is_sorted(result.begin(), result.end()));
+}
+
+TEST_F(TestSort, PARALLEL_EXCEPTION) {
+	Expect sample(300000);
+	random_fill(sample);
+	std::atomic<int> calls(0);
+	auto throwing = [&calls](TType a, TType b) {
+		if (++calls == 1000000) {
+			throw std::runtime_error("comparator");
+		}
+		return a < b;
+	};
+	ThreadPool pool(3);
+	ASSERT_THROW(custom::parallel_sort(sample.begin(), sample.end(), throwing, pool), std::runtime_error);
+	calls = 0;
+	ASSERT_THROW(custom::parallel_sort(sample.begin(), sample.end(), throwing, std::size_t(1)), std::runtime_error);
+}
+
+TEST_F(TestSort, SEGMENTED_VECTOR) {
+	for(int size : {0, 1, 15, 16, 17, 1000, 100000}) {
+		for(const Expect& pattern : sort_patterns(size)) {
+			Expect expect(pattern);
+			Segmented result(pattern.begin(), pattern.end());
+			std::sort(expect.begin(), expect.end());
+			custom::sort(result.begin(), result.end());
+			ASSERT_TRUE(std::equal(expect.begin(), expect.end(), result.begin()));
+			custom::stable_sort(result.rbegin(), result.rend());
+			ASSERT_TRUE(std::equal(expect.rbegin(), expect.rend(), result.begin()));
+		}
+	}
+}
+
+TEST_F(TestSort, SOA_VECTOR) {
+	for(int size : {0, 1, 15, 16, 17, 1000, 100000}) {
+		for(const Expect& pattern : sort_patterns(size)) {
+			std::vector<Row> expect;
+			SoAVector<int, double, std::string> rows;
+			for(int i = 0; i < size; i++) {
+				expect.emplace_back(pattern[i], i, std::to_string(i));
+				rows.push_back(expect.back());
+			}
+			SoAVector<int, double, std::string> copy(rows);
+			std::stable_sort(expect.begin(), expect.end(), field_less<0>());
+			custom::stable_sort(rows.begin(), rows.end(), field_less<0>());
+			ASSERT_TRUE(std::equal(rows.begin(), rows.end(), expect.begin(), [](Rows::const_reference a, const Row& b) {
+				return Row(a) == b;
+			}));
+			custom::sort(copy.begin(), copy.end(), field_less<0, std::greater<>>());
+			ASSERT_TRUE(std::is_sorted(copy.column<0>().begin(), copy.column<0>().end(), std::greater<>()));
+			copy.sort_by<0>();
+			for(int i = 0; i < size; i++) {
+				ASSERT_EQ(copy[i].get<0>(), std::get<0>(expect[i]));
+				ASSERT_EQ(copy[i].get<2>(), std::to_string(int(copy[i].get<1>())));
+			}
+		}
+	}
+}
+
+TEST_F(TestThreadPool, NESTED_GROUPS) {
+	ThreadPool pool(4);
+	std::atomic<int> sum(0);
+	TaskGroup outer(pool);
+	for(int i = 0; i < 16; i++) {
+		outer.run([&pool, &sum]() {
+			TaskGroup inner(pool);
+			for(int j = 0; j < 16; j++) {
+				inner.run([&sum, j]() {
+					sum += j;
+				});
+			}
+			inner.wait();
+		});
+	}
+	outer.wait();
+	ASSERT_EQ(sum, 16*120);
+}
+
+TEST_F(TestThreadPool, EXCEPTION) {
+	ThreadPool pool(2);
+	TaskGroup group(pool);
+	for(int i = 0; i < 8; i++) {
+		group.run([i]() {
+			if (i == 5) {
+				throw std::logic_error("task");
+			}
+		});
+	}
+	ASSERT_THROW(group.wait(), std::logic_error);
+	// The error is reported once
+	group.wait();
+}
+
+const int PARALLEL_SIZE = 1 << 18;
+
+TEST_F(TestParallelAlgorithms, FILL_CONSTRUCT) {
+	ThreadPool pool(3);
+	Vector<double> values;
+	custom::parallel_resize(values, PARALLEL_SIZE, 1.5, pool);
+	ASSERT_EQ(PARALLEL_SIZE, values.size());
+	ASSERT_EQ(PARALLEL_SIZE, values.capacity());
+	ASSERT_EQ(PARALLEL_SIZE, std::count(values.begin(), values.end(), 1.5));
+	custom::parallel_resize(values, 2*PARALLEL_SIZE, pool);
+	ASSERT_EQ(PARALLEL_SIZE, std::count(values.begin(), values.end(), 0.0));
+	ASSERT_EQ(1.5, values[PARALLEL_SIZE - 1]);
+	custom::parallel_resize(values, 10, pool);
+	ASSERT_EQ(10, values.size());
+	Vector<TType> zeros;
+	custom::parallel_resize(zeros, 100, pool);
+	ASSERT_EQ(100, std::count(zeros.begin(), zeros.end(), 0));
+	custom::parallel_fill(values.begin(), values.end(), 2.0, pool);
+	ASSERT_EQ(10, std::count(values.begin(), values.end(), 2.0));
+	// Class counts without atomics, FailingCopy is safe across threads
+	FailingCopy::fail_at = 0;
+	{
+		Vector<FailingCopy> objects;
+		custom::parallel_resize(objects, PARALLEL_SIZE, pool);
+		ASSERT_EQ(PARALLEL_SIZE, FailingCopy::live.load());
+	}
+	ASSERT_EQ(0, FailingCopy::live.load());
+}
+
+TEST_F(TestParallelAlgorithms, FILL_EXCEPTION) {
+	ThreadPool pool(3);
+	for(int fail_at : {1, 1000, PARALLEL_SIZE/2, PARALLEL_SIZE}) {
+		FailingCopy::copies = 0;
+		FailingCopy::fail_at = fail_at;
+		{
+			FailingCopy value;
+			Vector<FailingCopy> objects;
+			ASSERT_THROW(custom::parallel_resize(objects, PARALLEL_SIZE, value, pool), std::runtime_error);
+			ASSERT_TRUE(objects.empty());
+			ASSERT_EQ(1, FailingCopy::live.load());
+		}
+		ASSERT_EQ(0, FailingCopy::live.load());
+	}
+}
+
+TEST_F(TestParallelAlgorithms, TRANSFORM_REDUCE) {
+	ThreadPool pool(3);
+	for(int size : {0, 1, 1000, PARALLEL_SIZE + 7}) {
+		Vector<long long> values(size);
+		std::iota(values.begin(), values.end(), 0);
+		long long expect = (long long)size*(size - 1)/2;
+		ASSERT_EQ(10 + expect, custom::parallel_reduce(values.begin(), values.end(), 10LL, pool));
+		ASSERT_EQ(expect*2, custom::parallel_transform_reduce(values.begin(), values.end(), 0LL, std::plus<>(), [](long long a) {
+			return 2*a;
+		}, pool));
+		Vector<long long> squares(size);
+		ASSERT_EQ(squares.end(), custom::parallel_transform(values.begin(), values.end(), squares.begin(), [](long long a) {
+			return a*a;
+		}, pool));
+		for(int i = 0; i < size; i++) {
+			ASSERT_EQ((long long)i*i, squares[i]);
+		}
+		// Not commutative: the order of the blocks is kept
+		Vector<std::string> words(size);
+		for(int i = 0; i < size; i++) {
+			words[i] = std::to_string(i%10);
+		}
+		std::string joined = custom::parallel_reduce(words.begin(), words.end(), std::string(">"), pool);
+		std::string expect_joined(">");
+		for(const std::string& word : words) {
+			expect_joined += word;
+		}
+		ASSERT_EQ(expect_joined, joined);
+	}
+}
+
+TEST_F(TestParallelAlgorithms, FIND_COUNT) {
+	ThreadPool pool(3);
+	Vector<TType> values;
+	custom::parallel_resize(values, PARALLEL_SIZE, 0, pool);
+	ASSERT_EQ(values.end(), custom::parallel_find_if(values.begin(), values.end(), [](TType a) {
+		return a != 0;
+	}, pool));
+	ASSERT_EQ(0, custom::parallel_count_if(values.begin(), values.end(), [](TType a) {
+		return a != 0;
+	}, pool));
+	// The first of several matches in different blocks
+	for(int first : {0, 5000, PARALLEL_SIZE/2 + 3, PARALLEL_SIZE - 1}) {
+		std::fill(values.begin(), values.end(), 0);
+		for(int i = first; i < PARALLEL_SIZE; i += PARALLEL_SIZE/5) {
+			values[i] = 1;
+		}
+		ASSERT_EQ(values.begin() + first, custom::parallel_find_if(values.begin(), values.end(), [](TType a) {
+			return a != 0;
+		}, pool));
+		ASSERT_EQ(std::count(values.begin(), values.end(), 1), custom::parallel_count_if(values.begin(), values.end(), [](TType a) {
+			return a != 0;
+		}, pool));
+	}
+}
+
+TEST_F(TestSort, RADIX) {
+	for(int size : {0, 1, 2, 64, 65, 1000, 100000}) {
+		for(const Expect& pattern : sort_patterns(size)) {
+			Expect expect(pattern);
+			Result result(pattern.begin(), pattern.end());
+			std::sort(expect.begin(), expect.end());
+			custom::radix_sort(result.begin(), result.end());
+			ASSERT_TRUE(std::equal(expect.begin(), expect.end(), result.begin()));
+		}
+	}
+}
+
+TEST_F(TestSort, RADIX_TYPES) {
+	std::mt19937_64 generator(rd());
+	Vector<int64_t> signed_keys;
+	Vector<uint32_t> unsigned_keys;
+	Vector<int16_t> short_keys;
+	Vector<float> floats;
+	Vector<double> doubles;
+	for(int i = 0; i < 10000; i++) {
+		uint64_t bits = generator();
+		signed_keys.push_back(int64_t(bits));
+		unsigned_keys.push_back(uint32_t(bits));
+		short_keys.push_back(int16_t(bits));
+		floats.push_back(float(int64_t(bits))/1e9f);
+		doubles.push_back(double(int64_t(bits) % 1000000)/7.0);
+	}
+	floats.push_back(0.0f);
+	floats.push_back(-std::numeric_limits<float>::infinity());
+	doubles.push_back(std::numeric_limits<double>::infinity());
+	doubles.push_back(-std::numeric_limits<double>::min());
+	custom::radix_sort(signed_keys.begin(), signed_keys.end());
+	custom::radix_sort(unsigned_keys.begin(), unsigned_keys.end());
+	custom::radix_sort(short_keys.begin(), short_keys.end());
+	custom::radix_sort(floats.begin(), floats.end());
+	custom::radix_sort(doubles.begin(), doubles.end());
+	ASSERT_TRUE(std::is_sorted(signed_keys.begin(), signed_keys.end()));
+	ASSERT_TRUE(std::is_sorted(unsigned_keys.begin(), unsigned_keys.end()));
+	ASSERT_TRUE(std::is_sorted(short_keys.begin(), short_keys.end()));
+	ASSERT_TRUE(std::is_sorted(floats.begin(), floats.end()));
+	ASSERT_TRUE(std::is_sorted(doubles.begin(), doubles.end()));
+}
+
+TEST_F(TestSort, RADIX_KEY) {
+	// Records with equal keys keep their order
+	Vector<std::pair<unsigned, std::string>> records;
+	for(int i = 0; i < 5000; i++) {
+		records.push_back(std::make_pair(unsigned(rd()%100), std::to_string(i)));
+	}
+	Vector<std::pair<unsigned, std::string>> expect(records);
+	std::stable_sort(expect.begin(), expect.end(), [](const std::pair<unsigned, std::string>& a, const std::pair<unsigned, std::string>& b) {
+		return a.first < b.first;
+	});
+	Arena arena;
+	custom::radix_sort(records.begin(), records.end(), [](const std::pair<unsigned, std::string>& a_record) {
+		return a_record.first;
+	}, ArenaAllocator<char>(arena));
+	ASSERT_TRUE(std::equal(expect.begin(), expect.end(), records.begin()));
+	// The scratch buffer came from the arena
+	ASSERT_GE(arena.reserved(), records.size()*sizeof(records[0]));
+}
+
+TEST_F(TestSort, SIMD) {
+	for(int size : {0, 1, 2, 17, 63, 64, 65, 1000, 100000}) {
+		for(const Expect& pattern : sort_patterns(size)) {
+			Vector<int32_t> ints(pattern.begin(), pattern.end());
+			Vector<int64_t> longs;
+			Vector<float> floats;
+			Vector<double> doubles;
+			for(TType value : pattern) {
+				longs.push_back(int64_t(value)*value);
+				floats.push_back(value/3.0f);
+				doubles.push_back(-value/7.0);
+			}
+			Vector<int32_t> expect_ints(ints);
+			Vector<int64_t> expect_longs(longs);
+			Vector<float> expect_floats(floats);
+			Vector<double> expect_doubles(doubles);
+			std::sort(expect_ints.begin(), expect_ints.end());
+			std::sort(expect_longs.begin(), expect_longs.end());
+			std::sort(expect_floats.begin(), expect_floats.end());
+			std::sort(expect_doubles.begin(), expect_doubles.end());
+			custom::sort(ints.begin(), ints.end());
+			custom::sort(longs.begin(), longs.end());
+			custom::sort(floats.begin(), floats.end());
+			custom::sort(doubles.begin(), doubles.end());
+			ASSERT_TRUE(std::equal(expect_ints.begin(), expect_ints.end(), ints.begin()));
+			ASSERT_TRUE(std::equal(expect_longs.begin(), expect_longs.end(), longs.begin()));
+			ASSERT_TRUE(std::equal(expect_floats.begin(), expect_floats.end(), floats.begin()));
+			ASSERT_TRUE(std::equal(expect_doubles.begin(), expect_doubles.end(), doubles.begin()));
+		}
+	}
+}
+
+TEST_F(TestSort, SIMD_SIGNED_ZEROS) {
+	// Equal keys with different bits must not be duplicated
+	Vector<double> result;
+	for(int i = 0; i < 10000; i++) {
+		result.push_back(i%3 == 0 ? -0.0 : i%3 == 1 ? 0.0 : double(rd()%5) - 2);
+	}
+	int negative_zeros = std::count_if(result.begin(), result.end(), [](double a_value) {
+		return a_value == 0 && std::signbit(a_value);
+	});
+	custom::sort(result.begin(), result.end());
+	ASSERT_TRUE(std::is_sorted(result.begin(), result.end()));
+	ASSERT_EQ(negative_zeros, std::count_if(result.begin(), result.end(), [](double a_value) {
+		return a_value == 0 && std::signbit(a_value);
+	}));
+}
+
+TEST_F(TestSort, SIMD_NAN) {
+	// NaNs send the array to the scalar sort, which must not lose elements
+	Vector<float> result;
+	for(int i = 0; i < 1000; i++) {
+		result.push_back(i == 500 ? std::numeric_limits<float>::quiet_NaN() : float(rd()%100));
+	}
+	custom::sort(result.begin(), result.end());
+	ASSERT_EQ(1, std::count_if(result.begin(), result.end(), [](float a_value) {
+		return a_value != a_value;
+	}));
+}
+
+#ifdef CUSTOM_SIMD_SORT
+template<class V>
+void check_simd_kernels(const custom::simd::kernels<typename V::value_type>* a_kernels) {
+	typedef typename V::value_type value_type;
+	if (a_kernels == nullptr) {
+		return;
+	}
+	for(int size : {2, 5, 16, 33, 64, 200, 5000, 100000}) {
+		for(const Expect& pattern : sort_patterns(size)) {
+			Vector<value_type> result;
+			for(TType value : pattern) {
+				result.push_back(value_type(value)/value_type(4));
+			}
+			Vector<value_type> expect(result);
+			std::sort(expect.begin(), expect.end());
+			custom::detail::simd_introsort(result.begin(), result.end(), 64, true, *a_kernels);
+			ASSERT_TRUE(std::equal(expect.begin(), expect.end(), result.begin()));
+		}
+	}
+}
+
+TEST_F(TestSort, SIMD_KERNELS) {
+	// Both instruction sets, whichever the CPU has
+	using namespace custom::simd;
+	check_simd_kernels<avx2_int32>(avx2_kernels<avx2_int32>());
+	check_simd_kernels<avx2_int64>(avx2_kernels<avx2_int64>());
+	check_simd_kernels<avx2_float>(avx2_kernels<avx2_float>());
+	check_simd_kernels<avx2_double>(avx2_kernels<avx2_double>());
+	check_simd_kernels<avx512_int32>(avx512_kernels<avx512_int32>());
+	check_simd_kernels<avx512_int64>(avx512_kernels<avx512_int64>());
+	check_simd_kernels<avx512_float>(avx512_kernels<avx512_float>());
+	check_simd_kernels<avx512_double>(avx512_kernels<avx512_double>());
+}
+#endif
+
+typedef std::pair<TType, int> Keyed;
+
+bool by_key(const Keyed& a, const Keyed& b) {
+	return a.first < b.first;
+}
+
+// Patterns with few distinct keys, the second member is the original position
+Vector<Keyed> keyed_pattern(const Expect& a_pattern) {
+	Vector<Keyed> keyed;
+	for(std::size_t i = 0; i < a_pattern.size(); i++) {
+		keyed.push_back(Keyed(a_pattern[i]%50, int(i)));
+	}
+	return keyed;
+}
+
+TEST_F(TestSort, STABLE_SORT) {
+	for(int size : {0, 1, 2, 31, 32, 33, 100, 1000, 100000}) {
+		for(const Expect& pattern : sort_patterns(size)) {
+			Vector<Keyed> result = keyed_pattern(pattern);
+			Vector<Keyed> expect(result);
+			std::stable_sort(expect.begin(), expect.end(), by_key);
+			custom::stable_sort(result.begin(), result.end(), by_key);
+			ASSERT_TRUE(std::equal(expect.begin(), expect.end(), result.begin()));
+			std::stable_sort(expect.rbegin(), expect.rend(), by_key);
+			custom::stable_sort(result.rbegin(), result.rend(), by_key);
+			ASSERT_TRUE(std::equal(expect.begin(), expect.end(), result.begin()));
+		}
+	}
+}
+
+// std::less and std::greater on arithmetic types merge without branches
+TEST_F(TestSort, STABLE_SORT_ARITHMETIC) {
+	for(int size : {0, 1, 2, 31, 32, 33, 100, 1000, 100000}) {
+		for(const Expect& pattern : sort_patterns(size)) {
+			Expect expect(pattern);
+			Result result(pattern.begin(), pattern.end());
+			std::sort(expect.begin(), expect.end());
+			custom::stable_sort(result.begin(), result.end());
+			ASSERT_TRUE(std::equal(expect.begin(), expect.end(), result.begin()));
+			std::copy(pattern.begin(), pattern.end(), result.begin());
+			custom::stable_sort(result.begin(), result.end(), std::greater<TType>());
+			ASSERT_TRUE(std::equal(expect.rbegin(), expect.rend(), result.begin()));
+		}
+	}
+	// Zeros of both signs are equal, their signs show the order
+	Vector<double> zeros;
+	for(int i = 0; i < 20000; i++) {
+		int value = static_cast<int>(rd()%3) - 1;
+		zeros.push_back(value == 0 && rd()%2 ? -0.0 : value);
+	}
+	Vector<double> expect(zeros);
+	std::stable_sort(expect.begin(), expect.end());
+	custom::stable_sort(zeros.begin(), zeros.end());
+	for(std::size_t i = 0; i < zeros.size(); i++) {
+		ASSERT_EQ(std::signbit(expect[i]), std::signbit(zeros[i]));
+		ASSERT_EQ(expect[i], zeros[i]);
+	}
+}
+
+TEST_F(TestSort, STABLE_SORT_LOW_MEMORY) {
+	// No buffer at all, then one much shorter than n/2
+	for(std::size_t limit : {0, 100}) {
+		LimitedAllocator<Keyed>::limit = limit;
+		for(const Expect& pattern : sort_patterns(20000)) {
+			Vector<Keyed> result = keyed_pattern(pattern);
+			Vector<Keyed> expect(result);
+			std::stable_sort(expect.begin(), expect.end(), by_key);
+			custom::stable_sort(result.begin(), result.end(), by_key, LimitedAllocator<Keyed>());
+			ASSERT_TRUE(std::equal(expect.begin(), expect.end(), result.begin()));
+		}
+	}
+}
+
+TEST_F(TestSort, STABLE_SORT_COMPARISONS) {
+	// A sorted input with a few swaps is one long run plus short ones
+	const int size = 100000;
+	Expect nearly = sort_patterns(size)[6];
+	long long comparisons = 0;
+	custom::stable_sort(nearly.begin(), nearly.end(), [&comparisons](TType a, TType b) {
+		++comparisons;
+		return a < b;
+	});
+	ASSERT_TRUE(std::is_sorted(nearly.begin(), nearly.end()));
+	ASSERT_LT(comparisons, 5LL*size);
+}
+
+TEST_F(TestSort, NTH_ELEMENT) {
+	for(int size : {1, 2, 17, 100, 1000, 100000}) {
+		for(const Expect& pattern : sort_patterns(size)) {
+			Expect sorted(pattern);
+			std::sort(sorted.begin(), sorted.end());
+			for(int nth : {0, size/3, size - 1}) {
+				Result result(pattern.begin(), pattern.end());
+				custom::nth_element(result.begin(), result.begin() + nth, result.end());
+				ASSERT_EQ(sorted[nth], result[nth]);
+				ASSERT_TRUE(std::all_of(result.begin(), result.begin() + nth, [&](TType a_value) {
+					return a_value <= result[nth];
+				}));
+				ASSERT_TRUE(std::all_of(result.begin() + nth, result.end(), [&](TType a_value) {
+					return a_value >= result[nth];
+				}));
+				custom::nth_element(result.rbegin(), result.rbegin() + nth, result.rend());
+				ASSERT_EQ(sorted[nth], *(result.rbegin() + nth));
+			}
+		}
+	}
+}
+
+TEST_F(TestSort, PARTIAL_SORT) {
+	for(int size : {1, 2, 17, 100, 1000, 100000}) {
+		for(const Expect& pattern : sort_patterns(size)) {
+			Expect sorted(pattern);
+			std::sort(sorted.begin(), sorted.end());
+			for(int count : {0, 1, size/10, size}) {
+				Result result(pattern.begin(), pattern.end());
+				custom::partial_sort(result.begin(), result.begin() + count, result.end());
+				ASSERT_TRUE(std::equal(sorted.begin(), sorted.begin() + count, result.begin()));
+				Result reversed(pattern.begin(), pattern.end());
+				custom::partial_sort(reversed.rbegin(), reversed.rbegin() + count, reversed.rend(), std::greater<TType>());
+				ASSERT_TRUE(std::equal(sorted.rbegin(), sorted.rbegin() + count, reversed.rbegin()));
+			}
+		}
+	}
+}
+
+TEST_F(TestSort, CLASS) {
+	Class::count = 0;
+	{
+		Vector<Class, Allocator<Class>> result;
+		for(int i = 0; i < 1000; i++) {
+			result.push_back(Class(rd()%100));
+		}
+		custom::sort(result.begin(), result.end());
+		for(int i = 1; i < 1000; i++) {
+			ASSERT_LE(result[i - 1].get_value(), result[i].get_value());
+		}
+	}
+	ASSERT_EQ(0, Class::count);
+}
+
+
+
+
+
+
+TEST_F(TestElementAccess, FRONT_1) {
+	Class::count = 0;
+	Expect expect(1000, 0);
+	random_fill(expect);
+	Result result(expect.begin(), expect.end());
+	ASSERT_EQ(expect.front(), result.front());
+	expect.clear();
+	result.clear();
+	ASSERT_EQ(0, Class::count);
+}
+
+TEST_F(TestElementAccess, FRONT_2) {
+	Class::count = 0;
+	Expect expect(1);
+	random_fill(expect);
+	Result result(expect.begin(), expect.end());
+	ASSERT_EQ(expect.front(), result.front());
+	expect.clear();
+	result.clear();
+	ASSERT_EQ(0, Class::count);
+}
+
+TEST_F(TestElementAccess, FRONT_3) {
+	Expect expect(1);
+	random_fill(expect);
+	Result result(expect.begin(), expect.end());
+	auto value = expect.front();
+	expect.front() = value*2;
+	result.front() = value*2;
 	compare_vectors(expect, result);
-	ASSERT_EQ(1000, Class::count);
+	Class::count = 0;
+	{
+		Vector<Class, Allocator<Class>> objects(3, Class(1));
+		objects.front() = Class(2);
+		ASSERT_EQ(2, objects.front().get_value());
+		ASSERT_EQ(3, Class::count);
+	}
+	ASSERT_EQ(0, Class::count);
+}
+
+TEST_F(TestElementAccess, BACK_1) {
+	Class::count = 0;
+	Expect expect(1000, 0);
+	random_fill(expect);
+	Result result(expect.begin(), expect.end());
+	ASSERT_EQ(expect.back(), result.back());
 	expect.clear();
 	result.clear();
 	ASSERT_EQ(0, Class::count);
 }
 
-TEST_F(TestModifiers, POP_BACK) {
+TEST_F(TestElementAccess, BACK_2) {
+	Class::count = 0;
+	Expect expect(1);
+	random_fill(expect);
+	Result result(expect.begin(), expect.end());
+	ASSERT_EQ(expect.back(), result.back());
+	expect.clear();
+	result.clear();
+	ASSERT_EQ(0, Class::count);
+}
+
+TEST_F(TestElementAccess, BACK_3) {
+	Expect expect(1);
+	random_fill(expect);
+	Result result(expect.begin(), expect.end());
+	auto value = expect.back();
+	expect.back() = value*2;
+	result.back() = value*2;
+	compare_vectors(expect, result);
+	Class::count = 0;
+	{
+		Vector<Class, Allocator<Class>> objects(3, Class(1));
+		objects.back() = Class(2);
+		ASSERT_EQ(2, objects.back().get_value());
+		ASSERT_EQ(3, Class::count);
+	}
+	ASSERT_EQ(0, Class::count);
+}
+
+TEST_F(TestElementAccess, AT_1) {
+	Class::count = 0;
+	Expect expect(1000, 0);
+	random_fill(expect);
+	Result result(expect.begin(), expect.end());
+	compare_vectors(expect, result);
+	expect.clear();
+	result.clear();
+	ASSERT_EQ(0, Class::count);
+}
+
+TEST_F(TestElementAccess, AT_2) {
+	Expect expect(1000, 0);
+	random_fill(expect);
+	Result result(expect.begin(), expect.end());
+	int index = rd()%expect.size();
+	auto value = expect.at(index);
+	expect.at(index) = value*2;
+	result.at(index) = value*2;
+	compare_vectors(expect, result);
+	Class::count = 0;
+	{
+		Vector<Class, Allocator<Class>> objects(1000, Class(1));
+		objects.at(index) = Class(2);
+		ASSERT_EQ(2, objects.at(index).get_value());
+		ASSERT_EQ(1000, Class::count);
+	}
+	ASSERT_EQ(0, Class::count);
+}
+
+TEST_F(TestElementAccess, BRACES_1) {
+	Class::count = 0;
+	Expect expect(1000, 0);
+	random_fill(expect);
+	Result result(expect.begin(), expect.end());
+	compare_vectors_br(expect, result);
+	expect.clear();
+	result.clear();
+	ASSERT_EQ(0, Class::count);
+}
+
+TEST_F(TestElementAccess, BRACES_2) {
+	Expect expect(1000, 0);
+	random_fill(expect);
+	Result result(expect.begin(), expect.end());
+	int index = rd()%expect.size();
+	auto value = expect.at(index);
+	expect[index] = value*2;
+	result[index] = value*2;
+	compare_vectors(expect, result);
+	Class::count = 0;
+	{
+		Vector<Class, Allocator<Class>> objects(1000, Class(1));
+		objects[index] = Class(2);
+		ASSERT_EQ(2, objects[index].get_value());
+		ASSERT_EQ(1000, Class::count);
+	}
+	ASSERT_EQ(0, Class::count);
+}
+
+
+
+
+
+
+TEST_F(TestModifiers, INSERT) {
+	Class::count = 0;
+	Expect expect;
+	Result result;
+	for(int i = 0; i < 1000; i++) {
+		TType value(rd());
+		size_t index = i == 0 ? 0 : rd()%expect.size();
+		auto ie = expect.insert(expect.begin() + index, value);
+		auto ir = result.insert(result.begin() + index, value);
+		ASSERT_EQ(expect.end() - ie, result.end() - ir);
+	}
+	compare_vectors(expect, result);
+	expect.clear();
+	result.clear();
+	ASSERT_EQ(0, Class::count);
+}
+
+TEST_F(TestModifiers, INSERT_RANGE) {
+	Expect expect;
+	Result result;
+	for(int i = 0; i < 100; i++) {
+		Expect sample(rd()%50);
+		random_fill(sample);
+		size_t index = expect.empty() ? 0 : rd()%expect.size();
+		auto ie = expect.insert(expect.begin() + index, sample.begin(), sample.end());
+		auto ir = result.insert(result.begin() + index, sample.begin(), sample.end());
+		ASSERT_EQ(expect.end() - ie, result.end() - ir);
+	}
+	ASSERT_TRUE(std::equal(expect.begin(), expect.end(), result.begin()));
+}
+
+// GCC 12 reports an overflow in Allocator::construct() when the
+// std::vector fill insertion moves the tail of a full buffer, a false
+// positive of that path
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wstringop-overflow"
+#endif
+TEST_F(TestModifiers, INSERT_FILL) {
+	Expect expect(10, 1);
+	Result result(10, 1);
+	expect.insert(expect.begin() + 5, 100, 2);
+	result.insert(result.begin() + 5, 100, 2);
+	expect.insert(expect.begin() + 3, 3, expect[0]);
+	result.insert(result.begin() + 3, 3, result[0]);
+	ASSERT_EQ(expect.size(), result.size());
+	ASSERT_TRUE(std::equal(expect.begin(), expect.end(), result.begin()));
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+TEST_F(TestModifiers, INSERT_INPUT_ITERATOR) {
+	std::istringstream input("4 5 6");
+	Result result{1, 2, 3, 7};
+	result.insert(result.begin() + 3, std::istream_iterator<TType>(input), std::istream_iterator<TType>());
+	Result expect{1, 2, 3, 4, 5, 6, 7};
+	ASSERT_EQ(expect.size(), result.size());
+	ASSERT_TRUE(std::equal(expect.begin(), expect.end(), result.begin()));
+}
+
+TEST_F(TestModifiers, APPEND_RANGE) {
+	Expect sample(1000);
+	random_fill(sample);
+	Vector<TType, Allocator<TType>, growth::Exact> result{1, 2};
+	result.append_range(sample);
+	ASSERT_EQ(1002, result.size());
+	ASSERT_EQ(1002, result.capacity());
+	ASSERT_TRUE(std::equal(sample.begin(), sample.end(), result.begin() + 2));
+}
+
+TEST_F(TestModifiers, ASSIGN_RANGE) {
+	Class::count = 0;
+	{
+		Vector<Class, Allocator<Class>> result(100, Class(1));
+		std::vector<Class> sample(50, Class(2));
+		auto memory = result.begin();
+		result.assign(sample.begin(), sample.end());
+		ASSERT_EQ(memory, result.begin());
+		ASSERT_EQ(50, result.size());
+		ASSERT_EQ(2, result.back().get_value());
+		result.assign(200, Class(3));
+		ASSERT_EQ(200, result.size());
+		ASSERT_EQ(3, result.front().get_value());
+		result.assign(10, 4);
+		ASSERT_EQ(10, result.size());
+		ASSERT_EQ(4, result.back().get_value());
+		ASSERT_EQ(60, Class::count);
+	}
+	ASSERT_EQ(0, Class::count);
+}
+
+TEST_F(TestModifiers, CLEAR) {
+	Class::count = 0;
+	Result result(1000);
+	random_fill(result);
+	result.clear();
+	ASSERT_EQ(0, result.size());
+	ASSERT_EQ(0, Class::count);
+}
+
+TEST_F(TestModifiers, EMPLACE) {
+	Class::count = 0;
+	Expect expect;
+	Result result;
+	for(int i = 0; i < 1000; i++) {
+		int value = rd();
+		size_t index = i == 0 ? 0 : rd()%expect.size();
+		auto ie = expect.emplace(expect.begin() + index, value);
+		auto ir = result.emplace(result.begin() + index, value);
+		ASSERT_EQ(expect.end() - ie, result.end() - ir);
+	}
+	compare_vectors(expect, result);
+	expect.clear();
+	result.clear();
+	ASSERT_EQ(0, Class::count);
+}
+
+TEST_F(TestModifiers, EMPLACE_BACK) {
+	Class::count = 0;
+	{
+		Vector<Class, Allocator<Class>> result;
+		result.reserve(1000);
+		for(int i = 0; i < 1000; i++) {
+			Class::constructions = 0;
+			Class& value = result.emplace_back(i, 2);
+			ASSERT_EQ(1, Class::constructions);
+			ASSERT_EQ(2*i, value.get_value());
+		}
+		ASSERT_EQ(1000, Class::count);
+	}
+	ASSERT_EQ(0, Class::count);
+}
+
+TEST_F(TestModifiers, EMPLACE_IN_PLACE) {
+	Class::count = 0;
+	{
+		Vector<Class, Allocator<Class>> result;
+		result.reserve(100);
+		Class::constructions = 0;
+		auto i = result.emplace(result.begin(), 3, 4);
+		ASSERT_EQ(1, Class::constructions);
+		ASSERT_EQ(12, i->get_value());
+		Class::constructions = 0;
+		i = result.emplace(result.end(), 5);
+		ASSERT_EQ(1, Class::constructions);
+		ASSERT_EQ(5, i->get_value());
+		ASSERT_EQ(2, Class::count);
+	}
+	ASSERT_EQ(0, Class::count);
+}
+
+TEST_F(TestModifiers, PUSH_BACK_RVALUE) {
+	Vector<Tracked, Allocator<Tracked>> result;
+	result.reserve(100);
+	Tracked::copies = 0;
+	Tracked::moves = 0;
+	for(int i = 0; i < 100; i++) {
+		result.push_back(Tracked(i));
+	}
+	ASSERT_EQ(0, Tracked::copies);
+	ASSERT_EQ(100, Tracked::moves);
+}
+
+TEST_F(TestModifiers, PUSH_BACK_SELF) {
+	Vector<std::string, Allocator<std::string>> result;
+	result.push_back(std::string(100, 'x'));
+	for(int i = 0; i < 100; i++) {
+		result.push_back(result[0]);
+	}
+	for(const std::string& value: result) {
+		ASSERT_EQ(std::string(100, 'x'), value);
+	}
+}
+
+TEST_F(TestModifiers, INSERT_SELF) {
+	Vector<std::string, Allocator<std::string>, growth::Exact> result;
+	for(int i = 0; i < 10; i++) {
+		result.push_back(std::string(50, '0' + i));
+	}
+	// No spare capacity: the vector reallocates
+	result.insert(result.begin(), result[2]);
+	ASSERT_EQ(std::string(50, '2'), result[0]);
+	ASSERT_EQ(std::string(50, '2'), result[3]);
+	result.reserve(100);
+	result.insert(result.begin() + 1, result[5]);
+	ASSERT_EQ(std::string(50, '4'), result[1]);
+	result.insert(result.begin() + 1, std::move(result[0]));
+	ASSERT_EQ(std::string(50, '2'), result[1]);
+	result.emplace(result.begin(), result.back());
+	ASSERT_EQ(std::string(50, '9'), result[0]);
+	ASSERT_EQ(14, result.size());
+	Result numbers{1, 2, 3, 4};
+	numbers.insert(numbers.begin(), numbers[2]);
+	numbers.insert(numbers.begin(), numbers[4]);
+	Result expect{4, 3, 1, 2, 3, 4};
+	ASSERT_TRUE(std::equal(expect.begin(), expect.end(), numbers.begin()));
+}
+
+TEST_F(TestModifiers, PUSH_BACK) {
+	Class::count = 0;
+	Expect expect;
+	Result result;
+	for(int i = 0; i < 1000; i++) {
+		int value = rd();
+		expect.push_back(value);
+		result.push_back(value);
+	}
+	compare_vectors(expect, result);
+	expect.clear();
+	result.clear();
+	ASSERT_EQ(0, Class::count);
+}
+
+TEST_F(TestModifiers, ERASE) {
+	Expect expect;
+	Result result;
+	for(int i = 0; i < 1000; i++) {
+		int value = rd();
+		expect.push_back(value);
+		result.push_back(value);
+	}
+	for(int i = 0; i < 500; i++) {
+		int index = rd()%expect.size();
+		auto ie = expect.erase(expect.begin() + index);
+		auto ir = result.erase(result.begin() + index);
+		ASSERT_EQ(expect.end() - ie, result.end() - ir);
+	}
+	compare_vectors(expect, result);
 	Class::count = 0;
+	{
+		Vector<Class, Allocator<Class>> objects(1000, Class(1));
+		for(int i = 0; i < 500; i++) {
+			objects.erase(objects.begin() + rd()%objects.size());
+		}
+		ASSERT_EQ(500, Class::count);
+		objects.erase(objects.begin(), objects.begin() + 100);
+		ASSERT_EQ(400, Class::count);
+	}
+	ASSERT_EQ(0, Class::count);
+}
+
+TEST_F(TestModifiers, POP_BACK) {
 	Expect expect;
 	Result result;
 	for(int i = 0; i < 1000; i++) {
@@ -580,101 +2934,21 @@ TEST_F(TestModifiers, POP_BACK) {
 		result.pop_back();
 	}
 	compare_vectors(expect, result);
-	ASSERT_EQ(1000, Class::count);
-	expect.clear();
-	result.clear();
+	Class::count = 0;
+	{
+		Vector<Class, Allocator<Class>> objects(1000, Class(1));
+		for(int i = 0; i < 500; i++) {
+			objects.pop_back();
+		}
+		ASSERT_EQ(500, Class::count);
+	}
 	ASSERT_EQ(0, Class::count);
 }
 
 
 
 
-using std::cout;
-using std::endl;
-
 int main(int argc, char** argv) {
-	// ::testing::InitGoogleTest(&argc, argv);
-	// return RUN_ALL_TESTS();
-	auto size_list = {100, 1000, 10000, 100000, 1000000, 3000000};
-	auto start = std::chrono::system_clock::now();
-	auto end = std::chrono::system_clock::now();
-	for(auto size : size_list) {
-		Expect sample(size);
-		random_fill(sample);
-		Expect expect(sample.begin(), sample.end());
-		Result result(sample.begin(), sample.end());
-
-		start = std::chrono::system_clock::now();
-		custom::sort(expect.begin(), expect.end());
-		end = std::chrono::system_clock::now();
-		cout << 
-			(end - start).count() << " (" <<
-			std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() 
-			<< "ms.) custom::sort; std::vector; random fill. N = " << size << "\n";
-
-		start = std::chrono::system_clock::now();
-		custom::sort(expect.rbegin(), expect.rend());
-		end = std::chrono::system_clock::now();
-		cout << 
-			(end - start).count() << " (" <<
-			std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() 
-			<< "ms.) custom::sort; std::vector; reverse order. N = " << size << "\n";
-
-		start = std::chrono::system_clock::now();		
-		custom::sort(result.begin(), result.end());
-		end = std::chrono::system_clock::now();
-		cout << 
-			(end - start).count() << " (" <<
-			std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() 
-			<< "ms.) custom::sort; Vector; same fill. N = " << size << "\n";
-
-		start = std::chrono::system_clock::now();		
-		custom::sort(result.rbegin(), result.rend());
-		end = std::chrono::system_clock::now();
-		cout << 
-			(end - start).count() << " (" <<
-			std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() 
-			<< "ms.) custom::sort; Vector; reverse. N = " << size << "\n";
-
-		cout << endl;
-
-		expect = Expect(sample.begin(), sample.end());
-		result = Result(sample.begin(), sample.end());
-
-		start = std::chrono::system_clock::now();
-		std::sort(expect.begin(), expect.end());
-		end = std::chrono::system_clock::now();
-		cout << 
-			(end - start).count() << " (" <<
-			std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() 
-			<< "ms.) std::sort; std::vector; random fill. N = " << size << "\n";
-
-		start = std::chrono::system_clock::now();
-		std::sort(expect.rbegin(), expect.rend());
-		end = std::chrono::system_clock::now();
-		cout << 
-			(end - start).count() << " (" <<
-			std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() 
-			<< "ms.) std::sort; std::vector; reverse order. N = " << size << "\n";
-
-		start = std::chrono::system_clock::now();		
-		std::sort(result.begin(), result.end());
-		end = std::chrono::system_clock::now();
-		cout << 
-			(end - start).count() << " (" <<
-			std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() 
-			<< "ms.) std::sort; Vector; same fill. N = " << size << "\n";
-
-		start = std::chrono::system_clock::now();		
-		std::sort(result.rbegin(), result.rend());
-		end = std::chrono::system_clock::now();
-		cout << 
-			(end - start).count() << " (" <<
-			std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() 
-			<< "ms.) std::sort; Vector; reverse order. N = " << size << "\n";
-
-		cout << endl;
-	}
-
-	return 0;
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
 }
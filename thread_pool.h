@@ -0,0 +1,211 @@
+#pragma once
+
+#include <cstddef>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Work-stealing pool. Every worker owns a deque: it pushes and pops its
+// own tasks at the back and steals from the front of the others when it
+// runs dry. Threads outside the pool share one extra deque.
+class ThreadPool {
+public:
+	typedef std::function<void()> task_type;
+
+	explicit ThreadPool(std::size_t a_threads = std::thread::hardware_concurrency())
+		: m_queue_count(a_threads + 1), m_queues(new Queue[a_threads + 1]), m_pending(0), m_stop(false) {
+		m_threads.reserve(a_threads);
+		for(std::size_t i = 0; i < a_threads; i++) {
+			m_threads.emplace_back([this, i]() {
+				work(i);
+			});
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Runs what is left in the queues before the workers exit
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> guard(m_sleep_lock);
+			m_stop = true;
+		}
+		m_wake.notify_all();
+		for(std::thread& thread : m_threads) {
+			thread.join();
+		}
+	}
+
+	// Number of worker threads, not counting the threads that wait on tasks
+	std::size_t size() const {
+		return m_threads.size();
+	}
+
+	void submit(task_type a_task) {
+		// Counted before it is queued, so m_pending never drops below zero
+		{
+			std::lock_guard<std::mutex> guard(m_sleep_lock);
+			++m_pending;
+		}
+		Queue& queue = m_queues[own_queue()];
+		{
+			std::lock_guard<std::mutex> guard(queue.lock);
+			queue.tasks.push_back(std::move(a_task));
+		}
+		m_wake.notify_one();
+	}
+
+	// Runs one queued task on the calling thread, the newest own task
+	// first, then the oldest task of another queue.
+	// Returns false if there was nothing to run.
+	bool run_pending() {
+		std::size_t own = own_queue();
+		task_type task;
+		if (!pop_back(own, task)) {
+			bool stolen = false;
+			for(std::size_t i = 1; i < m_queue_count && !stolen; i++) {
+				stolen = pop_front((own + i) % m_queue_count, task);
+			}
+			if (!stolen) {
+				return false;
+			}
+		}
+		--m_pending;
+		task();
+		return true;
+	}
+
+private:
+	struct Queue {
+		std::mutex lock;
+		std::deque<task_type> tasks;
+	};
+
+	struct Worker {
+		const ThreadPool* pool;
+		std::size_t index;
+	};
+
+	std::size_t m_queue_count;
+	std::unique_ptr<Queue[]> m_queues;
+	std::vector<std::thread> m_threads;
+	std::atomic<std::size_t> m_pending;
+	std::mutex m_sleep_lock;
+	std::condition_variable m_wake;
+	bool m_stop;
+
+	static Worker& current() {
+		static thread_local Worker worker = {nullptr, 0};
+		return worker;
+	}
+
+	std::size_t own_queue() const {
+		const Worker& worker = current();
+		return worker.pool == this ? worker.index : m_queue_count - 1;
+	}
+
+	bool pop_back(std::size_t a_queue, task_type& a_task) {
+		Queue& queue = m_queues[a_queue];
+		std::lock_guard<std::mutex> guard(queue.lock);
+		if (queue.tasks.empty()) {
+			return false;
+		}
+		a_task = std::move(queue.tasks.back());
+		queue.tasks.pop_back();
+		return true;
+	}
+
+	bool pop_front(std::size_t a_queue, task_type& a_task) {
+		Queue& queue = m_queues[a_queue];
+		std::lock_guard<std::mutex> guard(queue.lock);
+		if (queue.tasks.empty()) {
+			return false;
+		}
+		a_task = std::move(queue.tasks.front());
+		queue.tasks.pop_front();
+		return true;
+	}
+
+	void work(std::size_t a_index) {
+		current() = Worker{this, a_index};
+		while (true) {
+			if (run_pending()) {
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(m_sleep_lock);
+			m_wake.wait(lock, [this]() {
+				return m_stop || m_pending > 0;
+			});
+			if (m_stop && m_pending == 0) {
+				return;
+			}
+		}
+	}
+};
+
+// Set of tasks that can be waited for. The waiting thread runs queued
+// tasks instead of blocking, so tasks may wait for their own children.
+// The first exception thrown by a task is rethrown by wait().
+class TaskGroup {
+public:
+	explicit TaskGroup(ThreadPool& a_pool) : m_pool(a_pool), m_pending(0) {
+	}
+
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+
+	~TaskGroup() {
+		try {
+			wait();
+		} catch (...) {
+		}
+	}
+
+	ThreadPool& pool() const {
+		return m_pool;
+	}
+
+	template<class Function>
+	void run(Function a_function) {
+		++m_pending;
+		m_pool.submit([this, a_function]() mutable {
+			try {
+				a_function();
+			} catch (...) {
+				std::lock_guard<std::mutex> guard(m_error_lock);
+				if (!m_error) {
+					m_error = std::current_exception();
+				}
+			}
+			--m_pending;
+		});
+	}
+
+	void wait() {
+		while (m_pending > 0) {
+			if (!m_pool.run_pending()) {
+				std::this_thread::yield();
+			}
+		}
+		std::lock_guard<std::mutex> guard(m_error_lock);
+		if (m_error) {
+			std::exception_ptr error = m_error;
+			m_error = nullptr;
+			std::rethrow_exception(error);
+		}
+	}
+
+private:
+	ThreadPool& m_pool;
+	std::atomic<std::size_t> m_pending;
+	std::mutex m_error_lock;
+	std::exception_ptr m_error;
+};
@@ -4,15 +4,36 @@
 #include <algorithm>
 #include <limits>
 #include <memory>
+#include <cstring>
+#include <type_traits>
 #include <iostream>
 #include <exception>
 #include "allocator.h"
+#include "growth_policy.h"
+#include "stats.h"
+#include "reclaim_policy.h"
 
+// Types that can be moved to another address with memcpy, leaving nothing
+// to destroy at the old one. Specialize it to opt in your own types.
+template<class T>
+struct is_trivially_relocatable : std::is_trivially_copyable<T> {};
 
-template<class T, class A = std::allocator<T>>
-class Vector {
+// Asks for default-initialized elements: trivial types are left
+// uninitialized, e.g. in buffers that are overwritten right away
+struct default_init_t {};
+constexpr default_init_t default_init{};
+
+
+// S is a stats policy, see stats.h, and R a reclaim policy that gives
+// unused capacity back, see reclaim_policy.h. They are base classes so
+// that the defaults stats::None and reclaim::Never take no space.
+template<class T, class A = std::allocator<T>, class G = growth::Default, class S = stats::None, class R = reclaim::Never>
+class Vector : protected S, protected R {
 public:
 	typedef A allocator_type;
+	typedef G growth_policy;
+	typedef S stats_policy;
+	typedef R reclaim_policy;
 	typedef typename A::value_type      value_type; 
 	typedef typename A::reference       reference;
 	typedef typename A::const_reference const_reference;
@@ -25,19 +46,21 @@ public:
 	typedef std::reverse_iterator<iterator> reverse_iterator;
 	typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
 
-private:
+protected:
 	pointer m_memory_begin;
 	pointer m_end;
 	pointer m_memory_end;
 	allocator_type m_allocator;
 
 public:
-	static const size_type allocate_multiplier = 8;
 // Constructors
 
 	Vector() : m_memory_begin(nullptr), m_end(nullptr), m_memory_end(nullptr) {
-		init_allocate_and_set_size(allocate_multiplier);
-		m_end = m_memory_begin;
+		init_allocate_and_set_size(0);
+	}
+
+	explicit Vector(const allocator_type& alloc) : m_memory_begin(nullptr), m_end(nullptr), m_memory_end(nullptr), m_allocator(alloc) {
+		init_allocate_and_set_size(0);
 	}
 
 	Vector(size_type a_size) {
@@ -51,6 +74,16 @@ public:
 		construct(m_memory_begin, m_end, a_value);
 	}
 
+	Vector(size_type a_size, default_init_t, const allocator_type& alloc = allocator_type()) : m_allocator(alloc) {
+		init_allocate_and_set_size(a_size);
+		try {
+			default_construct(m_memory_begin, m_end);
+		} catch (...) {
+			deallocate(m_memory_begin, capacity());
+			throw;
+		}
+	}
+
 	Vector(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type()) : m_allocator(alloc) {
 		init_allocate_and_set_size(il.size());
 		for(const_iterator i = begin(), v = il.begin(); i < end(); i++, v++) {
@@ -67,24 +100,45 @@ public:
 		construct_range_not_fill(is_range_constructor, a_first, a_last);
 	}
 
+	Vector(const Vector& other)
+		: S(), R(), m_memory_begin(nullptr), m_end(nullptr), m_memory_end(nullptr),
+		  m_allocator(allocator_traits::select_on_container_copy_construction(other.m_allocator)) {
+		assign_n(other.begin(), other.size());
+	}
+
+	Vector(Vector&& other) noexcept
+		: m_memory_begin(other.m_memory_begin), m_end(other.m_end), m_memory_end(other.m_memory_end),
+		  m_allocator(std::move(other.m_allocator)) {
+		take_stats(other, capacity());
+		other.m_memory_begin = other.m_end = other.m_memory_end = nullptr;
+	}
+
 	Vector& operator=(const Vector& other) {
-		destroy(begin(), end());
-		if (capacity() < other.size()) {
-			size_type old_capacity = capacity();
-			pointer old_begin = begin();
-			this->allocate(allocate_multiplier*other.size());
-			m_allocator.deallocate(old_begin, old_capacity);
+		if (this == &other) {
+			return *this;
 		}
-		m_end = m_memory_begin;
-		for(const_reference v: other) {
-			push_back(v);
+		if (allocator_traits::propagate_on_container_copy_assignment::value && m_allocator != other.m_allocator) {
+			free_storage();
+		}
+		copy_allocator(toggle<allocator_traits::propagate_on_container_copy_assignment::value>(), other.m_allocator);
+		assign_n(other.begin(), other.size());
+		return *this;
+	}
+
+	Vector& operator=(Vector&& other) noexcept(
+		allocator_traits::propagate_on_container_move_assignment::value ||
+		allocator_traits::is_always_equal::value) {
+		if (this != &other) {
+			move_assign(toggle<
+				allocator_traits::propagate_on_container_move_assignment::value ||
+				allocator_traits::is_always_equal::value
+			>(), other);
 		}
 		return *this;
 	}
 
 	~Vector() {
-		destroy(begin(), end());
-		m_allocator.deallocate(begin(), capacity());
+		free_storage();
 	}
 
 // Iterators
@@ -135,39 +189,80 @@ public:
 		return size() == 0;
 	}
 
+	const stats_policy& stats() const {
+		return *this;
+	}
+
 	void reserve(size_type a_size) {
 		if (capacity() >= a_size) {
 			return;
 		}
-		size_type old_size = size();
-		size_type old_capacity = capacity();
-		pointer old_begin = begin();
-		pointer new_begin = allocate(a_size);
-		std::copy(old_begin, old_begin + old_size, new_begin);
-		destroy(old_begin, old_begin + old_size);
-		m_allocator.deallocate(old_begin, old_capacity);
-		m_memory_begin = new_begin;
-		m_end = new_begin + old_size;
-		m_memory_end = m_memory_begin + a_size;
+		reallocate(a_size, size(), 0);
 	}
 
 	void resize(size_type a_size) {
-		if (a_size <= capacity()) {
+		if (a_size <= size()) {
 			destroy(begin() + a_size, end());
 			m_end = m_memory_begin + a_size;
+			decay();
 			return;
 		}
-		iterator old_begin = begin();
-		iterator old_end = end();
-		size_type old_size = size();
-		size_type old_capacity = capacity();
-		this->allocate(allocate_multiplier*a_size);
+		if (a_size > capacity()) {
+			reallocate(growth_policy::grow(capacity(), a_size), size(), 0);
+		}
+		this->construct(end(), begin() + a_size, T());
+		m_end = m_memory_begin + a_size;
+	}
+
+	// Same as resize(), but new elements are built in raw memory by
+	// a_build(first, last, allocator). If it throws, it must leave none
+	// of them constructed.
+	template<class Builder>
+	void resize_with(size_type a_size, Builder a_build) {
+		if (a_size <= size()) {
+			resize(a_size);
+			return;
+		}
+		if (a_size > capacity()) {
+			reallocate(growth_policy::grow(capacity(), a_size), size(), 0);
+		}
+		a_build(end(), begin() + a_size, m_allocator);
+		m_end = m_memory_begin + a_size;
+	}
+
+	// Same as resize(), but new elements are default-initialized
+	void resize_default_init(size_type a_size) {
+		if (a_size <= size()) {
+			resize(a_size);
+			return;
+		}
+		if (a_size > capacity()) {
+			reallocate(growth_policy::grow(capacity(), a_size), size(), 0);
+		}
+		default_construct(end(), begin() + a_size);
 		m_end = m_memory_begin + a_size;
-		std::copy(old_begin, old_end, m_memory_begin);
-		this->construct(m_memory_begin + old_size, m_end, T());
-		// TODO: should I destroy them?
-		// this->destroy(old_begin, old_end);
-		m_allocator.deallocate(old_begin, old_capacity);
+	}
+
+	// Resizes to a_size with default-initialized new elements, then calls
+	// a_operation(data(), a_size), which fills the buffer and returns the
+	// final size, at most a_size. Elements past it are destroyed.
+	template<class Operation>
+	void resize_and_overwrite(size_type a_size, Operation a_operation) {
+		resize_default_init(a_size);
+		size_type final_size = a_operation(data(), a_size);
+		resize(std::min(final_size, a_size));
+	}
+
+	// Gives back all capacity above size(). An empty vector frees its buffer.
+	void shrink_to_fit() {
+		shrink_capacity(size());
+	}
+
+	// Gives back the capacity above Policy::target(), see reclaim_policy.h.
+	// Returns the number of bytes given back.
+	template<class Policy>
+	size_type trim(Policy = Policy()) {
+		return shrink_capacity(Policy::target(size(), capacity()));
 	}
 
 // Element access
@@ -210,31 +305,169 @@ public:
 		return *(begin() + a_index);
 	}
 
+	pointer data() {
+		return m_memory_begin;
+	}
+
+	const_pointer data() const {
+		return m_memory_begin;
+	}
+
 // Modifiers
 
 	iterator insert(iterator a_position, const T& a_value) {
-		a_position = rshift(a_position, 1);
-		construct(a_position, a_value);
+		return emplace(a_position, a_value);
+	}
+
+	iterator insert(iterator a_position, T&& a_value) {
+		return emplace(a_position, std::move(a_value));
+	}
+
+	iterator insert(iterator a_position, size_type a_count, const T& a_value) {
+		if (a_count == 0) {
+			return a_position;
+		}
+		// a_value may live inside the range that is about to be shifted
+		value_type value(a_value);
+		a_position = rshift(a_position, a_count);
+		try {
+			construct(a_position, a_position + a_count, value);
+		} catch (...) {
+			abandon_gap(a_position, a_count);
+			throw;
+		}
 		return a_position;
 	}
 
+	// Same conflict as in range constructor
+	template <class InputIterator>
+	iterator insert(iterator a_position, InputIterator a_first, InputIterator a_last) {
+		toggle<is_iterator<InputIterator>::value> is_range_insert;
+		return insert_range_not_fill(is_range_insert, a_position, a_first, a_last);
+	}
+
+	iterator insert(iterator a_position, std::initializer_list<value_type> il) {
+		return insert(a_position, il.begin(), il.end());
+	}
+
+	template <class Range>
+	void append_range(const Range& a_range) {
+		using std::begin;
+		using std::end;
+		insert(this->end(), begin(a_range), end(a_range));
+	}
+
+	template <class InputIterator>
+	void assign(InputIterator a_first, InputIterator a_last) {
+		toggle<is_iterator<InputIterator>::value> is_range_assign;
+		assign_range_not_fill(is_range_assign, a_first, a_last);
+	}
+
+	void assign(size_type a_count, const T& a_value) {
+		if (a_count > capacity()) {
+			pointer new_begin = allocate_buffer(a_count);
+			pointer current = new_begin;
+			try {
+				for(; current != new_begin + a_count; ++current) {
+					m_allocator.construct(current, a_value);
+				}
+			} catch (...) {
+				destroy(new_begin, current);
+				deallocate(new_begin, a_count);
+				throw;
+			}
+			free_storage();
+			m_memory_begin = new_begin;
+			m_end = m_memory_end = new_begin + a_count;
+			return;
+		}
+		size_type common = std::min(size(), a_count);
+		std::fill(begin(), begin() + common, a_value);
+		if (a_count > common) {
+			construct(end(), begin() + a_count, a_value);
+		} else {
+			destroy(begin() + a_count, end());
+		}
+		m_end = begin() + a_count;
+	}
+
+	void assign(std::initializer_list<value_type> il) {
+		assign(il.begin(), il.end());
+	}
+
+	// The element is constructed right in its final slot. Arguments may
+	// refer into the vector: on reallocation the element is built before
+	// the old ones move, and an element that the shift would move is
+	// copied first.
 	template <class... Args>
 	iterator emplace(iterator a_position, Args&&... args) {
-		return insert(a_position, T(args...));
+		if (a_position == end()) {
+			emplace_back(std::forward<Args>(args)...);
+			return end() - 1;
+		}
+		if (m_end == m_memory_end) {
+			size_type index = a_position - begin();
+			if (!try_extend(growth_policy::grow(capacity(), size() + 1))) {
+				realloc_emplace(index, std::forward<Args>(args)...);
+				return begin() + index;
+			}
+			a_position = begin() + index;
+		}
+		return emplace_inside(toggle<is_element<Args...>::value>(), a_position, std::forward<Args>(args)...);
+	}
+
+	template <class... Args>
+	reference emplace_back(Args&&... args) {
+		if (m_end == m_memory_end) {
+			realloc_emplace_back(std::forward<Args>(args)...);
+		} else {
+			m_allocator.construct(m_end, std::forward<Args>(args)...);
+			++m_end;
+		}
+		decay();
+		return back();
 	}
 
 	void push_back(const T& a_value) {
-		insert(end(), a_value);
+		emplace_back(a_value);
+	}
+
+	void push_back(T&& a_value) {
+		emplace_back(std::move(a_value));
 	}
 
 	// [first, last}
 	iterator erase(iterator a_first, iterator a_last) {
-		// should I destroy them? no.
-		// destroy(a_first, a_last);
+		S::on_move(end() - a_last);
 		std::move(a_last, end(), a_first);
 		destroy(end()-(a_last-a_first), end());
 		m_end -= a_last - a_first;
-		return a_first;
+		size_type index = a_first - begin();
+		decay();
+		return begin() + index;
+	}
+
+	// Removes the elements that satisfy a_predicate in one pass, each kept
+	// element moves at most once. Returns the number removed.
+	template<class Predicate>
+	size_type erase_if(Predicate a_predicate) {
+		iterator out = std::find_if(begin(), end(), a_predicate);
+		if (out == end()) {
+			return 0;
+		}
+		size_type moved = 0;
+		for(iterator i = out + 1; i != end(); ++i) {
+			if (!a_predicate(*i)) {
+				*out++ = std::move(*i);
+				++moved;
+			}
+		}
+		S::on_move(moved);
+		size_type removed = end() - out;
+		destroy(out, end());
+		m_end = out;
+		decay();
+		return removed;
 	}
 
 	iterator erase(iterator a_position) {
@@ -249,7 +482,18 @@ public:
 		erase(end() - 1);
 	}
 
-private:
+	void swap(Vector& other) noexcept {
+		size_type this_capacity = capacity();
+		size_type other_capacity = other.capacity();
+		take_stats(other, other_capacity);
+		other.take_stats(*this, this_capacity);
+		std::swap(m_memory_begin, other.m_memory_begin);
+		std::swap(m_end, other.m_end);
+		std::swap(m_memory_end, other.m_memory_end);
+		swap_allocator(toggle<allocator_traits::propagate_on_container_swap::value>(), other.m_allocator);
+	}
+
+protected:
 	template<class I>
 	struct is_iterator {
 		template <class U> static char check(typename std::iterator_traits<U>::pointer* x);
@@ -261,14 +505,110 @@ private:
 	template<bool B>
 	struct toggle {};
 
+	// A single argument that may be an element of the vector itself
+	template<class... Args>
+	struct is_element : std::false_type {};
+
+	template<class U>
+	struct is_element<U> : std::is_same<typename std::decay<U>::type, T> {};
+
+	typedef std::allocator_traits<A> allocator_traits;
+
+	void free_storage() {
+		destroy(begin(), end());
+		deallocate(begin(), capacity());
+		m_memory_begin = m_end = m_memory_end = nullptr;
+	}
+
+	void copy_allocator(toggle<true>, const allocator_type& a_allocator) {
+		m_allocator = a_allocator;
+	}
+
+	void copy_allocator(toggle<false>, const allocator_type&) {
+	}
+
+	void swap_allocator(toggle<true>, allocator_type& a_allocator) {
+		using std::swap;
+		swap(m_allocator, a_allocator);
+	}
+
+	void swap_allocator(toggle<false>, allocator_type&) {
+	}
+
+	// Storage may change hands: either the allocator follows
+	// it or both allocators are interchangeable
+	void move_assign(toggle<true>, Vector& other) {
+		free_storage();
+		copy_allocator(toggle<allocator_traits::propagate_on_container_move_assignment::value>(), other.m_allocator);
+		take_stats(other, other.capacity());
+		m_memory_begin = other.m_memory_begin;
+		m_end = other.m_end;
+		m_memory_end = other.m_memory_end;
+		other.m_memory_begin = other.m_end = other.m_memory_end = nullptr;
+	}
+
+	// Storage stays with its allocator unless both are equal,
+	// otherwise elements are moved one by one
+	void move_assign(toggle<false>, Vector& other) {
+		if (m_allocator == other.m_allocator) {
+			move_assign(toggle<true>(), other);
+			return;
+		}
+		assign_n(std::make_move_iterator(other.begin()), other.size());
+		other.clear();
+	}
+
+	// Copy-constructs a_count elements starting at a_first into raw memory
+	template<class ForwardIterator>
+	pointer construct_n(ForwardIterator a_first, size_type a_count, pointer a_destination) {
+		pointer current = a_destination;
+		try {
+			for(; a_count > 0; --a_count, ++a_first, ++current) {
+				m_allocator.construct(current, *a_first);
+			}
+		} catch (...) {
+			destroy(a_destination, current);
+			throw;
+		}
+		return current;
+	}
+
+	// Replaces the contents with a_count elements starting at a_first.
+	// The existing buffer and elements are reused whenever they fit.
+	template<class ForwardIterator>
+	void assign_n(ForwardIterator a_first, size_type a_count) {
+		if (a_count > capacity()) {
+			pointer new_begin = allocate_buffer(a_count);
+			pointer new_end;
+			try {
+				new_end = construct_n(a_first, a_count, new_begin);
+			} catch (...) {
+				deallocate(new_begin, a_count);
+				throw;
+			}
+			free_storage();
+			m_memory_begin = new_begin;
+			m_end = new_end;
+			m_memory_end = new_begin + a_count;
+			return;
+		}
+		size_type common = std::min(size(), a_count);
+		for(pointer i = begin(); i != begin() + common; ++i, ++a_first) {
+			*i = *a_first;
+		}
+		if (a_count > common) {
+			m_end = construct_n(a_first, a_count - common, end());
+		} else {
+			destroy(begin() + a_count, end());
+			m_end = begin() + a_count;
+		}
+	}
+
 	// Range constructor
 	template<class U>
 	void construct_range_not_fill(toggle<true>, U a_first, U a_last) {
-		init_allocate_and_set_size(allocate_multiplier);
-		m_end = m_memory_begin;
-		for(U i = a_first; i != a_last; i++) {
-			push_back(*i);
-		}
+		init_allocate_and_set_size(0);
+		assign_range(a_first, a_last, typename std::iterator_traits<U>::iterator_category());
 	}
 
 	// Fill constructor
@@ -278,12 +618,100 @@ private:
 		construct(m_memory_begin, m_end, a_value);
 	}
 
+	template<class U>
+	iterator insert_range_not_fill(toggle<true>, iterator a_position, U a_first, U a_last) {
+		return insert_range(a_position, a_first, a_last, typename std::iterator_traits<U>::iterator_category());
+	}
+
+	template<class U>
+	iterator insert_range_not_fill(toggle<false>, iterator a_position, U a_count, U a_value) {
+		return insert(a_position, size_type(a_count), value_type(a_value));
+	}
+
+	// Length is unknown: append with amortized growth, then rotate into place
+	template<class U>
+	iterator insert_range(iterator a_position, U a_first, U a_last, std::input_iterator_tag) {
+		size_type index = a_position - begin();
+		size_type old_size = size();
+		for(; a_first != a_last; ++a_first) {
+			emplace_back(*a_first);
+		}
+		std::rotate(begin() + index, begin() + old_size, end());
+		return begin() + index;
+	}
+
+	// Length is known: one reallocation at most and a single construction pass
+	template<class U>
+	iterator insert_range(iterator a_position, U a_first, U a_last, std::forward_iterator_tag) {
+		size_type count = std::distance(a_first, a_last);
+		if (count == 0) {
+			return a_position;
+		}
+		a_position = rshift(a_position, count);
+		try {
+			construct_n(a_first, count, a_position);
+		} catch (...) {
+			abandon_gap(a_position, count);
+			throw;
+		}
+		return a_position;
+	}
+
+	template<class U>
+	void assign_range_not_fill(toggle<true>, U a_first, U a_last) {
+		assign_range(a_first, a_last, typename std::iterator_traits<U>::iterator_category());
+	}
+
+	template<class U>
+	void assign_range_not_fill(toggle<false>, U a_count, U a_value) {
+		assign(size_type(a_count), value_type(a_value));
+	}
+
+	template<class U>
+	void assign_range(U a_first, U a_last, std::input_iterator_tag) {
+		clear();
+		for(; a_first != a_last; ++a_first) {
+			emplace_back(*a_first);
+		}
+	}
+
+	template<class U>
+	void assign_range(U a_first, U a_last, std::forward_iterator_tag) {
+		assign_n(a_first, std::distance(a_first, a_last));
+	}
+
+	// A construction into a gap opened by rshift failed. Elements after
+	// the gap are dropped so the vector stays valid.
+	void abandon_gap(iterator a_position, size_type a_count) {
+		destroy(a_position + a_count, end());
+		m_end = a_position;
+	}
+
+	pointer allocate_buffer(size_type a_size) {
+		pointer memory = m_allocator.allocate(a_size);
+		S::on_allocate(a_size*sizeof(T));
+		return memory;
+	}
+
+	// Empty vectors own no memory at all
 	pointer allocate(size_type a_size) {
-		m_memory_begin = m_allocator.allocate(a_size);
+		m_memory_begin = a_size > 0 ? allocate_buffer(a_size) : nullptr;
 		m_memory_end   = m_memory_begin + a_size;
 		return m_memory_begin;
 	}
 
+	void deallocate(pointer a_memory, size_type a_size) {
+		if (a_memory != nullptr) {
+			S::on_deallocate(a_size*sizeof(T));
+			m_allocator.deallocate(a_memory, a_size);
+		}
+	}
+
+	// The buffer of a_capacity elements now belongs to this vector
+	void take_stats(Vector& a_from, size_type a_capacity) {
+		S::on_transfer(static_cast<S&>(a_from), a_capacity*sizeof(T));
+	}
+
 	void construct(const_iterator a_position, const_reference a_value) {
 		m_allocator.construct(a_position, a_value);
 	}
@@ -297,36 +725,341 @@ private:
 		}
 	}
 
+	// Trivial types are left as they are, others are built one by one.
+	// If a construction throws, everything built so far is destroyed.
+	void default_construct(pointer a_first, pointer a_last) {
+		default_construct(toggle<std::is_trivially_default_constructible<T>::value>(), a_first, a_last);
+	}
+
+	void default_construct(toggle<true>, pointer, pointer) {
+	}
+
+	void default_construct(toggle<false>, pointer a_first, pointer a_last) {
+		pointer current = a_first;
+		try {
+			for(; current != a_last; ++current) {
+				m_allocator.construct(current);
+			}
+		} catch (...) {
+			destroy(a_first, current);
+			throw;
+		}
+	}
+
 	void destroy(const_iterator a_first, const_iterator a_last) {
 		for(const_iterator i = a_first; i < a_last; i++) {
 			m_allocator.destroy(i);
 		}
 	}
 
+	typedef toggle<is_trivially_relocatable<T>::value> relocation_tag;
+
+	// Allocators may provide bool extend(pointer, size_type old_n, size_type new_n)
+	// to grow the buffer in place
+	template<class U, typename = void>
+	struct has_extend {
+		static const bool value = false;
+	};
+
+	template<class U>
+	struct has_extend<U, decltype(void(std::declval<U&>().extend(pointer(), size_type(), size_type())))> {
+		static const bool value = true;
+	};
+
+	bool try_extend(size_type a_capacity) {
+		return extend(toggle<has_extend<A>::value>(), a_capacity);
+	}
+
+	bool extend(toggle<true>, size_type a_capacity) {
+		if (begin() == nullptr || !m_allocator.extend(begin(), capacity(), a_capacity)) {
+			return false;
+		}
+		S::on_extend((a_capacity - capacity())*sizeof(T));
+		m_memory_end = begin() + a_capacity;
+		return true;
+	}
+
+	bool extend(toggle<false>, size_type) {
+		return false;
+	}
+
+	// Allocators may provide bool shrink(pointer, size_type old_n, size_type new_n)
+	// to give back the tail of the buffer in place
+	template<class U, typename = void>
+	struct has_shrink {
+		static const bool value = false;
+	};
+
+	template<class U>
+	struct has_shrink<U, decltype(void(std::declval<U&>().shrink(pointer(), size_type(), size_type())))> {
+		static const bool value = true;
+	};
+
+	// Allocators may provide bool relocate_to_shrink(pointer) and return
+	// false for buffers that are better left as they are when they cannot
+	// shrink in place
+	template<class U, typename = void>
+	struct has_relocate_to_shrink {
+		static const bool value = false;
+	};
+
+	template<class U>
+	struct has_relocate_to_shrink<U, decltype(void(std::declval<U&>().relocate_to_shrink(pointer())))> {
+		static const bool value = true;
+	};
+
+	bool relocate_to_shrink(toggle<true>) {
+		return m_allocator.relocate_to_shrink(begin());
+	}
+
+	bool relocate_to_shrink(toggle<false>) {
+		return true;
+	}
+
+	bool shrink(toggle<true>, size_type a_capacity) {
+		if (!m_allocator.shrink(begin(), capacity(), a_capacity)) {
+			return false;
+		}
+		S::on_shrink((capacity() - a_capacity)*sizeof(T));
+		m_memory_end = begin() + a_capacity;
+		return true;
+	}
+
+	bool shrink(toggle<false>, size_type) {
+		return false;
+	}
+
+	// Lowers the capacity to a_capacity, but not below size(): in place if
+	// the allocator can, otherwise by moving to a smaller buffer unless the
+	// allocator opts out. Returns the number of bytes given back.
+	size_type shrink_capacity(size_type a_capacity) {
+		a_capacity = std::max(a_capacity, size());
+		size_type old_capacity = capacity();
+		if (a_capacity >= old_capacity) {
+			return 0;
+		}
+		if (shrink(toggle<has_shrink<A>::value>(), a_capacity)) {
+			// given back in place
+		} else if (!relocate_to_shrink(toggle<has_relocate_to_shrink<A>::value>())) {
+			return 0;
+		} else if (a_capacity == 0) {
+			free_storage();
+		} else {
+			pointer new_begin = allocate_buffer(a_capacity);
+			try {
+				transfer(relocation_tag(), begin(), end(), new_begin);
+			} catch (...) {
+				deallocate(new_begin, a_capacity);
+				throw;
+			}
+			S::on_reallocate();
+			adopt(new_begin, a_capacity);
+		}
+		size_type bytes = (old_capacity - a_capacity)*sizeof(T);
+		S::on_reclaim(bytes);
+		return bytes;
+	}
+
+	// Asks the reclaim policy after an operation whether to give memory back
+	void decay() {
+		size_type target = R::on_operation(size(), capacity());
+		if (target < capacity()) {
+			shrink_capacity(target);
+		}
+	}
+
+	// move_if_noexcept() copies elements whose move may throw
+	static const bool relocation_copies =
+		!std::is_nothrow_move_constructible<T>::value && std::is_copy_constructible<T>::value;
+
+	// Moves [a_first, a_last) into raw memory at a_destination.
+	// The source is left for the caller to release.
+	// If a construction throws, everything built so far is destroyed.
+	pointer transfer(toggle<false>, pointer a_first, pointer a_last, pointer a_destination) {
+		pointer current = a_destination;
+		try {
+			for(; a_first != a_last; ++a_first, ++current) {
+				m_allocator.construct(current, std::move_if_noexcept(*a_first));
+			}
+		} catch (...) {
+			destroy(a_destination, current);
+			throw;
+		}
+		if (relocation_copies) {
+			S::on_copy(current - a_destination);
+		} else {
+			S::on_move(current - a_destination);
+		}
+		return current;
+	}
+
+	pointer transfer(toggle<true>, pointer a_first, pointer a_last, pointer a_destination) {
+		difference_type count = a_last - a_first;
+		S::on_move(count);
+		if (count > 0) {
+			std::memcpy(static_cast<void*>(a_destination), static_cast<const void*>(a_first), size_type(count)*sizeof(T));
+		}
+		return a_destination + count;
+	}
+
+	void release(toggle<false>, pointer a_first, pointer a_last) {
+		destroy(a_first, a_last);
+	}
+
+	void release(toggle<true>, pointer, pointer) {
+	}
+
+	// Transfers the elements into a_new_begin, leaving a raw gap of
+	// a_count elements at a_index. On exception nothing is left
+	// constructed in the new buffer and the old one is untouched.
+	void transfer_around_gap(pointer a_new_begin, size_type a_index, size_type a_count) {
+		pointer old_begin = begin();
+		transfer(relocation_tag(), old_begin, old_begin + a_index, a_new_begin);
+		try {
+			transfer(relocation_tag(), old_begin + a_index, end(), a_new_begin + a_index + a_count);
+		} catch (...) {
+			release(relocation_tag(), a_new_begin, a_new_begin + a_index);
+			throw;
+		}
+	}
+
+	// Releases the old elements and buffer and takes over the new one.
+	// size() is not changed.
+	void adopt(pointer a_new_begin, size_type a_capacity) {
+		size_type old_size = size();
+		release(relocation_tag(), begin(), end());
+		deallocate(begin(), capacity());
+		m_memory_begin = a_new_begin;
+		m_end = a_new_begin + old_size;
+		m_memory_end = a_new_begin + a_capacity;
+	}
+
+	// Moves the elements to a new buffer of a_capacity elements, leaving
+	// a raw gap of a_count elements at a_index. Old elements are destroyed
+	// only when all of them were transferred, so a throwing copy leaves
+	// the vector untouched. Returns the gap position, size() is not changed.
+	iterator reallocate(size_type a_capacity, size_type a_index, size_type a_count) {
+		if (try_extend(a_capacity)) {
+			iterator position = begin() + a_index;
+			if (position < end()) {
+				shift_right(relocation_tag(), position, a_count);
+			}
+			return position;
+		}
+		pointer new_begin = allocate_buffer(a_capacity);
+		try {
+			transfer_around_gap(new_begin, a_index, a_count);
+		} catch (...) {
+			deallocate(new_begin, a_capacity);
+			throw;
+		}
+		if (begin() != nullptr) {
+			S::on_reallocate();
+		}
+		adopt(new_begin, a_capacity);
+		return new_begin + a_index;
+	}
+
+	template <class... Args>
+	void realloc_emplace_back(Args&&... args) {
+		if (try_extend(growth_policy::grow(capacity(), size() + 1))) {
+			m_allocator.construct(m_end, std::forward<Args>(args)...);
+			++m_end;
+			return;
+		}
+		realloc_emplace(size(), std::forward<Args>(args)...);
+	}
+
+	// The new element is built before the old ones are moved, so
+	// arguments referring into the vector itself stay valid.
+	template <class... Args>
+	void realloc_emplace(size_type a_index, Args&&... args) {
+		size_type new_capacity = growth_policy::grow(capacity(), size() + 1);
+		pointer new_begin = allocate_buffer(new_capacity);
+		try {
+			m_allocator.construct(new_begin + a_index, std::forward<Args>(args)...);
+			try {
+				transfer_around_gap(new_begin, a_index, 1);
+			} catch (...) {
+				m_allocator.destroy(new_begin + a_index);
+				throw;
+			}
+		} catch (...) {
+			deallocate(new_begin, new_capacity);
+			throw;
+		}
+		if (begin() != nullptr) {
+			S::on_reallocate();
+		}
+		adopt(new_begin, new_capacity);
+		++m_end;
+	}
+
+	// There is room for the new element at a_position
+	template <class... Args>
+	iterator emplace_inside(toggle<false>, iterator a_position, Args&&... args) {
+		a_position = rshift(a_position, 1);
+		try {
+			m_allocator.construct(a_position, std::forward<Args>(args)...);
+		} catch (...) {
+			abandon_gap(a_position, 1);
+			throw;
+		}
+		return a_position;
+	}
+
+	// An element that the shift is about to move is copied out first
+	template <class U>
+	iterator emplace_inside(toggle<true>, iterator a_position, U&& a_value) {
+		const_pointer address = std::addressof(a_value);
+		if (address >= a_position && address < end()) {
+			value_type value(std::forward<U>(a_value));
+			return emplace_inside(toggle<false>(), a_position, std::move(value));
+		}
+		return emplace_inside(toggle<false>(), a_position, std::forward<U>(a_value));
+	}
+
+	// Opens a raw gap of a_count elements at a_position inside the
+	// current buffer. The caller guarantees there is enough capacity.
+	void shift_right(toggle<false>, pointer a_position, size_type a_count) {
+		pointer old_end = end();
+		if (size_type(old_end - a_position) > a_count) {
+			transfer(toggle<false>(), old_end - a_count, old_end, old_end);
+			S::on_move(old_end - a_count - a_position);
+			std::move_backward(a_position, old_end - a_count, old_end);
+			destroy(a_position, a_position + a_count);
+		} else {
+			transfer(toggle<false>(), a_position, old_end, a_position + a_count);
+			destroy(a_position, old_end);
+		}
+	}
+
+// GCC 12 follows an in-place extend of SmallVector's inline buffer into
+// positions that only a heap buffer reaches, and reports an overflow there
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wstringop-overflow"
+#pragma GCC diagnostic ignored "-Warray-bounds"
+#endif
+	void shift_right(toggle<true>, pointer a_position, size_type a_count) {
+		difference_type count = end() - a_position;
+		S::on_move(count);
+		if (count > 0) {
+			std::memmove(static_cast<void*>(a_position + a_count), static_cast<const void*>(a_position), size_type(count)*sizeof(T));
+		}
+	}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
 	iterator rshift(iterator a_position, size_type a_count) {
 		size_type old_size = size();
 		if (old_size + a_count <= capacity()) {
 			if (a_position < m_end) {
-				std::move(a_position, end(), a_position + a_count);
-				// TODO: should I destroy them?
-				// destroy(a_position, std::min(end(), a_position + a_count));	
+				shift_right(relocation_tag(), a_position, a_count);
 			}
 		} else {
-			size_type index = a_position - begin();
-			iterator old_begin = begin();
-			iterator old_end = end();
-			size_type old_capacity = capacity();
-			iterator new_begin = this->allocate(allocate_multiplier*(old_size + a_count));
-			a_position = new_begin + index;
-			if (index != 0) {
-				std::copy(old_begin, old_begin + index, new_begin);
-			}
-			if (old_size > index) {
-				std::copy(old_begin + index, old_begin + old_size, a_position);
-			}
-			// TODO: should I destroy them?
-			// destroy(old_begin, old_end);
-			m_allocator.deallocate(old_begin, old_capacity);
+			a_position = reallocate(growth_policy::grow(capacity(), old_size + a_count), a_position - begin(), a_count);
 		}
 		m_end = begin() + old_size + a_count;
 		return a_position;
@@ -334,9 +1067,20 @@ private:
 
 	void init_allocate_and_set_size(size_type a_size) {
 		m_memory_begin = m_end = m_memory_end = nullptr;
-		this->allocate(allocate_multiplier*(a_size > 0 ? a_size : allocate_multiplier));
+		this->allocate(a_size);
 		m_end = m_memory_begin + a_size;
-		m_memory_end = m_memory_begin + allocate_multiplier*(a_size > 0 ? a_size : allocate_multiplier);
 	}
 };
 
+template<class T, class A, class G, class S, class R>
+const bool Vector<T, A, G, S, R>::relocation_copies;
+
+template<class T, class A, class G, class S, class R>
+void swap(Vector<T, A, G, S, R>& a, Vector<T, A, G, S, R>& b) noexcept {
+	a.swap(b);
+}
+
+template<class T, class A, class G, class S, class R, class Predicate>
+typename Vector<T, A, G, S, R>::size_type erase_if(Vector<T, A, G, S, R>& a_vector, Predicate a_predicate) {
+	return a_vector.erase_if(a_predicate);
+}